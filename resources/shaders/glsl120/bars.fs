@@ -0,0 +1,34 @@
+#version 120
+
+// Input vertex attributes (from vertex shader)
+varying vec2 fragTexCoord;
+varying vec4 fragColor;
+
+// All bar primitives are drawn in one batch. The primitive kind is encoded
+// in the texture coordinate: u lies in [2*kind, 2*kind + 1].
+//   kind 0: solid bar line
+//   kind 1: smear trail (soft glow, radius 0.3, power 3)
+//   kind 2: tip circle (sharp glow, radius 0.07, power 5)
+vec4 glow(vec2 uv, float radius, float power)
+{
+    vec2 p = uv - vec2(0.5);
+    float d = length(p);
+    if (d > 0.5) return vec4(0);
+    float s = d - radius;
+    if (s <= 0.0) return fragColor*1.5;
+    float t = 1.0 - s / (0.5 - radius);
+    return mix(vec4(fragColor.xyz, 0), fragColor*1.5, pow(t, power));
+}
+
+void main()
+{
+    float kind = floor(fragTexCoord.x * 0.5);
+    vec2 uv = vec2(fragTexCoord.x - 2.0*kind, fragTexCoord.y);
+    if (kind < 0.5) {
+        gl_FragColor = fragColor;
+    } else if (kind < 1.5) {
+        gl_FragColor = glow(uv, 0.3, 3.0);
+    } else {
+        gl_FragColor = glow(uv, 0.07, 5.0);
+    }
+}
@@ -0,0 +1,37 @@
+#version 330
+
+// Input vertex attributes (from vertex shader)
+in vec2 fragTexCoord;
+in vec4 fragColor;
+
+// Output fragment color
+out vec4 finalColor;
+
+// All bar primitives are drawn in one batch. The primitive kind is encoded
+// in the texture coordinate: u lies in [2*kind, 2*kind + 1].
+//   kind 0: solid bar line
+//   kind 1: smear trail (soft glow, radius 0.3, power 3)
+//   kind 2: tip circle (sharp glow, radius 0.07, power 5)
+vec4 glow(vec2 uv, float radius, float power)
+{
+    vec2 p = uv - vec2(0.5);
+    float d = length(p);
+    if (d > 0.5) return vec4(0);
+    float s = d - radius;
+    if (s <= 0) return fragColor*1.5;
+    float t = 1 - s / (0.5 - radius);
+    return mix(vec4(fragColor.xyz, 0), fragColor*1.5, pow(t, power));
+}
+
+void main()
+{
+    float kind = floor(fragTexCoord.x * 0.5);
+    vec2 uv = vec2(fragTexCoord.x - 2.0*kind, fragTexCoord.y);
+    if (kind < 0.5) {
+        finalColor = fragColor;
+    } else if (kind < 1.5) {
+        finalColor = glow(uv, 0.3, 3.0);
+    } else {
+        finalColor = glow(uv, 0.07, 5.0);
+    }
+}
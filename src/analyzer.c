@@ -0,0 +1,504 @@
+/**
+ * @file analyzer.c
+ * @brief Worker thread running the windowing + FFT + band mapping pipeline
+ */
+#include "analyzer.h"
+#include "dsp.h"
+#include "fft_engine.h"
+
+#include <errno.h>
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#define ANALYZER_FRESH 4u          ///< Flag in middle: frame not yet consumed
+#define ANALYZER_IDLE_TIMEOUT 0.1  ///< Seconds between checks for shutdown
+#define STABILIZATION_TIME 0.5f    ///< Damping period after a track switch
+
+static const char *mode_names[COUNT_ANALYZER_MODES] = {
+    [ANALYZER_MODE_MID] = "Mid",
+    [ANALYZER_MODE_STEREO] = "Stereo",
+    [ANALYZER_MODE_SIDE] = "Side",
+};
+
+/* Analyzer_Config packed into one atomic word: log2(fft_size) in bits 0-4,
+ * window in bits 5-8, bar count in bits 9-17. Never 0 for a valid config. */
+#define CONFIG_LOG2_BITS 5
+#define CONFIG_WINDOW_BITS 4
+
+static unsigned config_pack(Analyzer_Config c) {
+  unsigned log2n = 0;
+  while ((1u << (log2n + 1)) <= c.fft_size)
+    log2n++;
+  return log2n | (unsigned)c.window << CONFIG_LOG2_BITS |
+         c.bars << (CONFIG_LOG2_BITS + CONFIG_WINDOW_BITS);
+}
+
+static Analyzer_Config config_unpack(unsigned packed) {
+  if (packed == 0)
+    return analyzer_default_config();
+  return (Analyzer_Config){
+      .fft_size = 1u << (packed & ((1u << CONFIG_LOG2_BITS) - 1)),
+      .window = (packed >> CONFIG_LOG2_BITS) & ((1u << CONFIG_WINDOW_BITS) - 1),
+      .bars = packed >> (CONFIG_LOG2_BITS + CONFIG_WINDOW_BITS),
+  };
+}
+
+static void reset_state(Analyzer *a) {
+  for (size_t c = 0; c < ANALYZER_MAX_CHANNELS; c++) {
+    Analyzer_Channel *ch = &a->channels[c];
+    memset(ch->bars, 0, sizeof(ch->bars));
+    if (ch->spectrum)
+      memset(ch->spectrum, 0,
+             (a->config.fft_size / 2 + 1) * sizeof(*ch->spectrum));
+    ch->bass_history = 0.0f;
+    ch->overall_level = 0.5f;
+  }
+  a->stabilization_timer = STABILIZATION_TIME;
+}
+
+/**
+ * @brief Hands the back frame to the renderer and takes the spare one
+ */
+static void publish(Analyzer *a, unsigned channels, float period) {
+  Analyzer_Frame *f = &a->frames[a->back];
+  for (unsigned c = 0; c < channels; c++)
+    memcpy(f->bars[c], a->channels[c].bars, sizeof(f->bars[c]));
+  f->bar_count = a->config.bars;
+  f->channels = channels;
+  f->seq = ++a->seq;
+  f->period = period;
+  a->back = atomic_exchange_explicit(&a->middle, a->back | ANALYZER_FRESH,
+                                     memory_order_acq_rel) &
+            ~ANALYZER_FRESH;
+}
+
+/**
+ * @brief Maps one channel's spectrum to logarithmic bands and smooths its bars
+ *
+ * @param max_amp Peak amplitude used for normalization (shared by channels)
+ */
+static void map_bands(Analyzer *a, Analyzer_Channel *ch, float max_amp,
+                      bool is_stabilizing, float dt) {
+  int bars = (int)a->bands.count;
+  /* The boosted region spans the same frequencies whatever the bar count */
+  int bass_bands = (bars + 8) / 9;
+
+  band_map_levels(&a->bands, ch->spectrum, a->levels);
+
+  for (int i = 0; i < bars; i++) {
+    float normalized = a->levels[i] / max_amp;
+
+    float bass_boost = 1.0f;
+    if (i < bass_bands) {
+      float bass_factor = 1.0f - ((float)i / bass_bands);
+      bass_boost = 1.0f + bass_factor * 3.5f;
+    }
+
+    float target = normalized * bass_boost;
+    target = sqrtf(target);
+
+    if (is_stabilizing) {
+      if (target > 0.6f) {
+        target *= 0.4f;
+      }
+    }
+
+    ch->overall_level = 0.95f * ch->overall_level + 0.05f * normalized;
+    target *= (1.0f + ch->overall_level * 0.5f);
+
+    if (target > 0.85f) {
+      float excess = target - 0.85f;
+      target = 0.85f + excess * 0.3f;
+    }
+
+    if (target > 1.5f)
+      target = 1.5f;
+
+    if (i == 0) {
+      ch->bass_history = 0.9f * ch->bass_history + 0.1f * target;
+    }
+
+    float smoothness_up = 20.0f + ch->bass_history * 10.0f;
+    float smoothness_down = 4.5f + ch->bass_history * 2.0f;
+
+    if (is_stabilizing) {
+      smoothness_up *= 0.3f;
+      smoothness_down *= 2.0f;
+    }
+
+    if (target > ch->bars[i]) {
+      ch->bars[i] += (target - ch->bars[i]) * smoothness_up * dt;
+    } else {
+      ch->bars[i] += (target - ch->bars[i]) * smoothness_down * dt;
+    }
+
+    if (ch->bars[i] < 0.0f)
+      ch->bars[i] = 0.0f;
+    if (ch->bars[i] > 1.5f)
+      ch->bars[i] = 1.5f;
+  }
+}
+
+/**
+ * @brief Computes one frame of bars from the N samples ending at end
+ *
+ * Processing pipeline:
+ * 1. Copy aligned left/right windows and form mid, side or L/R
+ * 2. Apply Hann window to samples
+ * 3. Compute real-input FFT to get the non-negative frequency bins
+ * 4. Map spectrum to logarithmic frequency bins
+ * 5. Apply enhanced bass boost and smoothing
+ *
+ * @param end Ring sequence one past the last sample of the window
+ * @param dt Seconds of audio since the previous analysis (the hop)
+ * @return Number of channels analyzed, 0 if the window was overwritten
+ */
+static unsigned analyze(Analyzer *a, uint64_t end, unsigned sample_rate,
+                        float dt) {
+  size_t n = a->config.fft_size;
+
+  /* A torn copy keeps the previous bars */
+  float *left = a->scratch[0], *right = a->scratch[1];
+  if (!ring_read_at(&a->left, left, end, n, &a->reader) ||
+      !ring_read_at(&a->right, right, end, n, &a->reader))
+    return 0;
+
+  bool is_stabilizing = a->stabilization_timer > 0.0f;
+  if (is_stabilizing)
+    a->stabilization_timer -= dt;
+
+  Analyzer_Mode mode = atomic_load_explicit(&a->mode, memory_order_relaxed);
+  unsigned channels = 1;
+  switch (mode) {
+  case ANALYZER_MODE_STEREO:
+    channels = 2;
+    break;
+  case ANALYZER_MODE_SIDE:
+    for (size_t i = 0; i < n; i++)
+      left[i] = 0.5f * (left[i] - right[i]);
+    break;
+  case ANALYZER_MODE_MID:
+  default:
+    for (size_t i = 0; i < n; i++)
+      left[i] = 0.5f * (left[i] + right[i]);
+    break;
+  }
+
+  float max_amp = 1e-6f;
+  for (unsigned c = 0; c < channels; c++) {
+    dsp_mul(a->scratch[c], a->scratch[c], a->window, n);
+    fft_r2c(a->plan, a->scratch[c], a->channels[c].spectrum);
+
+    /* Amplitude is the infinity norm max(|re|, |im|) of each bin */
+    float m = dsp_max_abs((const float *)a->channels[c].spectrum, n);
+    if (m > max_amp)
+      max_amp = m;
+  }
+
+  if (is_stabilizing) {
+    if (max_amp < 0.01f)
+      max_amp = 0.01f;
+  }
+
+  if (!band_map_matches(&a->bands, n, sample_rate, a->config.bars))
+    band_map_build(&a->bands, n, sample_rate, a->config.bars);
+
+  for (unsigned c = 0; c < channels; c++)
+    map_bands(a, &a->channels[c], max_amp, is_stabilizing, dt);
+
+  return channels;
+}
+
+static unsigned current_hop(Analyzer *a) {
+  unsigned hop = atomic_load_explicit(&a->hop, memory_order_relaxed);
+  if (hop == 0)
+    hop = ANALYZER_DEFAULT_HOP;
+  return hop < a->config.fft_size ? hop : a->config.fft_size;
+}
+
+/**
+ * @brief Sizes the worker buffers for the packed config (worker only)
+ *
+ * Scratch and spectra share one arena, regrown only when the FFT size
+ * increases. Plan and window always come fresh from the cache, so this also
+ * revalidates them after fft_plan_cache_clear().
+ *
+ * @return false if an allocation failed; the previous config is kept
+ */
+static bool apply_config(Analyzer *a, unsigned packed) {
+  Analyzer_Config cfg = config_unpack(packed);
+  size_t n = cfg.fft_size;
+  const Fft_Plan *plan = fft_plan_get(n);
+  const float *window = fft_window_get(cfg.window, n);
+  if (!plan || !window)
+    return false;
+
+  size_t bins = n / 2 + 1;
+  size_t size = ANALYZER_MAX_CHANNELS *
+                (bins * sizeof(float complex) + n * sizeof(float));
+  if (size > a->arena_size) {
+    void *arena = malloc(size);
+    if (!arena)
+      return false;
+    free(a->arena);
+    a->arena = arena;
+    a->arena_size = size;
+  }
+
+  /* Complex spectra first so every array stays suitably aligned */
+  float complex *spectra = a->arena;
+  float *scratch = (float *)(spectra + ANALYZER_MAX_CHANNELS * bins);
+  for (size_t c = 0; c < ANALYZER_MAX_CHANNELS; c++) {
+    a->channels[c].spectrum = spectra + c * bins;
+    a->scratch[c] = scratch + c * n;
+  }
+
+  bool resized = a->applied != packed;
+  a->applied = packed;
+  a->config = cfg;
+  a->plan = plan;
+  a->window = window;
+  if (resized) {
+    reset_state(a);
+    a->next_end = 0;
+  }
+  return true;
+}
+
+/**
+ * @brief Analyzes every hop that became available since the last wake-up
+ *
+ * Window ends are spaced exactly one hop apart in the sample stream, so the
+ * analysis rate is sample_rate / hop regardless of callback size or frame
+ * rate. If the worker fell so far behind that the oldest pending window was
+ * overwritten, it resynchronizes on the newest samples.
+ */
+static void run_hops(Analyzer *a) {
+  unsigned sample_rate =
+      atomic_load_explicit(&a->sample_rate, memory_order_relaxed);
+  if (sample_rate == 0)
+    return;
+
+  unsigned hop = current_hop(a);
+  float period = (float)hop / sample_rate;
+  uint64_t written = ring_write_seq(&a->left);
+
+  if (a->next_end == 0 || (written > a->next_end &&
+                           written - a->next_end >
+                               a->left.capacity - a->config.fft_size))
+    a->next_end = written;
+
+  while (a->next_end <= written) {
+    unsigned channels = analyze(a, a->next_end, sample_rate, period);
+    if (channels == 0) {
+      a->next_end = 0;
+      return;
+    }
+    publish(a, channels, period);
+    a->next_end += hop;
+  }
+}
+
+static void *analyzer_thread(void *arg) {
+  Analyzer *a = arg;
+
+  while (atomic_load_explicit(&a->running, memory_order_acquire)) {
+    struct timespec deadline;
+    clock_gettime(CLOCK_REALTIME, &deadline);
+    deadline.tv_nsec += (long)(ANALYZER_IDLE_TIMEOUT * 1e9);
+    if (deadline.tv_nsec >= 1000000000L) {
+      deadline.tv_sec += 1;
+      deadline.tv_nsec -= 1000000000L;
+    }
+
+    if (sem_timedwait(&a->wake, &deadline) != 0) {
+      if (errno == ETIMEDOUT || errno == EINTR)
+        continue;
+      break;
+    }
+    /* Several callbacks may have fired while we were busy: analyze once */
+    while (sem_trywait(&a->wake) == 0) {
+    }
+
+    unsigned requested =
+        atomic_load_explicit(&a->requested, memory_order_relaxed);
+    if (requested != a->applied && !apply_config(a, requested)) {
+      /* Out of memory: drop the request and keep analyzing as before */
+      atomic_compare_exchange_strong(&a->requested, &requested, a->applied);
+    }
+
+    if (atomic_exchange_explicit(&a->reset_requested, false,
+                                 memory_order_acq_rel)) {
+      reset_state(a);
+      a->next_end = 0;
+      publish(a, ANALYZER_MAX_CHANNELS, 0.0f);
+      continue;
+    }
+
+    run_hops(a);
+  }
+
+  return NULL;
+}
+
+bool analyzer_start(Analyzer *a) {
+  if (!a->left.data && !ring_init(&a->left, ANALYZER_RING_SIZE))
+    return false;
+  if (!a->right.data && !ring_init(&a->right, ANALYZER_RING_SIZE))
+    return false;
+
+  /* Build the buffers here so startup failures are reported to the caller */
+  unsigned requested = atomic_load(&a->requested);
+  if (requested == 0)
+    requested = config_pack(analyzer_default_config());
+  if (!apply_config(a, requested))
+    return false;
+  atomic_store(&a->requested, requested);
+
+  a->back = 0;
+  atomic_store(&a->middle, 1);
+  a->front = 2;
+  a->next_end = 0;
+
+  if (sem_init(&a->wake, 0, 0) != 0)
+    return false;
+
+  atomic_store(&a->running, true);
+  if (pthread_create(&a->thread, NULL, analyzer_thread, a) != 0) {
+    atomic_store(&a->running, false);
+    sem_destroy(&a->wake);
+    return false;
+  }
+  return true;
+}
+
+void analyzer_stop(Analyzer *a) {
+  if (!atomic_exchange(&a->running, false))
+    return;
+  sem_post(&a->wake);
+  pthread_join(a->thread, NULL);
+  sem_destroy(&a->wake);
+}
+
+void analyzer_reset(Analyzer *a, unsigned sample_rate) {
+  ring_clear(&a->right);
+  ring_clear(&a->left);
+  atomic_store(&a->sample_rate, sample_rate);
+  atomic_store_explicit(&a->reset_requested, true, memory_order_release);
+  sem_post(&a->wake);
+}
+
+void analyzer_push(Analyzer *a, const float *interleaved, unsigned frames,
+                   unsigned channels) {
+  /* Older samples would be overwritten within this very call anyway */
+  if (frames > a->left.capacity) {
+    interleaved += (size_t)(frames - a->left.capacity) * channels;
+    frames = a->left.capacity;
+  }
+
+  Ring_Span l[2], r[2];
+  ring_write_begin(&a->left, frames, l);
+  ring_write_begin(&a->right, frames, r);
+  for (size_t s = 0; s < 2; s++) {
+    dsp_deinterleave(l[s].data, r[s].data, interleaved, l[s].count, channels);
+    interleaved += l[s].count * channels;
+  }
+  /* Right first: a reader that sees left at sequence s finds right there too */
+  ring_write_end(&a->right, frames);
+  ring_write_end(&a->left, frames);
+  sem_post(&a->wake);
+}
+
+void analyzer_set_mode(Analyzer *a, Analyzer_Mode mode) {
+  atomic_store_explicit(&a->mode, mode, memory_order_relaxed);
+}
+
+void analyzer_configure(Analyzer *a, Analyzer_Config config) {
+  if (config.fft_size < ANALYZER_MIN_FFT_SIZE)
+    config.fft_size = ANALYZER_MIN_FFT_SIZE;
+  if (config.fft_size > ANALYZER_MAX_FFT_SIZE)
+    config.fft_size = ANALYZER_MAX_FFT_SIZE;
+  if (config.bars < ANALYZER_MIN_BARS)
+    config.bars = ANALYZER_MIN_BARS;
+  if (config.bars > ANALYZER_MAX_BARS)
+    config.bars = ANALYZER_MAX_BARS;
+  if (config.window < 0 || config.window >= COUNT_FFT_WINDOWS)
+    config.window = FFT_WINDOW_HANN;
+
+  atomic_store_explicit(&a->requested, config_pack(config),
+                        memory_order_relaxed);
+  if (atomic_load(&a->running))
+    sem_post(&a->wake);
+}
+
+Analyzer_Config analyzer_config(const Analyzer *a) {
+  return config_unpack(atomic_load_explicit(&((Analyzer *)a)->requested,
+                                            memory_order_relaxed));
+}
+
+Analyzer_Config analyzer_default_config(void) {
+  return (Analyzer_Config){
+      .fft_size = ANALYZER_DEFAULT_FFT_SIZE,
+      .bars = ANALYZER_DEFAULT_BARS,
+      .window = FFT_WINDOW_HANN,
+  };
+}
+
+void analyzer_set_hop(Analyzer *a, unsigned hop) {
+  if (hop < ANALYZER_MIN_HOP)
+    hop = ANALYZER_MIN_HOP;
+  if (hop > ANALYZER_MAX_FFT_SIZE)
+    hop = ANALYZER_MAX_FFT_SIZE;
+  atomic_store_explicit(&a->hop, hop, memory_order_relaxed);
+}
+
+const char *analyzer_mode_name(Analyzer_Mode mode) {
+  if (mode < 0 || mode >= COUNT_ANALYZER_MODES)
+    return "Unknown";
+  return mode_names[mode];
+}
+
+const Analyzer_Frame *analyzer_frame(Analyzer *a) {
+  if (atomic_load_explicit(&a->middle, memory_order_acquire) &
+      ANALYZER_FRESH) {
+    a->front = atomic_exchange_explicit(&a->middle, a->front,
+                                        memory_order_acq_rel) &
+               ~ANALYZER_FRESH;
+  }
+  return &a->frames[a->front];
+}
+
+const Analyzer_Frame *analyzer_display_frame(Analyzer *a, double now) {
+  Analyzer_Frame *d = &a->display;
+  uint64_t seq = a->frames[a->front].seq;
+  const Analyzer_Frame *f = analyzer_frame(a);
+
+  if (f->seq != seq) {
+    /* Start the glide from what is on screen now, not the previous frame */
+    if (f->channels == d->channels && f->bar_count == d->bar_count)
+      memcpy(a->from, d->bars, sizeof(a->from));
+    else
+      memcpy(a->from, f->bars, sizeof(a->from));
+    a->arrival = now;
+  }
+
+  float t = 1.0f;
+  if (f->period > 0.0f)
+    t = (float)(now - a->arrival) / f->period;
+  if (t > 1.0f)
+    t = 1.0f;
+  if (t < 0.0f)
+    t = 0.0f;
+
+  for (unsigned c = 0; c < f->channels; c++) {
+    for (size_t i = 0; i < f->bar_count; i++)
+      d->bars[c][i] = a->from[c][i] + (f->bars[c][i] - a->from[c][i]) * t;
+  }
+  d->bar_count = f->bar_count;
+  d->channels = f->channels;
+  d->seq = f->seq;
+  d->period = f->period;
+  return d;
+}
@@ -0,0 +1,234 @@
+/**
+ * @file analyzer.h
+ * @brief Background spectrum analyzer feeding the bar renderer
+ *
+ * The audio callback de-interleaves left/right samples into two rings and
+ * wakes a dedicated worker thread. The worker runs a short-time Fourier
+ * transform with a fixed hop: every time another hop of samples has been
+ * pushed it windows the N samples ending there, runs the FFT, maps the
+ * spectrum to bars and publishes the result through a lock-free triple
+ * buffer. The analysis rate therefore follows the audio, not the display.
+ * The render thread only ever picks up the most recent finished frame, so
+ * it never waits for the FFT, and interpolates between consecutive frames
+ * to move smoothly at any refresh rate.
+ *
+ * FFT size, window shape and bar count are runtime settings
+ * (analyzer_configure()). The worker owns the size-dependent buffers and
+ * reallocates them between two analyses, so they can change while music is
+ * playing.
+ */
+#ifndef ANALYZER_H_
+#define ANALYZER_H_
+
+#include <complex.h>
+#include <pthread.h>
+#include <semaphore.h>
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "bands.h"
+#include "fft_engine.h"
+#include "ring.h"
+
+#define ANALYZER_MIN_FFT_SIZE (1 << 8)      ///< Smallest FFT (256 samples)
+#define ANALYZER_MAX_FFT_SIZE (1 << 15)     ///< Largest FFT (32768 samples)
+#define ANALYZER_DEFAULT_FFT_SIZE (1 << 13) ///< Default FFT (8192 samples)
+#define ANALYZER_MIN_BARS 8                 ///< Fewest frequency bars
+#define ANALYZER_MAX_BARS BAND_MAP_MAX_BANDS ///< Most frequency bars
+#define ANALYZER_DEFAULT_BARS 72            ///< Default number of bars
+#define ANALYZER_RING_SIZE (2 * ANALYZER_MAX_FFT_SIZE) ///< FFT + callback slack
+#define ANALYZER_MAX_CHANNELS 2 ///< Spectra per frame (stereo)
+#define ANALYZER_DEFAULT_HOP 1024 ///< Samples between two analyses
+#define ANALYZER_MIN_HOP 128      ///< Smallest accepted hop
+
+/**
+ * @enum Analyzer_Mode
+ * @brief Which signal(s) the analyzer turns into bars
+ */
+typedef enum {
+  ANALYZER_MODE_MID,    ///< (L + R) / 2 downmix, one set of bars
+  ANALYZER_MODE_STEREO, ///< L and R analyzed separately (mirrored layout)
+  ANALYZER_MODE_SIDE,   ///< (L - R) / 2, shows the stereo width
+  COUNT_ANALYZER_MODES,
+} Analyzer_Mode;
+
+/**
+ * @struct Analyzer_Config
+ * @brief Runtime analysis settings
+ */
+typedef struct {
+  unsigned fft_size; ///< Power of two in [MIN_FFT_SIZE, MAX_FFT_SIZE]
+  unsigned bars;     ///< Bar count in [MIN_BARS, MAX_BARS]
+  Fft_Window window; ///< Window applied before the FFT
+} Analyzer_Config;
+
+/**
+ * @struct Analyzer_Frame
+ * @brief One finished analysis result handed to the renderer
+ */
+typedef struct {
+  /// Smoothed bar heights per channel; only [0, channels) x [0, bar_count)
+  /// are valid
+  float bars[ANALYZER_MAX_CHANNELS][ANALYZER_MAX_BARS];
+  unsigned bar_count; ///< Bars per channel
+  unsigned channels;  ///< 1 for mid/side, 2 for stereo (left, right)
+  uint64_t seq;      ///< Analysis counter, increases per frame
+  float period;      ///< Seconds of audio between this frame and the next
+} Analyzer_Frame;
+
+/**
+ * @struct Analyzer_Channel
+ * @brief Spectrum and smoothing state of one analyzed signal
+ */
+typedef struct {
+  float complex *spectrum;       ///< fft_size/2 + 1 FFT output bins
+  float bars[ANALYZER_MAX_BARS]; ///< Smoothing state of the bar heights
+  float bass_history;        ///< Persistent low-frequency energy state
+  float overall_level; ///< Persistent overall volume level for dynamic scaling
+} Analyzer_Channel;
+
+/**
+ * @struct Analyzer
+ * @brief Analyzer state, embedded in Plug so it survives hot reload
+ */
+typedef struct {
+  /* Written by the audio callback, in lockstep */
+  Ring left;               ///< Left (or mono) samples
+  Ring right;              ///< Right (or mono) samples
+  atomic_uint sample_rate; ///< Sample rate of the audio pushed
+  sem_t wake;              ///< Posted when new samples arrive
+
+  /* Written by the render thread */
+  atomic_int mode;  ///< Analyzer_Mode
+  atomic_uint hop;  ///< STFT hop in samples, 0 selects the default
+  atomic_uint requested; ///< Packed Analyzer_Config, 0 selects the default
+
+  /* Owned by the worker thread */
+  Ring_Reader reader; ///< Worker's overrun counters on left/right
+  unsigned applied;   ///< Packed config the buffers below are sized for
+  Analyzer_Config config; ///< Unpacked applied config
+  const Fft_Plan *plan;   ///< Cached plan for config.fft_size
+  const float *window;    ///< Cached window for config.fft_size
+  void *arena;            ///< Single allocation backing scratch and spectra
+  size_t arena_size;      ///< Bytes in arena
+  float *scratch[ANALYZER_MAX_CHANNELS];            ///< FFT inputs
+  Band_Map bands; ///< Bin ranges of the bars, rebuilt on rate/config change
+  float levels[ANALYZER_MAX_BARS]; ///< Raw band peaks of the current channel
+  Analyzer_Channel channels[ANALYZER_MAX_CHANNELS]; ///< Per-signal state
+  float stabilization_timer; ///< Seconds left of the post-switch damping
+  uint64_t seq;              ///< Number of frames published so far
+  uint64_t next_end; ///< Ring sequence of the next window end, 0 = resync
+
+  /* Triple buffer: worker owns back, renderer owns front */
+  Analyzer_Frame frames[3];
+  atomic_uint middle; ///< Index of the spare frame, ANALYZER_FRESH if unread
+  unsigned back;
+  unsigned front;
+
+  /* Owned by the render thread: interpolation between front frames */
+  Analyzer_Frame display; ///< Frame returned by analyzer_display_frame()
+  float from[ANALYZER_MAX_CHANNELS][ANALYZER_MAX_BARS]; ///< Shown at arrival
+  double arrival; ///< Time the current front frame was picked up
+
+  pthread_t thread;
+  atomic_bool running;
+  atomic_bool reset_requested;
+} Analyzer;
+
+/**
+ * @brief Initializes buffers and starts the worker thread
+ *
+ * The sample rings are allocated on the first call and reused afterwards.
+ * Buffers for the requested configuration are (re)built here, which also
+ * refreshes the cached plan and window after fft_plan_cache_clear().
+ *
+ * @return false if allocation or thread creation failed
+ */
+bool analyzer_start(Analyzer *a);
+
+/**
+ * @brief Stops and joins the worker thread
+ *
+ * Buffers and smoothing state are kept, so analyzer_start() can resume
+ * (e.g. across hot reload).
+ */
+void analyzer_stop(Analyzer *a);
+
+/**
+ * @brief Requests new analysis settings (any thread)
+ *
+ * Out-of-range values are clamped and fft_size is rounded down to a power
+ * of two. The worker applies the request before its next analysis; if the
+ * new buffers cannot be allocated it keeps the previous settings.
+ */
+void analyzer_configure(Analyzer *a, Analyzer_Config config);
+
+/**
+ * @brief Returns the most recently requested settings
+ */
+Analyzer_Config analyzer_config(const Analyzer *a);
+
+/**
+ * @brief Default settings
+ */
+Analyzer_Config analyzer_default_config(void);
+
+/**
+ * @brief Clears samples and bars for a clean track transition
+ *
+ * Acts as the producer: call it from the thread that pushes samples, or
+ * while no audio callback is pushing. The worker resets its smoothing state
+ * and publishes an empty frame right away.
+ *
+ * @param sample_rate Sample rate of the audio pushed from now on
+ */
+void analyzer_reset(Analyzer *a, unsigned sample_rate);
+
+/**
+ * @brief De-interleaves a float buffer into the left/right rings in one pass
+ * and wakes the worker
+ *
+ * Mono buffers feed both rings. Lock-free and non-blocking; safe to call
+ * from the audio callback.
+ */
+void analyzer_push(Analyzer *a, const float *interleaved, unsigned frames,
+                   unsigned channels);
+
+/**
+ * @brief Selects what the following frames analyze (any thread)
+ */
+void analyzer_set_mode(Analyzer *a, Analyzer_Mode mode);
+
+/**
+ * @brief Sets the STFT hop size in samples (any thread)
+ *
+ * At least ANALYZER_MIN_HOP and at most the FFT size. Smaller hops give finer
+ * time resolution at a higher CPU cost; the default suits 44.1/48 kHz.
+ */
+void analyzer_set_hop(Analyzer *a, unsigned hop);
+
+/**
+ * @brief Human-readable name of a mode
+ */
+const char *analyzer_mode_name(Analyzer_Mode mode);
+
+/**
+ * @brief Returns the most recent finished frame (render thread only)
+ *
+ * The returned frame stays valid until the next call.
+ */
+const Analyzer_Frame *analyzer_frame(Analyzer *a);
+
+/**
+ * @brief Returns bars interpolated between the two latest frames
+ *
+ * When a new frame arrives the bars glide from what was on screen to the
+ * new values over one hop period, so motion stays smooth whether the
+ * display runs faster or slower than the analysis. Render thread only.
+ *
+ * @param now Monotonic time in seconds (e.g. GetTime())
+ */
+const Analyzer_Frame *analyzer_display_frame(Analyzer *a, double now);
+
+#endif // ANALYZER_H_
@@ -0,0 +1,72 @@
+/**
+ * @file bands.c
+ * @brief Band table construction and per-frame band levels
+ */
+#include "bands.h"
+#include "dsp.h"
+
+#include <math.h>
+
+static inline float bin_amplitude(float complex x) {
+  return fmaxf(fabsf(crealf(x)), fabsf(cimagf(x)));
+}
+
+void band_map_build(Band_Map *m, size_t fft_size, unsigned sample_rate,
+                    unsigned count) {
+  if (count > BAND_MAP_MAX_BANDS)
+    count = BAND_MAP_MAX_BANDS;
+  m->count = count;
+  m->fft_size = fft_size;
+  m->sample_rate = sample_rate;
+
+  /* Bin k covers the fractional positions [k, k + 1); bin n/2 (Nyquist)
+   * is left out like before */
+  double last = (double)(fft_size / 2);
+  double bins_per_hz = (double)fft_size / sample_rate;
+  double ratio = (sample_rate * 0.5) / BAND_MAP_FREQ_MIN;
+
+  for (unsigned i = 0; i < count; i++) {
+    double b0 = BAND_MAP_FREQ_MIN * pow(ratio, (double)i / count) * bins_per_hz;
+    double b1 =
+        BAND_MAP_FREQ_MIN * pow(ratio, (double)(i + 1) / count) * bins_per_hz;
+    if (b1 > last)
+      b1 = last;
+    if (b0 > last - 1)
+      b0 = last - 1;
+
+    Band *band = &m->bands[i];
+    band->k0 = (uint32_t)b0;
+    band->k1 = (uint32_t)ceil(b1) - 1;
+    if (band->k1 <= band->k0) {
+      /* Narrower than a bin: the bin it falls in is the best estimate */
+      band->k1 = band->k0;
+      band->w0 = band->w1 = 1.0f;
+    } else {
+      band->w0 = (float)(band->k0 + 1 - b0);
+      band->w1 = (float)(b1 - band->k1);
+    }
+  }
+}
+
+void band_map_levels(const Band_Map *m, const float complex spectrum[],
+                     float out[]) {
+  for (unsigned i = 0; i < m->count; i++) {
+    const Band *band = &m->bands[i];
+    float level = band->w0 * bin_amplitude(spectrum[band->k0]);
+
+    if (band->k1 > band->k0) {
+      float edge = band->w1 * bin_amplitude(spectrum[band->k1]);
+      if (edge > level)
+        level = edge;
+
+      size_t inner = band->k1 - band->k0 - 1;
+      if (inner > 0) {
+        float peak = dsp_max_abs((const float *)&spectrum[band->k0 + 1],
+                                 2 * inner);
+        if (peak > level)
+          level = peak;
+      }
+    }
+    out[i] = level;
+  }
+}
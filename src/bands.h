@@ -0,0 +1,74 @@
+/**
+ * @file bands.h
+ * @brief Precomputed mapping from FFT bins to logarithmic frequency bands
+ *
+ * Each band covers a continuous range of fractional bin positions. Bins
+ * fully inside the range count at full weight; the two edge bins count in
+ * proportion to how much of them lies inside, so neighbouring bands split a
+ * shared bin instead of both claiming it. The table only depends on FFT
+ * size, sample rate and band count, so it is built once per combination
+ * instead of calling powf() for every band of every frame.
+ */
+#ifndef BANDS_H_
+#define BANDS_H_
+
+#include <complex.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#define BAND_MAP_MAX_BANDS 256 ///< Largest supported band count
+#define BAND_MAP_FREQ_MIN 20.0f ///< Lower edge of the first band in Hz
+
+/**
+ * @struct Band
+ * @brief Bins [k0, k1] contributing to one band
+ */
+typedef struct {
+  uint32_t k0; ///< First bin, weighted by w0
+  uint32_t k1; ///< Last bin, weighted by w1 (equal to k0 for narrow bands)
+  float w0;    ///< Fraction of bin k0 inside the band
+  float w1;    ///< Fraction of bin k1 inside the band
+} Band;
+
+/**
+ * @struct Band_Map
+ * @brief Band table together with the parameters it was built for
+ */
+typedef struct {
+  Band bands[BAND_MAP_MAX_BANDS];
+  unsigned count;       ///< Number of bands
+  size_t fft_size;      ///< FFT size the bin indices refer to
+  unsigned sample_rate; ///< Sample rate the frequencies refer to
+} Band_Map;
+
+/**
+ * @brief Builds the table for count bands from BAND_MAP_FREQ_MIN to Nyquist
+ *
+ * @param count Band count, clamped to BAND_MAP_MAX_BANDS
+ */
+void band_map_build(Band_Map *m, size_t fft_size, unsigned sample_rate,
+                    unsigned count);
+
+/**
+ * @brief True if m was built for exactly these parameters
+ */
+static inline bool band_map_matches(const Band_Map *m, size_t fft_size,
+                                    unsigned sample_rate, unsigned count) {
+  return m->fft_size == fft_size && m->sample_rate == sample_rate &&
+         m->count == count;
+}
+
+/**
+ * @brief Peak weighted amplitude of every band
+ *
+ * The amplitude of a bin is its infinity norm max(|re|, |im|), matching the
+ * normalization used by the analyzer.
+ *
+ * @param spectrum fft_size/2 + 1 bins from fft_r2c()
+ * @param out m->count band levels
+ */
+void band_map_levels(const Band_Map *m, const float complex spectrum[],
+                     float out[]);
+
+#endif // BANDS_H_
@@ -0,0 +1,128 @@
+/**
+ * @file crossfade.c
+ * @brief Equal-power fade gains and the ring that sums two slots
+ */
+#include "crossfade.h"
+
+#include <math.h>
+#include <string.h>
+
+#define RING_MASK (CROSSFADE_RING_FRAMES - 1)
+
+_Static_assert((CROSSFADE_RING_FRAMES & RING_MASK) == 0,
+               "CROSSFADE_RING_FRAMES must be a power of two");
+
+void crossfade_reset(Crossfade *x, unsigned slot, unsigned channels) {
+  x->slots[slot] = (Crossfade_Slot){.channels = channels};
+}
+
+void crossfade_begin(Crossfade *x, unsigned slot, unsigned length,
+                     unsigned channels) {
+  x->slots[slot] = (Crossfade_Slot){
+      .length = length,
+      .channels = channels,
+      .fade_in = true,
+  };
+  x->slots[1 - slot] = (Crossfade_Slot){
+      .length = length,
+      .channels = channels,
+      .fade_in = false,
+  };
+  atomic_store_explicit(&x->solo, false, memory_order_relaxed);
+}
+
+/**
+ * @brief Scales n frames starting at fade position c->pos
+ *
+ * The gain follows a quarter sine (incoming) or cosine (outgoing), so the
+ * summed power stays constant. The phase is computed exactly once per call
+ * and then advanced with a rotation, which keeps sinf()/cosf() out of the
+ * per-frame loop.
+ */
+static void apply_gain(const Crossfade_Slot *c, float *frames, unsigned n) {
+  float step = (float)M_PI_2 / (float)c->length;
+  float angle = step * (float)c->pos;
+  float co = cosf(angle), si = sinf(angle);
+  float dc = cosf(step), ds = sinf(step);
+
+  for (unsigned i = 0; i < n; i++) {
+    float g = c->fade_in ? si : co;
+    for (unsigned k = 0; k < c->channels; k++)
+      frames[i * c->channels + k] *= g;
+    float next_co = co * dc - si * ds;
+    si = si * dc + co * ds;
+    co = next_co;
+  }
+}
+
+/**
+ * @brief Sums n gained frames of slot c with the other slot o
+ *
+ * Frames o has already produced are waiting in the ring: add them and emit
+ * the sum. Frames o has not reached yet are parked for it.
+ */
+static void mix(Crossfade *x, const Crossfade_Slot *c,
+                const Crossfade_Slot *o, const float *frames, unsigned n,
+                Crossfade_Sink *sink) {
+  unsigned ch = c->channels;
+  unsigned ready = o->pos > c->pos ? o->pos - c->pos : 0;
+  if (ready > n)
+    ready = n;
+
+  for (unsigned i = 0; i < ready; i++) {
+    const float *parked = &x->ring[((c->pos + i) & RING_MASK) * ch];
+    for (unsigned k = 0; k < ch; k++)
+      x->out[i * ch + k] = parked[k] + frames[i * ch + k];
+  }
+  if (ready > 0 && sink)
+    sink(x->out, ready);
+
+  for (unsigned i = ready; i < n; i++)
+    memcpy(&x->ring[((c->pos + i) & RING_MASK) * ch], &frames[i * ch],
+           ch * sizeof(float));
+}
+
+void crossfade_process(Crossfade *x, unsigned slot, float *frames,
+                       unsigned count, Crossfade_Sink *sink) {
+  Crossfade_Slot *c = &x->slots[slot];
+  const Crossfade_Slot *o = &x->slots[1 - slot];
+
+  unsigned done = 0;
+  while (done < count) {
+    float *f = &frames[done * c->channels];
+    unsigned rest = count - done;
+
+    if (c->length == 0 || c->pos >= c->length) {
+      if (c->length != 0 && !c->fade_in) {
+        /* Faded out: silent until the feeder stops the stream */
+        memset(f, 0, (size_t)rest * c->channels * sizeof(float));
+      } else if (sink) {
+        sink(f, rest);
+      }
+      return;
+    }
+
+    unsigned n = c->length - c->pos;
+    if (n > rest)
+      n = rest;
+    if (n > CROSSFADE_CHUNK)
+      n = CROSSFADE_CHUNK;
+    apply_gain(c, f, n);
+
+    /* Sum only while both slots fade the same frames in the same layout and
+     * neither has run a whole ring ahead (e.g. the other stream stalled) */
+    bool summing =
+        !atomic_load_explicit(&x->solo, memory_order_relaxed) &&
+        o->length == c->length && o->channels == c->channels &&
+        c->channels <= CROSSFADE_MAX_CHANNELS &&
+        c->pos + n - (o->pos < c->pos ? o->pos : c->pos) <=
+            CROSSFADE_RING_FRAMES;
+    if (summing)
+      mix(x, c, o, f, n, sink);
+    else if (c->fade_in && sink)
+      sink(f, n);
+
+    c->pos += n;
+    done += n;
+  }
+}
@@ -0,0 +1,91 @@
+/**
+ * @file crossfade.h
+ * @brief Equal-power gains and the analysis mix of two overlapping streams
+ *
+ * raylib mixes every playing stream itself and only lets us hook in per
+ * stream processors, which run one stream after the other on the audio
+ * thread. Each stream's processor hands its frames to crossfade_process()
+ * under its own slot. During a fade the frames are scaled in place (cos for
+ * the outgoing, sin for the incoming slot), so raylib's mixer plays the
+ * crossfade, and the two scaled signals are summed for the sink: whichever
+ * slot runs first in a mixer pass parks its frames in a ring, the other adds
+ * its own and hands the sum on. The analyzer therefore sees what the
+ * speakers play, and outside a fade a slot forwards its frames untouched.
+ *
+ * Processors receive frames already converted to raylib's mixing format
+ * (float, the device's channel count and sample rate), whatever the track,
+ * so both slots always share one frame layout.
+ *
+ * Everything here is plain float processing with no raylib dependency, so
+ * it can be benchmarked on its own (see crossfade_bench.c).
+ */
+#ifndef CROSSFADE_H_
+#define CROSSFADE_H_
+
+#include <stdatomic.h>
+#include <stdbool.h>
+
+#define CROSSFADE_SLOTS 2        ///< Streams that can overlap
+#define CROSSFADE_MAX_CHANNELS 2 ///< Interleaved channels per frame
+#define CROSSFADE_CHUNK 1024     ///< Frames gained and emitted at a time
+/// Frames one slot may run ahead of the other (power of two)
+#define CROSSFADE_RING_FRAMES 8192
+
+/**
+ * @brief Receives the frames to analyze (same signature as a raylib
+ * AudioCallback)
+ */
+typedef void Crossfade_Sink(void *frames, unsigned count);
+
+/**
+ * @struct Crossfade_Slot
+ * @brief Fade state of one stream, advanced on the audio thread
+ */
+typedef struct {
+  unsigned pos;      ///< Frames processed since the fade began
+  unsigned length;   ///< Fade length in frames, 0 when not fading
+  unsigned channels; ///< Interleaved channels per frame
+  bool fade_in;      ///< Rising (incoming) or falling (outgoing) gain
+} Crossfade_Slot;
+
+/**
+ * @struct Crossfade
+ * @brief Both slots plus the buffers used to sum them for the sink
+ *
+ * Slot state may only be changed while that slot's processor is detached;
+ * raylib's attach takes the audio lock, which publishes the change to the
+ * audio thread.
+ */
+typedef struct {
+  Crossfade_Slot slots[CROSSFADE_SLOTS];
+  atomic_bool solo; ///< The outgoing stream stopped: stop summing
+  float ring[CROSSFADE_RING_FRAMES * CROSSFADE_MAX_CHANNELS];
+  float out[CROSSFADE_CHUNK * CROSSFADE_MAX_CHANNELS]; ///< Sums for the sink
+} Crossfade;
+
+/**
+ * @brief Makes slot play at unity gain and forward everything to the sink
+ */
+void crossfade_reset(Crossfade *x, unsigned slot, unsigned channels);
+
+/**
+ * @brief Fades slot in and the other slot out over length frames
+ *
+ * Both processors must be detached.
+ *
+ * @param length Fade length in frames at the device sample rate
+ * @param channels Interleaved channels of the mixing format
+ */
+void crossfade_begin(Crossfade *x, unsigned slot, unsigned length,
+                     unsigned channels);
+
+/**
+ * @brief Processor body: applies slot's gain to frames in place and feeds
+ * the sink (may be NULL)
+ *
+ * @param frames count interleaved frames of the slot's stream
+ */
+void crossfade_process(Crossfade *x, unsigned slot, float *frames,
+                       unsigned count, Crossfade_Sink *sink);
+
+#endif // CROSSFADE_H_
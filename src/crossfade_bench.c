@@ -0,0 +1,127 @@
+/**
+ * @file crossfade_bench.c
+ * @brief Correctness check and cost of the crossfade processors
+ *
+ * Replays what raylib's mixer does: every pass runs the processor of each
+ * playing stream over a period of frames, one stream after the other. The
+ * check feeds both slots a constant 1.0, so the sink must receive exactly
+ * cos + sin of the fade angle for every frame, in order, whichever slot
+ * runs first. The benchmark compares the per-frame cost of a single stream
+ * with two streams crossfading, i.e. the extra work a crossfade puts on the
+ * audio thread on top of decoding the second stream.
+ */
+#include <math.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+
+#include "crossfade.h"
+
+#define BENCH_CHANNELS 2
+#define BENCH_PERIOD 441        ///< Frames per mixer pass (10 ms at 44.1 kHz)
+#define BENCH_FADE (44100 * 6)  ///< Frames in the checked crossfade
+#define BENCH_FRAMES 100000000u ///< Frames per benchmark run
+
+static Crossfade fade;
+static float period[CROSSFADE_SLOTS][BENCH_PERIOD * BENCH_CHANNELS];
+
+static unsigned checked;
+static unsigned mismatches;
+static double sink_sum;
+
+static void check_sink(void *data, unsigned count) {
+  const float *frames = data;
+  for (unsigned i = 0; i < count; i++, checked++) {
+    double angle = M_PI_2 * checked / BENCH_FADE;
+    double expected = checked < BENCH_FADE ? cos(angle) + sin(angle) : 1.0;
+    for (unsigned k = 0; k < BENCH_CHANNELS; k++)
+      if (fabs(frames[i * BENCH_CHANNELS + k] - expected) > 1e-3)
+        mismatches++;
+  }
+}
+
+static void bench_sink(void *data, unsigned count) {
+  /* Keep the compiler from dropping the work */
+  sink_sum += ((const float *)data)[count - 1];
+}
+
+static void fill(float value) {
+  for (unsigned s = 0; s < CROSSFADE_SLOTS; s++)
+    for (unsigned i = 0; i < BENCH_PERIOD * BENCH_CHANNELS; i++)
+      period[s][i] = value;
+}
+
+/**
+ * @brief Runs a whole fade from slot 0 into slot 1, first slot first
+ */
+static bool check_fade(unsigned first) {
+  crossfade_begin(&fade, 1, BENCH_FADE, BENCH_CHANNELS);
+  checked = 0;
+  mismatches = 0;
+
+  for (unsigned pos = 0; pos < BENCH_FADE; pos += BENCH_PERIOD) {
+    fill(1.0f);
+    crossfade_process(&fade, first, period[first], BENCH_PERIOD,
+                      check_sink);
+    crossfade_process(&fade, 1 - first, period[1 - first], BENCH_PERIOD,
+                      check_sink);
+  }
+
+  /* The outgoing slot must end silent, the incoming one at unity */
+  fill(1.0f);
+  crossfade_process(&fade, 0, period[0], BENCH_PERIOD, NULL);
+  crossfade_process(&fade, 1, period[1], BENCH_PERIOD, NULL);
+  bool tail = period[0][0] == 0.0f && period[1][0] == 1.0f;
+
+  bool ok = tail && mismatches == 0 && checked >= BENCH_FADE;
+  printf("  slot %u first: %u frames summed, %u mismatches, tail %s: %s\n",
+         first, checked, mismatches, tail ? "ok" : "wrong",
+         ok ? "OK" : "FAIL");
+  return ok;
+}
+
+static double now_seconds(void) {
+  struct timespec t;
+  clock_gettime(CLOCK_MONOTONIC, &t);
+  return t.tv_sec + t.tv_nsec * 1e-9;
+}
+
+/**
+ * @brief Nanoseconds per output frame for one or two streams
+ */
+static double bench_streams(unsigned streams) {
+  crossfade_reset(&fade, 0, BENCH_CHANNELS);
+  double start = now_seconds();
+  for (unsigned done = 0; done < BENCH_FRAMES; done += BENCH_PERIOD) {
+    /* Fresh frames each pass, as decoded by raylib (the gains scale them
+     * in place) */
+    fill(0.25f);
+    if (streams == 2 && done % (BENCH_FADE / 2) < BENCH_PERIOD) {
+      /* Restart the fade before it ends, so every pass crosses */
+      crossfade_begin(&fade, 1, BENCH_FADE, BENCH_CHANNELS);
+    }
+    crossfade_process(&fade, 0, period[0], BENCH_PERIOD, bench_sink);
+    if (streams == 2)
+      crossfade_process(&fade, 1, period[1], BENCH_PERIOD, bench_sink);
+  }
+  return (now_seconds() - start) * 1e9 / BENCH_FRAMES;
+}
+
+int main(void) {
+  printf("Crossfade check (%u frame fade, %u frame passes):\n", BENCH_FADE,
+         BENCH_PERIOD);
+  bool ok = check_fade(0) & check_fade(1);
+
+  printf("\nCrossfade processor cost (%u frames, %u channels):\n",
+         BENCH_FRAMES, BENCH_CHANNELS);
+  double single = bench_streams(1);
+  double dual = bench_streams(2);
+  /* Share of one core needed to keep up with 44.1 kHz playback */
+  printf("  one stream   %6.2f ns/frame  %.4f%% of a core\n", single,
+         single * 44100 * 1e-7);
+  printf("  crossfading  %6.2f ns/frame  %.4f%% of a core\n", dual,
+         dual * 44100 * 1e-7);
+  printf("  (sink checksum %g)\n", sink_sum);
+
+  return ok ? 0 : 1;
+}
@@ -0,0 +1,239 @@
+/**
+ * @file dir_model.c
+ * @brief Off-thread directory listing for the internal browser
+ */
+#include "dir_model.h"
+
+#include <dirent.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <sys/stat.h>
+
+#define DIR_LABEL_PREFIX "[DIR] "
+
+/// Extensions the browser offers (raylib decodes more, these are the
+/// common), then playlist files
+static const char *const listed_extensions[] = {
+    ".mp3", ".wav", ".ogg", ".flac", ".m3u", ".m3u8", ".pls"};
+
+/**
+ * @struct Row
+ * @brief Entry recorded while listing; offsets because labels may move
+ */
+typedef struct {
+  size_t label;
+  size_t name;
+  bool is_dir;
+} Row;
+
+static bool is_listed_file(const char *name) {
+  const char *dot = strrchr(name, '.');
+  if (!dot)
+    return false;
+  for (size_t i = 0;
+       i < sizeof(listed_extensions) / sizeof(*listed_extensions); i++)
+    if (strcasecmp(dot, listed_extensions[i]) == 0)
+      return true;
+  return false;
+}
+
+/**
+ * @brief Directory or file, using d_type and stat only when it is unknown
+ */
+static bool classify(DIR *dir, const struct dirent *entry, bool *is_dir) {
+  switch (entry->d_type) {
+  case DT_DIR:
+    *is_dir = true;
+    return true;
+  case DT_REG:
+    *is_dir = false;
+    return true;
+  case DT_LNK:
+  case DT_UNKNOWN: {
+    struct stat st;
+    if (fstatat(dirfd(dir), entry->d_name, &st, 0) != 0)
+      return false;
+    *is_dir = S_ISDIR(st.st_mode);
+    return *is_dir || S_ISREG(st.st_mode);
+  }
+  default:
+    return false;
+  }
+}
+
+static int compare_entries(const void *a, const void *b) {
+  const Dir_Model_Entry *x = a, *y = b;
+  if (x->is_dir != y->is_dir)
+    return x->is_dir ? -1 : 1;
+  int order = strcasecmp(x->name, y->name);
+  return order ? order : strcmp(x->name, y->name);
+}
+
+/**
+ * @brief Fills l with the directory l->path names
+ *
+ * An unreadable directory yields an empty listing.
+ */
+static void list(Dir_Listing *l) {
+  l->entries = NULL;
+  l->labels = NULL;
+  l->count = 0;
+  l->mtime = (struct timespec){0};
+
+  DIR *dir = opendir(l->path);
+  if (!dir)
+    return;
+  struct stat st;
+  if (fstat(dirfd(dir), &st) == 0)
+    l->mtime = st.st_mtim;
+
+  Row *rows = NULL;
+  size_t count = 0, rows_capacity = 0;
+  char *labels = NULL;
+  size_t used = 0, labels_capacity = 0;
+
+  struct dirent *entry;
+  while ((entry = readdir(dir))) {
+    bool is_dir;
+    if (entry->d_name[0] == '.' || !classify(dir, entry, &is_dir))
+      continue;
+    if (!is_dir && !is_listed_file(entry->d_name))
+      continue;
+
+    size_t prefix = is_dir ? strlen(DIR_LABEL_PREFIX) : 0;
+    size_t size = prefix + strlen(entry->d_name) + 1;
+    if (count == rows_capacity) {
+      size_t grown = rows_capacity ? rows_capacity * 2 : 256;
+      Row *items = realloc(rows, grown * sizeof(*rows));
+      if (!items)
+        break;
+      rows = items;
+      rows_capacity = grown;
+    }
+    if (used + size > labels_capacity) {
+      size_t grown = labels_capacity ? labels_capacity * 2 : 8192;
+      while (grown < used + size)
+        grown *= 2;
+      char *items = realloc(labels, grown);
+      if (!items)
+        break;
+      labels = items;
+      labels_capacity = grown;
+    }
+
+    memcpy(&labels[used], DIR_LABEL_PREFIX, prefix);
+    memcpy(&labels[used + prefix], entry->d_name, size - prefix);
+    rows[count++] =
+        (Row){.label = used, .name = used + prefix, .is_dir = is_dir};
+    used += size;
+  }
+  closedir(dir);
+
+  l->entries = count ? malloc(count * sizeof(*l->entries)) : NULL;
+  if (l->entries) {
+    for (size_t i = 0; i < count; i++)
+      l->entries[i] = (Dir_Model_Entry){
+          .label = &labels[rows[i].label],
+          .name = &labels[rows[i].name],
+          .is_dir = rows[i].is_dir,
+      };
+    qsort(l->entries, count, sizeof(*l->entries), compare_entries);
+    l->count = count;
+    l->labels = labels;
+  } else {
+    free(labels);
+  }
+  free(rows);
+}
+
+static void free_listing(Dir_Listing *l) {
+  free(l->entries);
+  free(l->labels);
+  l->entries = NULL;
+  l->labels = NULL;
+  l->count = 0;
+}
+
+static void *list_thread(void *arg) {
+  Dir_Model *m = arg;
+  list(&m->pending);
+  atomic_store_explicit(&m->state, DIR_MODEL_READY, memory_order_release);
+  return NULL;
+}
+
+/**
+ * @brief True if current already shows path as it is on disk
+ */
+static bool cached(const Dir_Model *m, const char *path) {
+  if (strcmp(m->current.path, path) != 0)
+    return false;
+  struct stat st;
+  if (stat(path, &st) != 0)
+    return m->current.count == 0;
+  return st.st_mtim.tv_sec == m->current.mtime.tv_sec &&
+         st.st_mtim.tv_nsec == m->current.mtime.tv_nsec;
+}
+
+void dir_model_open(Dir_Model *m, const char *path) {
+  if (atomic_load_explicit(&m->state, memory_order_acquire) !=
+      DIR_MODEL_IDLE) {
+    snprintf(m->wanted, sizeof(m->wanted), "%s", path);
+    m->has_wanted = true;
+    return;
+  }
+  m->has_wanted = false;
+  if (cached(m, path))
+    return;
+
+  snprintf(m->pending.path, sizeof(m->pending.path), "%s", path);
+  atomic_store_explicit(&m->state, DIR_MODEL_LISTING, memory_order_relaxed);
+  if (pthread_create(&m->thread, NULL, list_thread, m) != 0) {
+    /* No thread: list right here rather than not at all */
+    list(&m->pending);
+    atomic_store_explicit(&m->state, DIR_MODEL_IDLE, memory_order_relaxed);
+    free_listing(&m->current);
+    m->current = m->pending;
+  }
+}
+
+bool dir_model_poll(Dir_Model *m) {
+  bool changed = false;
+  if (atomic_load_explicit(&m->state, memory_order_acquire) ==
+      DIR_MODEL_READY) {
+    pthread_join(m->thread, NULL);
+    free_listing(&m->current);
+    m->current = m->pending;
+    atomic_store_explicit(&m->state, DIR_MODEL_IDLE, memory_order_relaxed);
+    changed = true;
+  }
+  if (m->has_wanted &&
+      atomic_load_explicit(&m->state, memory_order_relaxed) ==
+          DIR_MODEL_IDLE)
+    dir_model_open(m, m->wanted);
+  return changed;
+}
+
+bool dir_model_loading(const Dir_Model *m) {
+  return atomic_load_explicit(&m->state, memory_order_relaxed) !=
+             DIR_MODEL_IDLE ||
+         m->has_wanted;
+}
+
+void dir_model_wait(Dir_Model *m) {
+  if (atomic_load_explicit(&m->state, memory_order_acquire) ==
+      DIR_MODEL_IDLE)
+    return;
+  pthread_join(m->thread, NULL);
+  free_listing(&m->pending);
+  m->has_wanted = false;
+  atomic_store_explicit(&m->state, DIR_MODEL_IDLE, memory_order_relaxed);
+}
+
+void dir_model_free(Dir_Model *m) {
+  dir_model_wait(m);
+  free_listing(&m->current);
+  m->current.path[0] = '\0';
+}
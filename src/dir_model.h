@@ -0,0 +1,106 @@
+/**
+ * @file dir_model.h
+ * @brief Directory listing behind the internal file browser
+ *
+ * The browser used to stat every entry and test its extension on every
+ * frame. The model classifies entries once, while listing: readdir()'s
+ * d_type tells directories from files without a stat (fstatat() is only
+ * needed for symlinks and filesystems that leave d_type unknown), hidden
+ * entries and files that are neither audio nor playlists are dropped, the
+ * rest is sorted (directories first, then by name) and row labels are
+ * built up front. All of that runs on a helper thread, so a huge directory
+ * never stalls a frame; the render thread swaps the finished listing in
+ * when it polls.
+ *
+ * Reopening the directory already shown is free as long as its mtime has
+ * not changed, so toggling the browser does not list it again.
+ */
+#ifndef DIR_MODEL_H_
+#define DIR_MODEL_H_
+
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <time.h>
+
+#define DIR_MODEL_PATH_MAX 512 ///< Longest directory path
+
+/**
+ * @struct Dir_Model_Entry
+ * @brief One visible row
+ */
+typedef struct {
+  const char *label; ///< Text to draw ("[DIR] name" for directories)
+  const char *name;  ///< Entry name (points into label)
+  bool is_dir;       ///< Directory (navigable) or audio or playlist file
+} Dir_Model_Entry;
+
+/**
+ * @struct Dir_Listing
+ * @brief Classified, sorted entries of one directory
+ */
+typedef struct {
+  char path[DIR_MODEL_PATH_MAX]; ///< Directory listed
+  struct timespec mtime;         ///< Its modification time when listed
+  Dir_Model_Entry *entries;      ///< count rows
+  size_t count;                  ///< Number of entries
+  char *labels;                  ///< One allocation holding every label
+} Dir_Listing;
+
+/**
+ * @enum Dir_Model_State
+ * @brief Who owns the pending listing
+ */
+typedef enum {
+  DIR_MODEL_IDLE,    ///< Nothing in flight
+  DIR_MODEL_LISTING, ///< Helper thread is filling pending
+  DIR_MODEL_READY,   ///< pending is complete, waiting for dir_model_poll()
+} Dir_Model_State;
+
+/**
+ * @struct Dir_Model
+ * @brief Listing shown by the browser plus the one being built
+ */
+typedef struct {
+  Dir_Listing current;             ///< Shown; owned by the render thread
+  Dir_Listing pending;             ///< Being built by the helper thread
+  char wanted[DIR_MODEL_PATH_MAX]; ///< Next path to list once idle
+  bool has_wanted;                 ///< Whether wanted is set
+  atomic_int state;                ///< Dir_Model_State
+  pthread_t thread;
+} Dir_Model;
+
+/**
+ * @brief Requests a listing of path (render thread)
+ *
+ * Returns immediately. If a listing is already in flight, path is listed
+ * after it (only the latest request is kept).
+ */
+void dir_model_open(Dir_Model *m, const char *path);
+
+/**
+ * @brief Swaps in a finished listing and starts a queued request
+ *
+ * @return true if current changed
+ */
+bool dir_model_poll(Dir_Model *m);
+
+/**
+ * @brief True while the listing for the last requested path is not shown
+ */
+bool dir_model_loading(const Dir_Model *m);
+
+/**
+ * @brief Waits for the helper thread and drops any pending result
+ *
+ * Needed before the code running the helper thread is unloaded.
+ */
+void dir_model_wait(Dir_Model *m);
+
+/**
+ * @brief Frees the shown listing
+ */
+void dir_model_free(Dir_Model *m);
+
+#endif // DIR_MODEL_H_
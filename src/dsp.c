@@ -0,0 +1,376 @@
+/**
+ * @file dsp.c
+ * @brief Scalar, SSE2, AVX2 and NEON implementations of the dsp_* kernels
+ *
+ * All vector paths use unaligned loads so callers can pass arbitrary
+ * sub-ranges (e.g. a single frequency band) and finish with a scalar tail.
+ */
+#include "dsp.h"
+
+#include <math.h>
+#include <pthread.h>
+
+#if !defined(DSP_SCALAR_ONLY) && (defined(__x86_64__) || defined(__i386__))
+#define DSP_X86
+#include <immintrin.h>
+#elif !defined(DSP_SCALAR_ONLY) && defined(__aarch64__)
+#define DSP_NEON
+#include <arm_neon.h>
+#endif
+
+typedef struct {
+  void (*mul)(float dst[], const float a[], const float b[], size_t n);
+  float (*max_abs)(const float x[], size_t n);
+  void (*deinterleave2)(float l[], float r[], const float src[], size_t n);
+  void (*butterflies)(float complex lo[], float complex hi[],
+                      const float complex w[], size_t h);
+} Dsp_Kernels;
+
+/* ---------------------------------------------------------------- scalar */
+
+static void mul_scalar(float dst[], const float a[], const float b[],
+                       size_t n) {
+  for (size_t i = 0; i < n; i++)
+    dst[i] = a[i] * b[i];
+}
+
+static void deinterleave2_scalar(float l[], float r[], const float src[],
+                                 size_t n) {
+  for (size_t i = 0; i < n; i++) {
+    l[i] = src[2 * i];
+    r[i] = src[2 * i + 1];
+  }
+}
+
+static float max_abs_scalar(const float x[], size_t n) {
+  float m = 0.0f;
+  for (size_t i = 0; i < n; i++) {
+    float a = fabsf(x[i]);
+    if (a > m)
+      m = a;
+  }
+  return m;
+}
+
+static void butterflies_scalar(float complex lo[], float complex hi[],
+                               const float complex w[], size_t h) {
+  for (size_t k = 0; k < h; k++) {
+    float wr = crealf(w[k]), wi = cimagf(w[k]);
+    float hr = crealf(hi[k]), him = cimagf(hi[k]);
+    float complex t = CMPLXF(wr * hr - wi * him, wr * him + wi * hr);
+    float complex e = lo[k];
+    lo[k] = e + t;
+    hi[k] = e - t;
+  }
+}
+
+/* ------------------------------------------------------------------- x86 */
+
+#ifdef DSP_X86
+static void mul_sse2(float dst[], const float a[], const float b[], size_t n) {
+  size_t i = 0;
+  for (; i + 4 <= n; i += 4)
+    _mm_storeu_ps(dst + i,
+                  _mm_mul_ps(_mm_loadu_ps(a + i), _mm_loadu_ps(b + i)));
+  mul_scalar(dst + i, a + i, b + i, n - i);
+}
+
+static void deinterleave2_sse2(float l[], float r[], const float src[],
+                               size_t n) {
+  size_t i = 0;
+  for (; i + 4 <= n; i += 4) {
+    __m128 a = _mm_loadu_ps(src + 2 * i);     // L0 R0 L1 R1
+    __m128 b = _mm_loadu_ps(src + 2 * i + 4); // L2 R2 L3 R3
+    _mm_storeu_ps(l + i, _mm_shuffle_ps(a, b, _MM_SHUFFLE(2, 0, 2, 0)));
+    _mm_storeu_ps(r + i, _mm_shuffle_ps(a, b, _MM_SHUFFLE(3, 1, 3, 1)));
+  }
+  deinterleave2_scalar(l + i, r + i, src + 2 * i, n - i);
+}
+
+static float max_abs_sse2(const float x[], size_t n) {
+  const __m128 sign = _mm_set1_ps(-0.0f);
+  __m128 m = _mm_setzero_ps();
+  size_t i = 0;
+  for (; i + 4 <= n; i += 4)
+    m = _mm_max_ps(m, _mm_andnot_ps(sign, _mm_loadu_ps(x + i)));
+
+  float lanes[4];
+  _mm_storeu_ps(lanes, m);
+  float r = max_abs_scalar(x + i, n - i);
+  for (int l = 0; l < 4; l++)
+    if (lanes[l] > r)
+      r = lanes[l];
+  return r;
+}
+
+static void butterflies_sse2(float complex lo[], float complex hi[],
+                             const float complex w[], size_t h) {
+  const __m128 neg_re = _mm_set_ps(0.0f, -0.0f, 0.0f, -0.0f);
+  float *l = (float *)lo, *u = (float *)hi;
+  const float *tw = (const float *)w;
+  size_t k = 0;
+  for (; k + 2 <= h; k += 2) {
+    __m128 wv = _mm_loadu_ps(tw + 2 * k);
+    __m128 hv = _mm_loadu_ps(u + 2 * k);
+    __m128 wr = _mm_shuffle_ps(wv, wv, _MM_SHUFFLE(2, 2, 0, 0));
+    __m128 wi = _mm_shuffle_ps(wv, wv, _MM_SHUFFLE(3, 3, 1, 1));
+    __m128 hs = _mm_shuffle_ps(hv, hv, _MM_SHUFFLE(2, 3, 0, 1));
+    /* (wr*hr - wi*hi, wr*hi + wi*hr) */
+    __m128 t = _mm_add_ps(_mm_mul_ps(wr, hv),
+                          _mm_xor_ps(_mm_mul_ps(wi, hs), neg_re));
+    __m128 e = _mm_loadu_ps(l + 2 * k);
+    _mm_storeu_ps(l + 2 * k, _mm_add_ps(e, t));
+    _mm_storeu_ps(u + 2 * k, _mm_sub_ps(e, t));
+  }
+  butterflies_scalar(lo + k, hi + k, w + k, h - k);
+}
+
+__attribute__((target("avx2,fma"))) static void
+mul_avx2(float dst[], const float a[], const float b[], size_t n) {
+  size_t i = 0;
+  for (; i + 8 <= n; i += 8)
+    _mm256_storeu_ps(dst + i, _mm256_mul_ps(_mm256_loadu_ps(a + i),
+                                            _mm256_loadu_ps(b + i)));
+  _mm256_zeroupper(); // the tail call below skips the implicit vzeroupper
+  mul_scalar(dst + i, a + i, b + i, n - i);
+}
+
+__attribute__((target("avx2,fma"))) static void
+deinterleave2_avx2(float l[], float r[], const float src[], size_t n) {
+  size_t i = 0;
+  for (; i + 8 <= n; i += 8) {
+    __m256 a = _mm256_loadu_ps(src + 2 * i);
+    __m256 b = _mm256_loadu_ps(src + 2 * i + 8);
+    /* Per 128-bit lane: L0 L1 L4 L5 | L2 L3 L6 L7, then fix the lane order */
+    __m256 ls = _mm256_shuffle_ps(a, b, _MM_SHUFFLE(2, 0, 2, 0));
+    __m256 rs = _mm256_shuffle_ps(a, b, _MM_SHUFFLE(3, 1, 3, 1));
+    __m256d lq = _mm256_permute4x64_pd(_mm256_castps_pd(ls),
+                                       _MM_SHUFFLE(3, 1, 2, 0));
+    _mm256_storeu_ps(l + i, _mm256_castpd_ps(lq));
+    __m256d rq = _mm256_permute4x64_pd(_mm256_castps_pd(rs),
+                                       _MM_SHUFFLE(3, 1, 2, 0));
+    _mm256_storeu_ps(r + i, _mm256_castpd_ps(rq));
+  }
+  _mm256_zeroupper();
+  deinterleave2_scalar(l + i, r + i, src + 2 * i, n - i);
+}
+
+__attribute__((target("avx2,fma"))) static float
+max_abs_avx2(const float x[], size_t n) {
+  const __m256 sign = _mm256_set1_ps(-0.0f);
+  __m256 m0 = _mm256_setzero_ps(), m1 = _mm256_setzero_ps();
+  size_t i = 0;
+  for (; i + 16 <= n; i += 16) {
+    m0 = _mm256_max_ps(m0, _mm256_andnot_ps(sign, _mm256_loadu_ps(x + i)));
+    m1 = _mm256_max_ps(m1,
+                       _mm256_andnot_ps(sign, _mm256_loadu_ps(x + i + 8)));
+  }
+  m0 = _mm256_max_ps(m0, m1);
+  __m128 m = _mm_max_ps(_mm256_castps256_ps128(m0),
+                        _mm256_extractf128_ps(m0, 1));
+  m = _mm_max_ps(m, _mm_movehl_ps(m, m));
+  m = _mm_max_ss(m, _mm_shuffle_ps(m, m, 1));
+
+  float r = max_abs_scalar(x + i, n - i);
+  float v = _mm_cvtss_f32(m);
+  return v > r ? v : r;
+}
+
+__attribute__((target("avx2,fma"))) static void
+butterflies_avx2(float complex lo[], float complex hi[],
+                 const float complex w[], size_t h) {
+  float *l = (float *)lo, *u = (float *)hi;
+  const float *tw = (const float *)w;
+  size_t k = 0;
+  for (; k + 4 <= h; k += 4) {
+    __m256 wv = _mm256_loadu_ps(tw + 2 * k);
+    __m256 hv = _mm256_loadu_ps(u + 2 * k);
+    __m256 wr = _mm256_moveldup_ps(wv);
+    __m256 wi = _mm256_movehdup_ps(wv);
+    __m256 hs = _mm256_permute_ps(hv, _MM_SHUFFLE(2, 3, 0, 1));
+    __m256 t = _mm256_fmaddsub_ps(wr, hv, _mm256_mul_ps(wi, hs));
+    __m256 e = _mm256_loadu_ps(l + 2 * k);
+    _mm256_storeu_ps(l + 2 * k, _mm256_add_ps(e, t));
+    _mm256_storeu_ps(u + 2 * k, _mm256_sub_ps(e, t));
+  }
+  _mm256_zeroupper();
+  butterflies_sse2(lo + k, hi + k, w + k, h - k);
+}
+#endif // DSP_X86
+
+/* ------------------------------------------------------------------ NEON */
+
+#ifdef DSP_NEON
+static void mul_neon(float dst[], const float a[], const float b[], size_t n) {
+  size_t i = 0;
+  for (; i + 4 <= n; i += 4)
+    vst1q_f32(dst + i, vmulq_f32(vld1q_f32(a + i), vld1q_f32(b + i)));
+  mul_scalar(dst + i, a + i, b + i, n - i);
+}
+
+static void deinterleave2_neon(float l[], float r[], const float src[],
+                               size_t n) {
+  size_t i = 0;
+  for (; i + 4 <= n; i += 4) {
+    float32x4x2_t v = vld2q_f32(src + 2 * i);
+    vst1q_f32(l + i, v.val[0]);
+    vst1q_f32(r + i, v.val[1]);
+  }
+  deinterleave2_scalar(l + i, r + i, src + 2 * i, n - i);
+}
+
+static float max_abs_neon(const float x[], size_t n) {
+  float32x4_t m = vdupq_n_f32(0.0f);
+  size_t i = 0;
+  for (; i + 4 <= n; i += 4)
+    m = vmaxq_f32(m, vabsq_f32(vld1q_f32(x + i)));
+
+  float r = max_abs_scalar(x + i, n - i);
+  float v = vmaxvq_f32(m);
+  return v > r ? v : r;
+}
+
+static void butterflies_neon(float complex lo[], float complex hi[],
+                             const float complex w[], size_t h) {
+  float *l = (float *)lo, *u = (float *)hi;
+  const float *tw = (const float *)w;
+  size_t k = 0;
+  for (; k + 4 <= h; k += 4) {
+    float32x4x2_t wv = vld2q_f32(tw + 2 * k);
+    float32x4x2_t hv = vld2q_f32(u + 2 * k);
+    float32x4x2_t e = vld2q_f32(l + 2 * k);
+    float32x4x2_t t;
+    t.val[0] =
+        vmlsq_f32(vmulq_f32(wv.val[0], hv.val[0]), wv.val[1], hv.val[1]);
+    t.val[1] =
+        vmlaq_f32(vmulq_f32(wv.val[0], hv.val[1]), wv.val[1], hv.val[0]);
+
+    float32x4x2_t sum, diff;
+    sum.val[0] = vaddq_f32(e.val[0], t.val[0]);
+    sum.val[1] = vaddq_f32(e.val[1], t.val[1]);
+    diff.val[0] = vsubq_f32(e.val[0], t.val[0]);
+    diff.val[1] = vsubq_f32(e.val[1], t.val[1]);
+    vst2q_f32(l + 2 * k, sum);
+    vst2q_f32(u + 2 * k, diff);
+  }
+  butterflies_scalar(lo + k, hi + k, w + k, h - k);
+}
+#endif // DSP_NEON
+
+/* -------------------------------------------------------------- dispatch */
+
+static const Dsp_Kernels backends[COUNT_DSP_BACKENDS] = {
+    [DSP_BACKEND_SCALAR] = {mul_scalar, max_abs_scalar, deinterleave2_scalar,
+                            butterflies_scalar},
+#ifdef DSP_X86
+    [DSP_BACKEND_SSE2] = {mul_sse2, max_abs_sse2, deinterleave2_sse2,
+                          butterflies_sse2},
+    [DSP_BACKEND_AVX2] = {mul_avx2, max_abs_avx2, deinterleave2_avx2,
+                          butterflies_avx2},
+#endif
+#ifdef DSP_NEON
+    [DSP_BACKEND_NEON] = {mul_neon, max_abs_neon, deinterleave2_neon,
+                          butterflies_neon},
+#endif
+};
+
+static const char *backend_names[COUNT_DSP_BACKENDS] = {
+    [DSP_BACKEND_SCALAR] = "scalar",
+    [DSP_BACKEND_SSE2] = "sse2",
+    [DSP_BACKEND_AVX2] = "avx2",
+    [DSP_BACKEND_NEON] = "neon",
+};
+
+static pthread_once_t dispatch_once = PTHREAD_ONCE_INIT;
+static Dsp_Backend current = DSP_BACKEND_SCALAR;
+static const Dsp_Kernels *kernels = &backends[DSP_BACKEND_SCALAR];
+
+static bool backend_supported(Dsp_Backend backend) {
+  switch (backend) {
+  case DSP_BACKEND_SCALAR:
+    return true;
+#ifdef DSP_X86
+  case DSP_BACKEND_SSE2:
+    __builtin_cpu_init();
+    return __builtin_cpu_supports("sse2");
+  case DSP_BACKEND_AVX2:
+    __builtin_cpu_init();
+    return __builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma");
+#endif
+#ifdef DSP_NEON
+  case DSP_BACKEND_NEON:
+    return true;
+#endif
+  default:
+    return false;
+  }
+}
+
+static void dispatch_init(void) {
+  static const Dsp_Backend preference[] = {
+      DSP_BACKEND_AVX2,
+      DSP_BACKEND_NEON,
+      DSP_BACKEND_SSE2,
+  };
+  for (size_t i = 0; i < sizeof(preference) / sizeof(preference[0]); i++) {
+    if (backend_supported(preference[i])) {
+      current = preference[i];
+      kernels = &backends[current];
+      return;
+    }
+  }
+}
+
+static inline const Dsp_Kernels *get_kernels(void) {
+  pthread_once(&dispatch_once, dispatch_init);
+  return kernels;
+}
+
+Dsp_Backend dsp_backend(void) {
+  get_kernels();
+  return current;
+}
+
+bool dsp_set_backend(Dsp_Backend backend) {
+  get_kernels();
+  if (backend < 0 || backend >= COUNT_DSP_BACKENDS ||
+      !backend_supported(backend))
+    return false;
+  current = backend;
+  kernels = &backends[backend];
+  return true;
+}
+
+const char *dsp_backend_name(Dsp_Backend backend) {
+  if (backend < 0 || backend >= COUNT_DSP_BACKENDS)
+    return "unknown";
+  return backend_names[backend];
+}
+
+void dsp_mul(float dst[], const float a[], const float b[], size_t n) {
+  get_kernels()->mul(dst, a, b, n);
+}
+
+void dsp_deinterleave(float l[], float r[], const float src[], size_t frames,
+                      size_t channels) {
+  if (channels == 2) {
+    get_kernels()->deinterleave2(l, r, src, frames);
+  } else if (channels == 1) {
+    for (size_t i = 0; i < frames; i++)
+      l[i] = r[i] = src[i];
+  } else {
+    for (size_t i = 0; i < frames; i++) {
+      l[i] = src[i * channels];
+      r[i] = src[i * channels + 1];
+    }
+  }
+}
+
+float dsp_max_abs(const float x[], size_t n) {
+  return get_kernels()->max_abs(x, n);
+}
+
+void dsp_butterflies(float complex lo[], float complex hi[],
+                     const float complex w[], size_t h) {
+  get_kernels()->butterflies(lo, hi, w, h);
+}
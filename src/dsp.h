@@ -0,0 +1,78 @@
+/**
+ * @file dsp.h
+ * @brief Vectorized kernels for the spectrum pipeline with runtime dispatch
+ *
+ * Each kernel has a scalar version plus SSE2/AVX2 (x86) or NEON (ARM)
+ * versions. The fastest one supported by the running CPU is picked on first
+ * use. Building with -DDSP_SCALAR_ONLY (make SIMD=0) keeps only the scalar
+ * path.
+ */
+#ifndef DSP_H_
+#define DSP_H_
+
+#include <complex.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+/**
+ * @enum Dsp_Backend
+ * @brief Instruction set used by the dsp_* kernels
+ */
+typedef enum {
+  DSP_BACKEND_SCALAR,
+  DSP_BACKEND_SSE2,
+  DSP_BACKEND_AVX2,
+  DSP_BACKEND_NEON,
+  COUNT_DSP_BACKENDS,
+} Dsp_Backend;
+
+/**
+ * @brief Returns the backend currently used by the kernels
+ */
+Dsp_Backend dsp_backend(void);
+
+/**
+ * @brief Forces a backend (used by the benchmark to compare implementations)
+ *
+ * Not thread-safe: only call while no kernel is running.
+ *
+ * @return false if the backend is not available on this CPU/build
+ */
+bool dsp_set_backend(Dsp_Backend backend);
+
+/**
+ * @brief Human-readable backend name
+ */
+const char *dsp_backend_name(Dsp_Backend backend);
+
+/**
+ * @brief dst[i] = a[i] * b[i] for i in [0, n)
+ */
+void dsp_mul(float dst[], const float a[], const float b[], size_t n);
+
+/**
+ * @brief Splits the first two channels of interleaved frames into l and r
+ *
+ * Mono input (channels == 1) is copied to both outputs; extra channels
+ * beyond the second are ignored. Reads src exactly once.
+ */
+void dsp_deinterleave(float l[], float r[], const float src[], size_t frames,
+                      size_t channels);
+
+/**
+ * @brief Largest |x[i]| for i in [0, n), or 0 if n == 0
+ *
+ * Applied to a float complex array reinterpreted as 2n floats this is the
+ * maximum infinity-norm amplitude of the bins.
+ */
+float dsp_max_abs(const float x[], size_t n);
+
+/**
+ * @brief Radix-2 DIT butterflies for one block of an FFT stage
+ *
+ * For k in [0, h): t = w[k] * hi[k]; lo[k] += t; hi[k] = old lo[k] - t.
+ */
+void dsp_butterflies(float complex lo[], float complex hi[],
+                     const float complex w[], size_t h);
+
+#endif // DSP_H_
@@ -1,13 +1,42 @@
+/**
+ * @file fft.c
+ * @brief FFT test and microbenchmark
+ *
+ * Checks the iterative engine from fft_engine.c (complex and real-input
+ * paths) against the original recursive Cooley-Tukey implementation and
+ * times all three for N = 1024 .. 65536, then compares the DSP kernel
+ * backends on one full analysis pass (window + r2c FFT + peak scan) and the
+ * per-frame band mapping against the precomputed table from bands.c.
+ */
 #include <assert.h>
 #include <complex.h>
 #include <math.h>
+#include <stdbool.h>
 #include <stddef.h>
 #include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
 
-float pi;
+#include "bands.h"
+#include "dsp.h"
+#include "fft_engine.h"
+
+#define PI 3.14159265358979323846f
 
 // Clear floats
 #define EPS 1e-5f
+
+#define BENCH_MIN_N (1 << 10)
+#define BENCH_MAX_N (1 << 16)
+#define BENCH_MIN_SECONDS 0.25 ///< Minimum wall time spent per measurement
+#define ANALYSIS_N (1 << 13)    ///< Window size used by the visualizer
+#define ANALYSIS_BARS 72        ///< Default bar count of the visualizer
+#define ANALYSIS_RATE 48000     ///< Sample rate for the band benchmark
+
+/**
+ * @brief Recursive radix-2 FFT, kept as the reference implementation
+ */
 void fft(float in[], int stride, float complex out[], size_t size) {
 
   assert(size > 0);
@@ -21,36 +50,265 @@ void fft(float in[], int stride, float complex out[], size_t size) {
 
   for (size_t k = 0; k < size / 2; k++) {
     float t = (float)k / size;
-    float complex v = cexp(-I * 2 * pi * t) * out[k + size / 2];
+    float complex v = cexpf(-I * 2 * PI * t) * out[k + size / 2];
     float complex e = out[k];
 
     out[k] = e + v;
     out[k + size / 2] = e - v;
   }
 }
-int main() {
+
+static double now_seconds(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+/**
+ * @brief Largest bin-wise difference between two spectra, relative to peak
+ */
+static float max_rel_error(const float complex a[], const float complex b[],
+                           size_t n) {
+  float peak = 1e-12f;
+  float err = 0.0f;
+  for (size_t i = 0; i < n; i++) {
+    float m = cabsf(a[i]);
+    if (m > peak)
+      peak = m;
+    float d = cabsf(a[i] - b[i]);
+    if (d > err)
+      err = d;
+  }
+  return err / peak;
+}
+
+static void print_small_spectrum(void) {
   printf("This is a fft test\n");
   float in[8];
   for (int n = 0; n < 8; n++) {
-    in[n] = sinf(2.0f * pi * 8.0f * n / 8.0f);
+    in[n] = sinf(2.0f * PI * 2.0f * n / 8.0f);
   }
 
   float complex out[8];
-
-  fft(in, 1, out, 8);
+  fft_real(fft_plan_get(8), in, out);
 
   for (size_t i = 0; i < 8; i++) {
-
-    if ((i % 8) == 0) {
-      printf("\n");
-    }
-    float re;
-    float im;
-    if (fabsf(crealf(out[i])) < EPS)
+    float re = crealf(out[i]);
+    float im = cimagf(out[i]);
+    if (fabsf(re) < EPS)
       re = 0.0f;
-    if (fabsf(cimagf(out[i])) < EPS)
+    if (fabsf(im) < EPS)
       im = 0.0f;
     printf("z = %f + %fi\n", re, im);
   }
+  printf("\n");
+}
+
+/**
+ * @brief Times window + r2c + peak scan on every available DSP backend
+ *
+ * @return false if a backend disagrees with the scalar result
+ */
+static bool bench_backends(const float in[]) {
+  static float window[ANALYSIS_N], tmp[ANALYSIS_N];
+  static float complex spectrum[ANALYSIS_N / 2 + 1];
+  static float complex ref[ANALYSIS_N / 2 + 1];
+
+  for (size_t i = 0; i < ANALYSIS_N; i++)
+    window[i] = 0.5f * (1.0f - cosf(2.0f * PI * i / (ANALYSIS_N - 1)));
+
+  const Fft_Plan *plan = fft_plan_get(ANALYSIS_N);
+  Dsp_Backend best = dsp_backend();
+  bool ok = true;
+
+  printf("\nAnalysis pass at N=%d (default backend: %s)\n", ANALYSIS_N,
+         dsp_backend_name(best));
+  printf("%8s %12s %10s\n", "backend", "pass(us)", "rel.err");
+
+  for (Dsp_Backend b = 0; b < COUNT_DSP_BACKENDS; b++) {
+    if (!dsp_set_backend(b))
+      continue;
+
+    dsp_mul(tmp, in, window, ANALYSIS_N);
+    fft_r2c(plan, tmp, spectrum);
+    if (b == DSP_BACKEND_SCALAR)
+      memcpy(ref, spectrum, sizeof(ref));
+    float err = max_rel_error(ref, spectrum, ANALYSIS_N / 2 + 1);
+    if (err > 1e-4f)
+      ok = false;
+
+    size_t iters = 0;
+    volatile float sink = 0.0f;
+    double start = now_seconds(), elapsed;
+    do {
+      dsp_mul(tmp, in, window, ANALYSIS_N);
+      fft_r2c(plan, tmp, spectrum);
+      sink += dsp_max_abs((const float *)spectrum, ANALYSIS_N);
+      iters++;
+    } while ((elapsed = now_seconds() - start) < BENCH_MIN_SECONDS);
+    (void)sink;
+
+    printf("%8s %12.1f %10.2e\n", dsp_backend_name(b),
+           elapsed / iters * 1e6, err);
+  }
+
+  dsp_set_backend(best);
+  return ok;
+}
+
+/**
+ * @brief Band mapping as it was done for every frame before bands.c
+ *
+ * Two powf calls and a bin range per band, whole bins only.
+ */
+static void band_levels_per_frame(const float complex spectrum[], size_t n,
+                                  unsigned sample_rate, unsigned bars,
+                                  float out[]) {
+  float freq_min = 20.0f;
+  float freq_max = sample_rate * 0.5f;
+  for (unsigned i = 0; i < bars; i++) {
+    float f0 = freq_min * powf(freq_max / freq_min, (float)i / bars);
+    float f1 = freq_min * powf(freq_max / freq_min, (float)(i + 1) / bars);
+    size_t k0 = (size_t)(f0 * n / sample_rate);
+    size_t k1 = (size_t)(f1 * n / sample_rate);
+    if (k1 <= k0)
+      k1 = k0 + 1;
+    if (k1 > n / 2)
+      k1 = n / 2;
+    out[i] = 0.0f;
+    if (k0 < k1)
+      out[i] = dsp_max_abs((const float *)&spectrum[k0], 2 * (k1 - k0));
+  }
+}
+
+/**
+ * @brief Times per-frame band mapping against the cached band table
+ *
+ * @return false if a band level lies outside the range of its bins
+ */
+static bool bench_band_mapping(const float in[]) {
+  static float complex spectrum[ANALYSIS_N / 2 + 1];
+  static Band_Map map;
+  float levels[ANALYSIS_BARS];
+
+  fft_r2c(fft_plan_get(ANALYSIS_N), in, spectrum);
+
+  double start = now_seconds(), elapsed;
+  size_t builds = 0;
+  do {
+    band_map_build(&map, ANALYSIS_N, ANALYSIS_RATE, ANALYSIS_BARS);
+    builds++;
+  } while ((elapsed = now_seconds() - start) < BENCH_MIN_SECONDS);
+  double build_us = elapsed / builds * 1e6;
+
+  /* Weighted levels never exceed the peak of the bins they cover */
+  bool ok = true;
+  float peak = dsp_max_abs((const float *)spectrum, ANALYSIS_N + 2);
+  band_map_levels(&map, spectrum, levels);
+  for (size_t i = 0; i < ANALYSIS_BARS; i++) {
+    if (!(levels[i] >= 0.0f && levels[i] <= peak))
+      ok = false;
+  }
+
+  double us[2];
+  for (size_t variant = 0; variant < 2; variant++) {
+    size_t iters = 0;
+    volatile float sink = 0.0f;
+    start = now_seconds();
+    do {
+      if (variant == 0)
+        band_levels_per_frame(spectrum, ANALYSIS_N, ANALYSIS_RATE,
+                              ANALYSIS_BARS, levels);
+      else
+        band_map_levels(&map, spectrum, levels);
+      sink += levels[iters % ANALYSIS_BARS];
+      iters++;
+    } while ((elapsed = now_seconds() - start) < BENCH_MIN_SECONDS);
+    (void)sink;
+    us[variant] = elapsed / iters * 1e6;
+  }
+
+  printf("\nBand mapping, %d bars at N=%d, %d Hz\n", ANALYSIS_BARS,
+         ANALYSIS_N, ANALYSIS_RATE);
+  printf("%14s %12s %12s %9s\n", "per-frame(us)", "table(us)", "build(us)",
+         "speedup");
+  printf("%14.2f %12.2f %12.2f %8.1fx\n", us[0], us[1], build_us,
+         us[0] / us[1]);
+  return ok;
+}
+
+int main() {
+  print_small_spectrum();
+
+  float *in = malloc(BENCH_MAX_N * sizeof(*in));
+  float complex *ref = malloc(BENCH_MAX_N * sizeof(*ref));
+  float complex *out = malloc(BENCH_MAX_N * sizeof(*out));
+  assert(in && ref && out);
+
+  srand(69);
+  for (size_t i = 0; i < BENCH_MAX_N; i++) {
+    in[i] = (float)rand() / RAND_MAX * 2.0f - 1.0f;
+  }
+
+  int failed = 0;
+  printf("%8s %14s %14s %10s %9s %10s\n", "N", "recursive(us)",
+         "iterative(us)", "r2c(us)", "speedup", "rel.err");
+
+  for (size_t n = BENCH_MIN_N; n <= BENCH_MAX_N; n <<= 1) {
+    const Fft_Plan *plan = fft_plan_get(n);
+    assert(plan);
+
+    fft(in, 1, ref, n);
+    fft_real(plan, in, out);
+    float err = max_rel_error(ref, out, n);
+    fft_r2c(plan, in, out);
+    float r2c_err = max_rel_error(ref, out, n / 2 + 1);
+    if (r2c_err > err)
+      err = r2c_err;
+    if (err > 1e-3f)
+      failed = 1;
+
+    size_t iters = 0;
+    double start = now_seconds(), elapsed;
+    do {
+      fft(in, 1, ref, n);
+      iters++;
+    } while ((elapsed = now_seconds() - start) < BENCH_MIN_SECONDS);
+    double recursive_us = elapsed / iters * 1e6;
+
+    iters = 0;
+    start = now_seconds();
+    do {
+      fft_real(plan, in, out);
+      iters++;
+    } while ((elapsed = now_seconds() - start) < BENCH_MIN_SECONDS);
+    double iterative_us = elapsed / iters * 1e6;
+
+    iters = 0;
+    start = now_seconds();
+    do {
+      fft_r2c(plan, in, out);
+      iters++;
+    } while ((elapsed = now_seconds() - start) < BENCH_MIN_SECONDS);
+    double r2c_us = elapsed / iters * 1e6;
+
+    printf("%8zu %14.1f %14.1f %10.1f %8.1fx %10.2e\n", n, recursive_us,
+           iterative_us, r2c_us, recursive_us / r2c_us, err);
+  }
+
+  if (!bench_backends(in))
+    failed = 1;
+  if (!bench_band_mapping(in))
+    failed = 1;
+
+  fft_plan_cache_clear();
+  free(in);
+  free(ref);
+  free(out);
+
+  if (failed) {
+    fprintf(stderr, "ERROR: iterative FFT does not match the reference\n");
+    return 1;
+  }
   return 0;
 }
@@ -0,0 +1,290 @@
+/**
+ * @file fft_engine.c
+ * @brief Iterative radix-4/radix-2 decimation-in-time FFT
+ *
+ * The input is loaded in bit-reversed order, the first two stages are fused
+ * into a multiplication-free radix-4 pass, and the remaining stages are
+ * radix-2 butterflies (vectorized in dsp.c) reading their twiddles from one
+ * contiguous run of the plan's table. Real input goes through fft_r2c,
+ * which does half the work by transforming n/2 packed complex points.
+ */
+#include "fft_engine.h"
+#include "dsp.h"
+
+#include <math.h>
+#include <pthread.h>
+#include <stdlib.h>
+#include <strings.h>
+
+#define FFT_MAX_LOG2 24 ///< Largest cached plan is 2^24 points
+
+static pthread_mutex_t plans_lock = PTHREAD_MUTEX_INITIALIZER;
+static Fft_Plan *plans[FFT_MAX_LOG2 + 1];
+static float *windows[COUNT_FFT_WINDOWS][FFT_MAX_LOG2 + 1];
+
+static const char *window_names[COUNT_FFT_WINDOWS] = {
+    [FFT_WINDOW_HANN] = "Hann",
+    [FFT_WINDOW_HAMMING] = "Hamming",
+    [FFT_WINDOW_BLACKMAN_HARRIS] = "Blackman-Harris",
+    [FFT_WINDOW_RECTANGULAR] = "Rectangular",
+};
+
+/**
+ * @brief Complex multiply without the C99 Annex G NaN/Inf recovery path
+ */
+static inline float complex cmul(float complex a, float complex b) {
+  float ar = crealf(a), ai = cimagf(a);
+  float br = crealf(b), bi = cimagf(b);
+  return CMPLXF(ar * br - ai * bi, ar * bi + ai * br);
+}
+
+static Fft_Plan *plan_create(unsigned log2n) {
+  size_t n = (size_t)1 << log2n;
+
+  Fft_Plan *plan = calloc(1, sizeof(*plan));
+  if (!plan)
+    return NULL;
+
+  plan->n = n;
+  plan->log2n = log2n;
+  plan->bitrev = malloc(n * sizeof(*plan->bitrev));
+  plan->twiddles = malloc(n * sizeof(*plan->twiddles));
+  if (!plan->bitrev || !plan->twiddles) {
+    free(plan->bitrev);
+    free(plan->twiddles);
+    free(plan);
+    return NULL;
+  }
+
+  for (size_t i = 0; i < n; i++) {
+    uint32_t r = 0;
+    for (unsigned b = 0; b < log2n; b++) {
+      if (i & ((size_t)1 << b))
+        r |= 1u << (log2n - 1 - b);
+    }
+    plan->bitrev[i] = r;
+  }
+
+  /* Computed in double so the largest tables stay accurate to float ulp */
+  plan->twiddles[0] = 0;
+  for (size_t h = 1; h < n; h <<= 1) {
+    for (size_t k = 0; k < h; k++) {
+      double angle = -M_PI * (double)k / (double)h;
+      plan->twiddles[h + k] = CMPLXF((float)cos(angle), (float)sin(angle));
+    }
+  }
+
+  return plan;
+}
+
+static void plan_destroy(Fft_Plan *plan) {
+  if (!plan)
+    return;
+  free(plan->bitrev);
+  free(plan->twiddles);
+  free(plan);
+}
+
+/**
+ * @brief Looks up or builds the plan for 2^log2n (and its half-size chain)
+ *
+ * Must be called with plans_lock held.
+ */
+static Fft_Plan *plan_get_locked(unsigned log2n) {
+  if (!plans[log2n]) {
+    Fft_Plan *half = NULL;
+    if (log2n > 0) {
+      half = plan_get_locked(log2n - 1);
+      if (!half)
+        return NULL;
+    }
+    plans[log2n] = plan_create(log2n);
+    if (plans[log2n])
+      plans[log2n]->half = half;
+  }
+  return plans[log2n];
+}
+
+/**
+ * @brief log2(n) for a supported power-of-two size, -1 otherwise
+ */
+static int size_log2(size_t n) {
+  if (n == 0 || (n & (n - 1)) != 0)
+    return -1;
+
+  int log2n = 0;
+  while (((size_t)1 << log2n) < n)
+    log2n++;
+  return log2n > FFT_MAX_LOG2 ? -1 : log2n;
+}
+
+const Fft_Plan *fft_plan_get(size_t n) {
+  int log2n = size_log2(n);
+  if (log2n < 0)
+    return NULL;
+
+  pthread_mutex_lock(&plans_lock);
+  Fft_Plan *plan = plan_get_locked(log2n);
+  pthread_mutex_unlock(&plans_lock);
+
+  return plan;
+}
+
+static float *window_create(Fft_Window type, size_t n) {
+  float *w = malloc(n * sizeof(*w));
+  if (!w)
+    return NULL;
+
+  /* Symmetric windows; a single point is left untapered */
+  double d = n > 1 ? (double)(n - 1) : 1.0;
+  for (size_t i = 0; i < n; i++) {
+    double x = 2.0 * M_PI * (double)i / d;
+    switch (type) {
+    case FFT_WINDOW_HANN:
+      w[i] = (float)(0.5 - 0.5 * cos(x));
+      break;
+    case FFT_WINDOW_HAMMING:
+      w[i] = (float)(0.54 - 0.46 * cos(x));
+      break;
+    case FFT_WINDOW_BLACKMAN_HARRIS:
+      w[i] = (float)(0.35875 - 0.48829 * cos(x) + 0.14128 * cos(2 * x) -
+                     0.01168 * cos(3 * x));
+      break;
+    case FFT_WINDOW_RECTANGULAR:
+    default:
+      w[i] = 1.0f;
+      break;
+    }
+  }
+  return w;
+}
+
+const float *fft_window_get(Fft_Window type, size_t n) {
+  int log2n = size_log2(n);
+  if (log2n < 0 || type < 0 || type >= COUNT_FFT_WINDOWS)
+    return NULL;
+
+  pthread_mutex_lock(&plans_lock);
+  if (!windows[type][log2n])
+    windows[type][log2n] = window_create(type, n);
+  float *w = windows[type][log2n];
+  pthread_mutex_unlock(&plans_lock);
+
+  return w;
+}
+
+const char *fft_window_name(Fft_Window type) {
+  if (type < 0 || type >= COUNT_FFT_WINDOWS)
+    return "Unknown";
+  return window_names[type];
+}
+
+bool fft_window_parse(const char *name, Fft_Window *type) {
+  for (Fft_Window t = 0; t < COUNT_FFT_WINDOWS; t++) {
+    if (strcasecmp(name, window_names[t]) == 0) {
+      *type = t;
+      return true;
+    }
+  }
+  return false;
+}
+
+void fft_plan_cache_clear(void) {
+  pthread_mutex_lock(&plans_lock);
+  for (size_t i = 0; i <= FFT_MAX_LOG2; i++) {
+    plan_destroy(plans[i]);
+    plans[i] = NULL;
+    for (size_t t = 0; t < COUNT_FFT_WINDOWS; t++) {
+      free(windows[t][i]);
+      windows[t][i] = NULL;
+    }
+  }
+  pthread_mutex_unlock(&plans_lock);
+}
+
+/**
+ * @brief Runs every butterfly stage over data already in bit-reversed order
+ */
+static void fft_stages(const Fft_Plan *plan, float complex x[]) {
+  size_t n = plan->n;
+  size_t h = 1;
+
+  /* Fused first two stages: twiddles are 1 and -i, so no multiplies */
+  if (n >= 4) {
+    for (size_t j = 0; j < n; j += 4) {
+      float complex a = x[j] + x[j + 1];
+      float complex b = x[j] - x[j + 1];
+      float complex c = x[j + 2] + x[j + 3];
+      float complex d = x[j + 2] - x[j + 3];
+      float complex d_rot = CMPLXF(cimagf(d), -crealf(d)); // -i * d
+
+      x[j] = a + c;
+      x[j + 1] = b + d_rot;
+      x[j + 2] = a - c;
+      x[j + 3] = b - d_rot;
+    }
+    h = 4;
+  }
+
+  for (; h < n; h <<= 1) {
+    const float complex *w = plan->twiddles + h;
+    for (size_t j = 0; j < n; j += 2 * h) {
+      dsp_butterflies(x + j, x + j + h, w, h);
+    }
+  }
+}
+
+void fft_complex(const Fft_Plan *plan, float complex data[]) {
+  for (size_t i = 0; i < plan->n; i++) {
+    size_t r = plan->bitrev[i];
+    if (r > i) {
+      float complex tmp = data[i];
+      data[i] = data[r];
+      data[r] = tmp;
+    }
+  }
+  fft_stages(plan, data);
+}
+
+void fft_real(const Fft_Plan *plan, const float in[], float complex out[]) {
+  for (size_t i = 0; i < plan->n; i++) {
+    out[i] = in[plan->bitrev[i]];
+  }
+  fft_stages(plan, out);
+}
+
+void fft_r2c(const Fft_Plan *plan, const float in[], float complex out[]) {
+  const Fft_Plan *half = plan->half;
+  size_t m = half->n;
+
+  /* z[j] = x[2j] + i*x[2j+1], loaded in bit-reversed order */
+  for (size_t j = 0; j < m; j++) {
+    size_t r = half->bitrev[j];
+    out[j] = CMPLXF(in[2 * r], in[2 * r + 1]);
+  }
+  fft_stages(half, out);
+
+  /*
+   * Split Z into the spectra of the even and odd samples and recombine:
+   *   E[k] = (Z[k] + conj(Z[m-k])) / 2
+   *   O[k] = (Z[k] - conj(Z[m-k])) / 2i
+   *   X[k] = E[k] + W^k O[k],  X[m-k] = conj(E[k] - W^k O[k])
+   * with W = e^(-2*pi*i/n), which is the plan's top-stage twiddle run.
+   */
+  float complex z0 = out[0];
+  out[0] = crealf(z0) + cimagf(z0);
+  out[m] = crealf(z0) - cimagf(z0);
+
+  const float complex *w = plan->twiddles + m;
+  for (size_t k = 1; k <= m / 2; k++) {
+    float complex a = out[k];
+    float complex b = conjf(out[m - k]);
+    float complex e = 0.5f * (a + b);
+    float complex d = 0.5f * (a - b);
+    float complex o = CMPLXF(cimagf(d), -crealf(d)); // d / i
+    float complex t = cmul(w[k], o);
+
+    out[k] = e + t;
+    out[m - k] = conjf(e - t);
+  }
+}
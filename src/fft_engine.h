@@ -0,0 +1,110 @@
+/**
+ * @file fft_engine.h
+ * @brief Iterative in-place FFT with cached bit-reversal and twiddle tables
+ *
+ * Plans are built once per transform size and shared by every caller, so the
+ * per-frame cost is only the butterflies themselves (no recursion, no
+ * transcendental calls). Analysis windows are cached the same way.
+ */
+#ifndef FFT_ENGINE_H_
+#define FFT_ENGINE_H_
+
+#include <complex.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/**
+ * @struct Fft_Plan
+ * @brief Precomputed tables for a power-of-two transform size
+ */
+typedef struct Fft_Plan {
+  size_t n;        ///< Transform size (power of two)
+  unsigned log2n;  ///< log2(n)
+  uint32_t *bitrev; ///< Bit-reversal permutation of [0, n)
+  /// Per-stage twiddles laid out contiguously: for a stage combining blocks
+  /// of half-size h, twiddles[h + k] = e^(-i*pi*k/h) for k in [0, h).
+  float complex *twiddles;
+  const struct Fft_Plan *half; ///< Plan for n/2, used by fft_r2c (NULL if n<2)
+} Fft_Plan;
+
+/**
+ * @enum Fft_Window
+ * @brief Analysis window shapes available through fft_window_get()
+ */
+typedef enum {
+  FFT_WINDOW_HANN,            ///< Good general-purpose leakage/resolution
+  FFT_WINDOW_HAMMING,         ///< Narrower main lobe, higher far sidelobes
+  FFT_WINDOW_BLACKMAN_HARRIS, ///< 4-term, very low leakage, wide main lobe
+  FFT_WINDOW_RECTANGULAR,     ///< No tapering, sharpest peaks, most leakage
+  COUNT_FFT_WINDOWS,
+} Fft_Window;
+
+/**
+ * @brief Returns the cached plan for size n, building it on first use
+ *
+ * Thread-safe. The returned plan stays valid until fft_plan_cache_clear().
+ *
+ * @param n Transform size (power of two, at least 1)
+ * @return Plan for n, or NULL if n is not a power of two or allocation failed
+ */
+const Fft_Plan *fft_plan_get(size_t n);
+
+/**
+ * @brief Returns the cached n-point window of the given shape
+ *
+ * Thread-safe. The table stays valid until fft_plan_cache_clear().
+ *
+ * @return Window coefficients, or NULL if n is not a power of two, type is
+ *         unknown or allocation failed
+ */
+const float *fft_window_get(Fft_Window type, size_t n);
+
+/**
+ * @brief Human-readable window name
+ */
+const char *fft_window_name(Fft_Window type);
+
+/**
+ * @brief Parses a window name as returned by fft_window_name()
+ *
+ * Matching is case-insensitive.
+ *
+ * @return false if the name is unknown
+ */
+bool fft_window_parse(const char *name, Fft_Window *type);
+
+/**
+ * @brief Frees every cached plan and window
+ *
+ * Only call this when no other thread is using a plan (e.g. before hot
+ * reload).
+ */
+void fft_plan_cache_clear(void);
+
+/**
+ * @brief In-place forward complex FFT of plan->n points in natural order
+ */
+void fft_complex(const Fft_Plan *plan, float complex data[]);
+
+/**
+ * @brief Forward FFT of plan->n real samples into plan->n complex bins
+ *
+ * The bit-reversal permutation is applied while loading the input, so no
+ * separate reordering pass is needed.
+ */
+void fft_real(const Fft_Plan *plan, const float in[], float complex out[]);
+
+/**
+ * @brief Real-to-complex FFT of plan->n samples into plan->n/2 + 1 bins
+ *
+ * Packs the n reals as n/2 complex values (even samples real, odd samples
+ * imaginary), runs an n/2-point complex FFT and splits the result using the
+ * Hermitian symmetry of a real signal. The omitted bins (n/2, n) are the
+ * complex conjugates of the ones written. Requires plan->n >= 2.
+ *
+ * @param out Output array with room for plan->n/2 + 1 bins
+ */
+void fft_r2c(const Fft_Plan *plan, const float in[], float complex out[]);
+
+#endif // FFT_ENGINE_H_
@@ -0,0 +1,113 @@
+/**
+ * @file file_dialog.c
+ * @brief Helper thread around tinyfd_openFileDialog() and
+ * tinyfd_saveFileDialog()
+ */
+#include "file_dialog.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "tinyfiledialogs.h"
+
+static const char *const audio_filters[] = {
+    "*.wav", "*.ogg", "*.mp3", "*.flac", "*.m3u", "*.m3u8", "*.pls"};
+static const char *const playlist_filters[] = {"*.m3u8", "*.m3u", "*.pls"};
+
+static void *dialog_thread(void *arg) {
+  File_Dialog *d = arg;
+
+  const char *paths =
+      d->save ? tinyfd_saveFileDialog(
+                    d->title, d->default_dir,
+                    sizeof(playlist_filters) / sizeof(*playlist_filters),
+                    playlist_filters, "Playlists")
+              : tinyfd_openFileDialog(
+                    d->title, d->default_dir,
+                    sizeof(audio_filters) / sizeof(*audio_filters),
+                    audio_filters, "Music Files", 1);
+  /* tinyfd's buffer is static: copy it before the next dialog reuses it */
+  d->result = paths ? strdup(paths) : NULL;
+
+  atomic_store_explicit(&d->state, FILE_DIALOG_DONE, memory_order_release);
+  return NULL;
+}
+
+static void free_request(File_Dialog *d) {
+  free(d->title);
+  free(d->default_dir);
+  d->title = d->default_dir = NULL;
+}
+
+/**
+ * @brief Joins the finished helper and releases the request copies
+ */
+static void finish(File_Dialog *d) {
+  pthread_join(d->thread, NULL);
+  free_request(d);
+}
+
+/**
+ * @brief Starts the helper thread for either kind of dialog
+ */
+static bool start(File_Dialog *d, const char *title, const char *default_dir,
+                  bool save) {
+  if (atomic_load_explicit(&d->state, memory_order_acquire) !=
+      FILE_DIALOG_IDLE)
+    return false;
+
+  d->title = strdup(title);
+  d->default_dir = strdup(default_dir);
+  d->save = save;
+  d->result = NULL;
+  if (!d->title || !d->default_dir) {
+    free_request(d);
+    return false;
+  }
+
+  atomic_store_explicit(&d->state, FILE_DIALOG_OPEN, memory_order_relaxed);
+  if (pthread_create(&d->thread, NULL, dialog_thread, d) != 0) {
+    atomic_store_explicit(&d->state, FILE_DIALOG_IDLE, memory_order_relaxed);
+    free_request(d);
+    return false;
+  }
+  return true;
+}
+
+bool file_dialog_open(File_Dialog *d, const char *title,
+                      const char *default_dir) {
+  return start(d, title, default_dir, false);
+}
+
+bool file_dialog_save(File_Dialog *d, const char *title,
+                      const char *default_path) {
+  return start(d, title, default_path, true);
+}
+
+bool file_dialog_busy(File_Dialog *d) {
+  return atomic_load_explicit(&d->state, memory_order_relaxed) !=
+         FILE_DIALOG_IDLE;
+}
+
+bool file_dialog_poll(File_Dialog *d, char **result) {
+  if (atomic_load_explicit(&d->state, memory_order_acquire) !=
+      FILE_DIALOG_DONE)
+    return false;
+
+  finish(d);
+  *result = d->result;
+  d->result = NULL;
+  atomic_store_explicit(&d->state, FILE_DIALOG_IDLE, memory_order_relaxed);
+  return true;
+}
+
+void file_dialog_wait(File_Dialog *d) {
+  if (atomic_load_explicit(&d->state, memory_order_acquire) ==
+      FILE_DIALOG_IDLE)
+    return;
+
+  finish(d);
+  free(d->result);
+  d->result = NULL;
+  atomic_store_explicit(&d->state, FILE_DIALOG_IDLE, memory_order_relaxed);
+}
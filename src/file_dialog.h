@@ -0,0 +1,89 @@
+/**
+ * @file file_dialog.h
+ * @brief Native open/save file dialogs run on a helper thread
+ *
+ * tinyfd_openFileDialog() spawns zenity/kdialog and blocks until the user
+ * closes the dialog. Called from the render loop it would freeze the
+ * visuals for as long as the dialog is open, so the dialog runs on its own
+ * thread and its result is picked up by polling once per frame.
+ *
+ * Only one dialog is open at a time (tinyfd returns a static buffer), so
+ * the completion queue is a single slot: the helper fills it and flips the
+ * state to done, the render thread takes the result and flips it back to
+ * idle.
+ */
+#ifndef FILE_DIALOG_H_
+#define FILE_DIALOG_H_
+
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdbool.h>
+
+#define FILE_DIALOG_SEPARATOR '|' ///< Between paths of a multiple selection
+
+/**
+ * @enum File_Dialog_State
+ * @brief Who owns the dialog slot
+ */
+typedef enum {
+  FILE_DIALOG_IDLE, ///< No dialog; the render thread may open one
+  FILE_DIALOG_OPEN, ///< Helper thread is waiting for the user
+  FILE_DIALOG_DONE, ///< result is ready for the render thread
+} File_Dialog_State;
+
+/**
+ * @struct File_Dialog
+ * @brief One open-file dialog slot
+ */
+typedef struct {
+  char *title;       ///< Owned copy passed to the dialog
+  char *default_dir; ///< Owned copy passed to the dialog
+  bool save;         ///< Save dialog, kept until the next one is opened
+  char *result;      ///< Selected paths joined by FILE_DIALOG_SEPARATOR
+                     ///< (the file to save to), NULL if cancelled
+  atomic_int state;  ///< File_Dialog_State
+  pthread_t thread;
+} File_Dialog;
+
+/**
+ * @brief Opens a multi-select dialog for audio and playlist files without
+ * blocking
+ *
+ * @return false if a dialog is already open or the thread failed to start
+ */
+bool file_dialog_open(File_Dialog *d, const char *title,
+                      const char *default_dir);
+
+/**
+ * @brief Opens a dialog asking for a playlist file to save to, without
+ * blocking
+ *
+ * @param default_path File name (and folder) offered
+ * @return false if a dialog is already open or the thread failed to start
+ */
+bool file_dialog_save(File_Dialog *d, const char *title,
+                      const char *default_path);
+
+/**
+ * @brief True while the dialog is open or its result is not taken yet
+ */
+bool file_dialog_busy(File_Dialog *d);
+
+/**
+ * @brief Takes the result of a closed dialog (render thread)
+ *
+ * @param result Output: heap string of paths joined by
+ *        FILE_DIALOG_SEPARATOR, or NULL if the user cancelled; the caller
+ *        frees it
+ * @return false while the dialog is still open (or none was opened)
+ */
+bool file_dialog_poll(File_Dialog *d, char **result);
+
+/**
+ * @brief Blocks until an open dialog is closed, then drops its result
+ *
+ * Needed before the code running the helper thread is unloaded.
+ */
+void file_dialog_wait(File_Dialog *d);
+
+#endif // FILE_DIALOG_H_
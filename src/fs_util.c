@@ -0,0 +1,81 @@
+/**
+ * @file fs_util.c
+ * @brief Parent directories and temporary-file-and-rename writes
+ */
+#include "fs_util.h"
+
+#include <errno.h>
+#include <limits.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+void fs_make_parents(const char *path) {
+  char dir[PATH_MAX];
+  if (snprintf(dir, sizeof(dir), "%s", path) >= (int)sizeof(dir))
+    return;
+  for (char *slash = strchr(dir + 1, '/'); slash;
+       slash = strchr(slash + 1, '/')) {
+    *slash = '\0';
+    if (mkdir(dir, 0755) != 0 && errno != EEXIST)
+      return;
+    *slash = '/';
+  }
+}
+
+bool fs_write_atomic(const char *file, Fs_Writer *write, void *user,
+                     bool sync) {
+  char tmp_path[PATH_MAX];
+  if (snprintf(tmp_path, sizeof(tmp_path), "%s.XXXXXX", file) >=
+      (int)sizeof(tmp_path))
+    return false;
+  int fd = mkstemp(tmp_path);
+  if (fd < 0 && errno == ENOENT) {
+    fs_make_parents(file);
+    /* mkstemp() filled in the Xs even though it failed */
+    memcpy(tmp_path + strlen(tmp_path) - 6, "XXXXXX", 6);
+    fd = mkstemp(tmp_path);
+  }
+  if (fd < 0)
+    return false;
+  /* mkstemp() makes the file private; keep the mode of the one replaced */
+  struct stat st;
+  (void)fchmod(fd, stat(file, &st) == 0 ? st.st_mode & 07777 : 0644);
+  FILE *f = fdopen(fd, "wb");
+  if (!f) {
+    close(fd);
+    unlink(tmp_path);
+    return false;
+  }
+  setvbuf(f, NULL, _IOFBF, 1 << 16);
+
+  bool ok = write(f, user) && fflush(f) == 0 &&
+            (!sync || fsync(fileno(f)) == 0);
+  ok = fclose(f) == 0 && ok;
+  if (ok)
+    ok = rename(tmp_path, file) == 0;
+  if (!ok)
+    unlink(tmp_path);
+  return ok;
+}
+
+/**
+ * @struct Buffer
+ * @brief What put_buffer() writes
+ */
+typedef struct {
+  const void *data;
+  size_t size;
+} Buffer;
+
+static bool put_buffer(FILE *f, void *user) {
+  const Buffer *buffer = user;
+  return fwrite(buffer->data, 1, buffer->size, f) == buffer->size;
+}
+
+bool fs_write_buffer(const char *file, const void *data, size_t size,
+                     bool sync) {
+  Buffer buffer = {data, size};
+  return fs_write_atomic(file, put_buffer, &buffer, sync);
+}
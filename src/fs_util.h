@@ -0,0 +1,49 @@
+/**
+ * @file fs_util.h
+ * @brief Creating parent directories and replacing files atomically
+ *
+ * Files the player keeps on disk are replaced through fs_write_atomic():
+ * the contents are written to a fresh temporary file next to the target,
+ * which is then renamed over it, so a reader or a crash sees either the
+ * old file or the new one, never half of one.
+ */
+#ifndef FS_UTIL_H_
+#define FS_UTIL_H_
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdio.h>
+
+/**
+ * @brief Writes the contents of a file
+ *
+ * @return false on a write error
+ */
+typedef bool Fs_Writer(FILE *f, void *user);
+
+/**
+ * @brief Creates the missing parent directories of path
+ */
+void fs_make_parents(const char *path);
+
+/**
+ * @brief Replaces file with what write puts out
+ *
+ * The parent directories are created if missing. A file replaced keeps
+ * its permission bits; a new one gets 0644.
+ *
+ * @param sync Flush the data to disk before the rename, so that a crash
+ *        cannot leave the new name on an empty file; caches that only save
+ *        work skip it
+ * @return false if any step failed; file is then left as it was
+ */
+bool fs_write_atomic(const char *file, Fs_Writer *write, void *user,
+                     bool sync);
+
+/**
+ * @brief fs_write_atomic() of size bytes at data
+ */
+bool fs_write_buffer(const char *file, const void *data, size_t size,
+                     bool sync);
+
+#endif // FS_UTIL_H_
@@ -0,0 +1,298 @@
+/**
+ * @file importer.c
+ * @brief Worker pool that expands dropped folders and probes audio files
+ */
+#include "importer.h"
+
+#include <dirent.h>
+#include <raylib.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#define IMPORTER_MAX_DEPTH 32 ///< Deepest folder nesting expanded
+
+/// Extensions picked up inside folders (dropped files are always probed)
+static const char *const audio_extensions[] = {".wav", ".ogg", ".mp3",
+                                               ".flac", ".qoa"};
+
+bool import_probe(const char *path, Track_Info *info) {
+  Music music = LoadMusicStream(path);
+  if (!IsMusicValid(music))
+    return false;
+
+  info->length = GetMusicTimeLength(music);
+  info->sample_rate = music.stream.sampleRate;
+  info->channels = music.stream.channels;
+  UnloadMusicStream(music);
+  return true;
+}
+
+static bool is_audio_file(const char *name) {
+  const char *dot = strrchr(name, '.');
+  if (!dot)
+    return false;
+  for (size_t i = 0; i < sizeof(audio_extensions) / sizeof(*audio_extensions);
+       i++)
+    if (strcasecmp(dot, audio_extensions[i]) == 0)
+      return true;
+  return false;
+}
+
+static Import_Slot *slot_at(Importer *imp, size_t index) {
+  return &imp->blocks[index / IMPORTER_BLOCK_SIZE][index % IMPORTER_BLOCK_SIZE];
+}
+
+/**
+ * @brief Lists one more file for probing
+ */
+static void add_slot(Importer *imp, const char *path) {
+  char *copy = strdup(path);
+  if (!copy)
+    return;
+
+  pthread_mutex_lock(&imp->lock);
+  size_t block = imp->total / IMPORTER_BLOCK_SIZE;
+  if (block < IMPORTER_MAX_BLOCKS && !imp->blocks[block])
+    imp->blocks[block] = malloc(IMPORTER_BLOCK_SIZE * sizeof(Import_Slot));
+  if (block >= IMPORTER_MAX_BLOCKS || !imp->blocks[block]) {
+    imp->dropped++;
+    pthread_mutex_unlock(&imp->lock);
+    free(copy);
+    return;
+  }
+
+  Import_Slot *slot = slot_at(imp, imp->total);
+  slot->path = copy;
+  atomic_store_explicit(&slot->state, IMPORT_PENDING, memory_order_relaxed);
+  imp->total++;
+  pthread_cond_signal(&imp->wake);
+  pthread_mutex_unlock(&imp->lock);
+}
+
+static int compare_names(const void *a, const void *b) {
+  return strcmp(*(char *const *)a, *(char *const *)b);
+}
+
+/**
+ * @brief Lists the audio files below a directory, sorted by name
+ *
+ * Hidden entries are skipped like in the internal browser, and symbolic
+ * links are followed to files only, so link cycles cannot recurse forever.
+ */
+static void expand_dir(Importer *imp, const char *path, unsigned depth) {
+  if (depth > IMPORTER_MAX_DEPTH)
+    return;
+  DIR *dir = opendir(path);
+  if (!dir)
+    return;
+
+  char **names = NULL;
+  size_t count = 0, capacity = 0;
+  struct dirent *entry;
+  while ((entry = readdir(dir))) {
+    if (entry->d_name[0] == '.')
+      continue;
+    if (count == capacity) {
+      size_t grown = capacity ? capacity * 2 : 64;
+      char **items = realloc(names, grown * sizeof(*names));
+      if (!items)
+        break;
+      names = items;
+      capacity = grown;
+    }
+    if ((names[count] = strdup(entry->d_name)))
+      count++;
+  }
+  closedir(dir);
+  qsort(names, count, sizeof(*names), compare_names);
+
+  for (size_t i = 0; i < count; i++) {
+    char child[4096];
+    if (snprintf(child, sizeof(child), "%s/%s", path, names[i]) <
+        (int)sizeof(child)) {
+      struct stat st;
+      if (lstat(child, &st) == 0) {
+        bool link = S_ISLNK(st.st_mode);
+        if (link && stat(child, &st) != 0)
+          st.st_mode = 0;
+        if (S_ISDIR(st.st_mode) && !link)
+          expand_dir(imp, child, depth + 1);
+        else if (S_ISREG(st.st_mode) && is_audio_file(names[i]))
+          add_slot(imp, child);
+      }
+    }
+    free(names[i]);
+  }
+  free(names);
+}
+
+/**
+ * @brief Turns one submitted path into slots
+ */
+static void expand_root(Importer *imp, const char *path) {
+  struct stat st;
+  if (stat(path, &st) == 0 && S_ISDIR(st.st_mode))
+    expand_dir(imp, path, 0);
+  else
+    add_slot(imp, path);
+}
+
+static void *importer_thread(void *arg) {
+  Importer *imp = arg;
+
+  pthread_mutex_lock(&imp->lock);
+  while (imp->running) {
+    if (imp->next_probe < imp->total) {
+      Import_Slot *slot = slot_at(imp, imp->next_probe++);
+      pthread_mutex_unlock(&imp->lock);
+
+      Import_State state =
+          import_probe(slot->path, &slot->info) ? IMPORT_OK : IMPORT_FAILED;
+      atomic_store_explicit(&slot->state, state, memory_order_release);
+
+      pthread_mutex_lock(&imp->lock);
+    } else if (imp->root_count > 0 && !imp->scanning) {
+      /* One scanner at a time keeps the roots in submission order */
+      char *root = imp->roots[0];
+      imp->root_count--;
+      memmove(&imp->roots[0], &imp->roots[1],
+              imp->root_count * sizeof(*imp->roots));
+      imp->scanning = true;
+      pthread_mutex_unlock(&imp->lock);
+
+      expand_root(imp, root);
+      free(root);
+
+      pthread_mutex_lock(&imp->lock);
+      imp->scanning = false;
+    } else {
+      pthread_cond_wait(&imp->wake, &imp->lock);
+    }
+  }
+  pthread_mutex_unlock(&imp->lock);
+  return NULL;
+}
+
+bool importer_start(Importer *imp) {
+  if (!imp->initialized) {
+    if (pthread_mutex_init(&imp->lock, NULL) != 0)
+      return false;
+    if (pthread_cond_init(&imp->wake, NULL) != 0) {
+      pthread_mutex_destroy(&imp->lock);
+      return false;
+    }
+    imp->initialized = true;
+  }
+
+  long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+  unsigned wanted = cpus < 1                      ? 1
+                    : cpus > IMPORTER_MAX_WORKERS ? IMPORTER_MAX_WORKERS
+                                                  : (unsigned)cpus;
+
+  imp->running = true;
+  imp->thread_count = 0;
+  while (imp->thread_count < wanted &&
+         pthread_create(&imp->threads[imp->thread_count], NULL,
+                        importer_thread, imp) == 0)
+    imp->thread_count++;
+
+  if (imp->thread_count == 0) {
+    imp->running = false;
+    return false;
+  }
+  return true;
+}
+
+void importer_stop(Importer *imp) {
+  if (!imp->initialized)
+    return;
+  pthread_mutex_lock(&imp->lock);
+  imp->running = false;
+  pthread_cond_broadcast(&imp->wake);
+  pthread_mutex_unlock(&imp->lock);
+
+  for (unsigned i = 0; i < imp->thread_count; i++)
+    pthread_join(imp->threads[i], NULL);
+  imp->thread_count = 0;
+}
+
+size_t importer_submit(Importer *imp, char *const paths[], size_t count) {
+  if (!imp->initialized)
+    return 0;
+
+  size_t accepted = 0;
+  pthread_mutex_lock(&imp->lock);
+  for (; accepted < count && imp->root_count < IMPORTER_MAX_ROOTS;
+       accepted++) {
+    char *copy = strdup(paths[accepted]);
+    if (!copy)
+      break;
+    imp->roots[imp->root_count++] = copy;
+  }
+  pthread_cond_broadcast(&imp->wake);
+  pthread_mutex_unlock(&imp->lock);
+  return accepted;
+}
+
+/**
+ * @brief True when every listed slot is collected and nothing is left to
+ * list (lock held)
+ */
+static bool idle(const Importer *imp) {
+  return imp->root_count == 0 && !imp->scanning &&
+         imp->collected == imp->total;
+}
+
+void importer_collect(Importer *imp, Import_Sink *sink, void *user) {
+  if (!imp->initialized)
+    return;
+
+  pthread_mutex_lock(&imp->lock);
+  size_t total = imp->total;
+  pthread_mutex_unlock(&imp->lock);
+
+  size_t end = imp->collected + IMPORTER_COLLECT_BATCH;
+  while (imp->collected < total && imp->collected < end) {
+    Import_Slot *slot = slot_at(imp, imp->collected);
+    int state = atomic_load_explicit(&slot->state, memory_order_acquire);
+    if (state == IMPORT_PENDING)
+      break;
+    if (state == IMPORT_OK)
+      sink(user, slot->path, &slot->info);
+    else
+      free(slot->path);
+    slot->path = NULL;
+    imp->collected++;
+  }
+
+  /* Import finished: release the slot blocks and start over at slot 0 */
+  pthread_mutex_lock(&imp->lock);
+  if (imp->total > 0 && idle(imp)) {
+    if (imp->dropped > 0)
+      fprintf(stderr, "WARNING: import skipped %zu files over the limit\n",
+              imp->dropped);
+    for (size_t i = 0; i < IMPORTER_MAX_BLOCKS && imp->blocks[i]; i++) {
+      free(imp->blocks[i]);
+      imp->blocks[i] = NULL;
+    }
+    imp->total = imp->next_probe = imp->collected = imp->dropped = 0;
+  }
+  pthread_mutex_unlock(&imp->lock);
+}
+
+bool importer_progress(Importer *imp, size_t *done, size_t *total) {
+  if (!imp->initialized) {
+    *done = *total = 0;
+    return false;
+  }
+  pthread_mutex_lock(&imp->lock);
+  *done = imp->collected;
+  *total = imp->total;
+  bool busy = !idle(imp);
+  pthread_mutex_unlock(&imp->lock);
+  return busy;
+}
@@ -0,0 +1,135 @@
+/**
+ * @file importer.h
+ * @brief Background import of dropped files and folders
+ *
+ * Probing a file means opening it with raylib, which for some formats scans
+ * the whole file to find its length. Doing that for every file of a dropped
+ * folder on the render thread freezes the window, so the importer runs it on
+ * a small pool of worker threads.
+ *
+ * Submitted paths become import slots in submission order. One worker at a
+ * time expands directories (recursively, entries sorted by name) into more
+ * slots while the others probe the slots already listed, so probing starts
+ * with the first file found. The render thread collects finished slots
+ * strictly in slot order, which keeps the playlist in the order the files
+ * were dropped even though probes finish out of order.
+ */
+#ifndef IMPORTER_H_
+#define IMPORTER_H_
+
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+#include "track_info.h"
+
+#define IMPORTER_MAX_WORKERS 8     ///< Upper bound on probing threads
+#define IMPORTER_BLOCK_SIZE 1024   ///< Slots per allocated block
+#define IMPORTER_MAX_BLOCKS 1024   ///< Blocks, i.e. up to ~1M files at once
+#define IMPORTER_MAX_ROOTS 256     ///< Submitted paths awaiting expansion
+#define IMPORTER_COLLECT_BATCH 256 ///< Most slots collected per call
+
+/**
+ * @enum Import_State
+ * @brief Progress of one import slot
+ */
+typedef enum {
+  IMPORT_PENDING, ///< Not probed yet
+  IMPORT_OK,      ///< Playable, info is valid
+  IMPORT_FAILED,  ///< Not decodable
+} Import_State;
+
+/**
+ * @struct Import_Slot
+ * @brief One file of an import
+ */
+typedef struct {
+  char *path;       ///< Owned by the slot until collected
+  Track_Info info;  ///< Valid once state is IMPORT_OK
+  atomic_int state; ///< Import_State, published by the probing worker
+} Import_Slot;
+
+/**
+ * @brief Receives a playable file during importer_collect()
+ *
+ * @param path Heap string whose ownership passes to the callee
+ */
+typedef void Import_Sink(void *user, char *path, const Track_Info *info);
+
+/**
+ * @struct Importer
+ * @brief Worker pool state, embedded in Plug so it survives hot reload
+ *
+ * Slots live in fixed-size blocks that are never moved, so workers can
+ * read them while the scanner appends more.
+ */
+typedef struct {
+  pthread_mutex_t lock;
+  pthread_cond_t wake; ///< Signalled on new roots, new slots and shutdown
+
+  /* Guarded by lock */
+  char *roots[IMPORTER_MAX_ROOTS]; ///< Submitted paths awaiting expansion
+  size_t root_count;               ///< Number of roots
+  bool scanning;                   ///< A worker is expanding a root
+  size_t next_probe;               ///< First slot not yet claimed
+  size_t total;                    ///< Slots listed so far
+  size_t dropped;                  ///< Files skipped because slots ran out
+  Import_Slot *blocks[IMPORTER_MAX_BLOCKS];
+
+  /* Written by the render thread only (read under lock by idle checks) */
+  size_t collected; ///< Slots handed to the sink so far
+
+  pthread_t threads[IMPORTER_MAX_WORKERS];
+  unsigned thread_count;
+  bool running;
+  bool initialized; ///< lock and wake exist
+} Importer;
+
+/**
+ * @brief Reads duration and format of an audio file without keeping it open
+ *
+ * @return false if raylib cannot decode the file
+ */
+bool import_probe(const char *path, Track_Info *info);
+
+/**
+ * @brief Starts the worker threads, resuming any unfinished import
+ *
+ * @return false if no thread could be created
+ */
+bool importer_start(Importer *imp);
+
+/**
+ * @brief Stops and joins the workers
+ *
+ * Slots and roots are kept, so importer_start() continues where the import
+ * stopped (e.g. across hot reload).
+ */
+void importer_stop(Importer *imp);
+
+/**
+ * @brief Queues files and directories for import (render thread)
+ *
+ * @return Number of paths accepted
+ */
+size_t importer_submit(Importer *imp, char *const paths[], size_t count);
+
+/**
+ * @brief Hands finished slots to sink, in submission order (render thread)
+ *
+ * Stops at the first slot still being probed and after
+ * IMPORTER_COLLECT_BATCH slots, so it never waits and never takes long.
+ */
+void importer_collect(Importer *imp, Import_Sink *sink, void *user);
+
+/**
+ * @brief Import progress for display (render thread)
+ *
+ * @param done Output: slots collected
+ * @param total Output: slots listed so far (grows while folders expand)
+ * @return true while an import is in progress
+ */
+bool importer_progress(Importer *imp, size_t *done, size_t *total);
+
+#endif // IMPORTER_H_
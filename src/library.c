@@ -0,0 +1,845 @@
+/**
+ * @file library.c
+ * @brief Library index: mapping, rebuilding and inotify watching
+ */
+#define _GNU_SOURCE // mremap()
+#include "library.h"
+
+#include <dirent.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <poll.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <sys/inotify.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "fs_util.h"
+#include "tags.h"
+
+#define LIBRARY_MAX_DEPTH 32  ///< Deepest folder nesting indexed
+#define LIBRARY_MAX_PROBERS 8 ///< Upper bound on probing threads
+#define LIBRARY_POLL_MS 250   ///< Longest wait before checking running
+#define LIBRARY_WATCH_MASK                                                     \
+  (IN_CREATE | IN_CLOSE_WRITE | IN_DELETE | IN_MOVED_FROM | IN_MOVED_TO |     \
+   IN_ONLYDIR)
+
+/// Extensions indexed (same set the importer picks up inside folders)
+static const char *const audio_extensions[] = {".wav", ".ogg", ".mp3",
+                                               ".flac", ".qoa"};
+
+/* --- Mapped index --- */
+
+static void unmap_view(Library_View *view) {
+  if (view->map)
+    munmap(view->map, view->map_size);
+  *view = (Library_View){0};
+}
+
+/**
+ * @brief Maps path and checks that every offset stays inside the file
+ */
+static bool map_view(const char *path, Library_View *view) {
+  *view = (Library_View){0};
+  int fd = open(path, O_RDONLY | O_CLOEXEC);
+  if (fd < 0)
+    return false;
+  struct stat st;
+  void *map = MAP_FAILED;
+  if (fstat(fd, &st) == 0 && (size_t)st.st_size > sizeof(Library_Header))
+    map = mmap(NULL, (size_t)st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+  close(fd);
+  if (map == MAP_FAILED)
+    return false;
+
+  size_t size = (size_t)st.st_size;
+  const Library_Header *header = map;
+  const Library_Record *records = (const void *)(header + 1);
+  const char *strings = (const char *)(records + header->count);
+  bool valid =
+      memcmp(header->magic, LIBRARY_MAGIC, sizeof(header->magic)) == 0 &&
+      header->version == LIBRARY_VERSION && header->strings_size > 0 &&
+      sizeof(*header) + header->count * sizeof(*records) +
+              header->strings_size ==
+          size &&
+      strings[header->strings_size - 1] == '\0';
+  for (size_t i = 0; valid && i < header->count; i++) {
+    const Library_Record *r = &records[i];
+    valid = r->path < header->strings_size &&
+            r->title < header->strings_size &&
+            r->artist < header->strings_size &&
+            r->album < header->strings_size;
+  }
+  if (!valid) {
+    fprintf(stderr, "WARNING: ignoring invalid library index %s\n", path);
+    munmap(map, size);
+    return false;
+  }
+
+  view->map = map;
+  view->map_size = size;
+  view->records = records;
+  view->count = header->count;
+  view->strings = strings;
+  return true;
+}
+
+static const Library_Record *view_find(const Library_View *view,
+                                       const char *path) {
+  size_t lo = 0, hi = view->count;
+  while (lo < hi) {
+    size_t mid = lo + (hi - lo) / 2;
+    int order = strcmp(view->strings + view->records[mid].path, path);
+    if (order == 0)
+      return &view->records[mid];
+    if (order < 0)
+      lo = mid + 1;
+    else
+      hi = mid;
+  }
+  return NULL;
+}
+
+/**
+ * @brief Index of the first record whose path is not below prefix
+ */
+static size_t view_lower_bound(const Library_View *view, const char *prefix) {
+  size_t lo = 0, hi = view->count;
+  while (lo < hi) {
+    size_t mid = lo + (hi - lo) / 2;
+    if (strcmp(view->strings + view->records[mid].path, prefix) < 0)
+      lo = mid + 1;
+    else
+      hi = mid;
+  }
+  return lo;
+}
+
+static int64_t mtime_ns(const struct stat *st) {
+  return (int64_t)st->st_mtim.tv_sec * 1000000000 + st->st_mtim.tv_nsec;
+}
+
+/* --- Rebuilding --- */
+
+/**
+ * @struct Scan_Entry
+ * @brief A file found while walking, with the record it will become
+ */
+typedef struct {
+  char *path;                ///< Owned unless kept
+  int64_t mtime_ns;          ///< From stat
+  uint64_t size;             ///< From stat
+  const Library_Record *old; ///< Up-to-date record of the old index
+  Track_Info info;           ///< Probed info when old is NULL
+  Track_Tags *tags;          ///< Probed tags when old is NULL, owned
+  bool playable;             ///< Probe result when old is NULL
+  bool kept;                 ///< Taken from the old index without a walk
+} Scan_Entry;
+
+/**
+ * @struct Scan
+ * @brief Entries of one rebuild
+ */
+typedef struct {
+  Library *lib;
+  Scan_Entry *items;
+  size_t count;
+  size_t capacity;
+  bool failed; ///< Out of memory: keep the old index
+} Scan;
+
+/**
+ * @struct Watcher
+ * @brief inotify instance and the directory behind each watch descriptor
+ */
+typedef struct {
+  int fd; ///< -1 when inotify is not available
+  struct {
+    int wd;
+    char *path;
+  } *watches;
+  size_t count;
+  size_t capacity;
+} Watcher;
+
+static bool is_audio_file(const char *name) {
+  const char *dot = strrchr(name, '.');
+  if (!dot)
+    return false;
+  for (size_t i = 0; i < sizeof(audio_extensions) / sizeof(*audio_extensions);
+       i++)
+    if (strcasecmp(dot, audio_extensions[i]) == 0)
+      return true;
+  return false;
+}
+
+static bool running(Library *lib) {
+  return atomic_load_explicit(&lib->running, memory_order_relaxed);
+}
+
+static void add_entry(Scan *scan, Scan_Entry entry) {
+  if (scan->count == scan->capacity) {
+    size_t grown = scan->capacity ? scan->capacity * 2 : 1024;
+    Scan_Entry *items = realloc(scan->items, grown * sizeof(*items));
+    if (!items) {
+      scan->failed = true;
+      if (!entry.kept)
+        free(entry.path);
+      return;
+    }
+    scan->items = items;
+    scan->capacity = grown;
+  }
+  scan->items[scan->count++] = entry;
+}
+
+static void add_file(Scan *scan, const char *path, const struct stat *st) {
+  char *copy = strdup(path);
+  if (!copy) {
+    scan->failed = true;
+    return;
+  }
+  add_entry(scan, (Scan_Entry){.path = copy,
+                               .mtime_ns = mtime_ns(st),
+                               .size = (uint64_t)st->st_size});
+}
+
+static void watch(Watcher *w, const char *path) {
+  if (w->fd < 0)
+    return;
+  int wd = inotify_add_watch(w->fd, path, LIBRARY_WATCH_MASK);
+  if (wd < 0)
+    return;
+
+  /* The same directory reached again keeps its descriptor */
+  for (size_t i = 0; i < w->count; i++) {
+    if (w->watches[i].wd == wd) {
+      char *copy = strdup(path);
+      if (copy) {
+        free(w->watches[i].path);
+        w->watches[i].path = copy;
+      }
+      return;
+    }
+  }
+  if (w->count == w->capacity) {
+    size_t grown = w->capacity ? w->capacity * 2 : 64;
+    void *items = realloc(w->watches, grown * sizeof(*w->watches));
+    if (!items)
+      return;
+    w->watches = items;
+    w->capacity = grown;
+  }
+  char *copy = strdup(path);
+  if (!copy)
+    return;
+  w->watches[w->count].wd = wd;
+  w->watches[w->count].path = copy;
+  w->count++;
+}
+
+static const char *watched_path(const Watcher *w, int wd) {
+  for (size_t i = 0; i < w->count; i++)
+    if (w->watches[i].wd == wd)
+      return w->watches[i].path;
+  return NULL;
+}
+
+static void unwatch(Watcher *w, int wd) {
+  for (size_t i = 0; i < w->count; i++) {
+    if (w->watches[i].wd == wd) {
+      free(w->watches[i].path);
+      w->watches[i] = w->watches[--w->count];
+      return;
+    }
+  }
+}
+
+/**
+ * @brief Lists the audio files below path and watches its directories
+ *
+ * Hidden entries are skipped and symbolic links are followed to files
+ * only, the same rules the importer applies to dropped folders.
+ */
+static void walk_dir(Scan *scan, Watcher *w, const char *path,
+                     unsigned depth) {
+  if (depth > LIBRARY_MAX_DEPTH || !running(scan->lib))
+    return;
+  DIR *dir = opendir(path);
+  if (!dir)
+    return;
+  watch(w, path);
+
+  struct dirent *entry;
+  while ((entry = readdir(dir))) {
+    if (entry->d_name[0] == '.')
+      continue;
+    char child[PATH_MAX];
+    if (snprintf(child, sizeof(child), "%s/%s", path, entry->d_name) >=
+        (int)sizeof(child))
+      continue;
+
+    if (entry->d_type == DT_DIR) {
+      walk_dir(scan, w, child, depth + 1);
+      continue;
+    }
+    if (entry->d_type != DT_REG && entry->d_type != DT_LNK &&
+        entry->d_type != DT_UNKNOWN)
+      continue;
+    if (entry->d_type == DT_UNKNOWN) {
+      struct stat st;
+      if (fstatat(dirfd(dir), entry->d_name, &st, AT_SYMLINK_NOFOLLOW) == 0 &&
+          S_ISDIR(st.st_mode)) {
+        walk_dir(scan, w, child, depth + 1);
+        continue;
+      }
+    }
+    struct stat st;
+    if (is_audio_file(entry->d_name) &&
+        fstatat(dirfd(dir), entry->d_name, &st, 0) == 0 &&
+        S_ISREG(st.st_mode))
+      add_file(scan, child, &st);
+  }
+  closedir(dir);
+}
+
+/**
+ * @brief Adds whatever is at path now: a file, a tree, or nothing
+ */
+static void walk_path(Scan *scan, Watcher *w, const char *path) {
+  struct stat st;
+  if (lstat(path, &st) != 0)
+    return;
+  if (S_ISDIR(st.st_mode)) {
+    walk_dir(scan, w, path, 0);
+    return;
+  }
+  const char *name = strrchr(path, '/');
+  name = name ? name + 1 : path;
+  if (name[0] != '.' && is_audio_file(name) && stat(path, &st) == 0 &&
+      S_ISREG(st.st_mode))
+    add_file(scan, path, &st);
+}
+
+static bool below(const char *path, const char *dir) {
+  size_t len = strlen(dir);
+  return strncmp(path, dir, len) == 0 &&
+         (path[len] == '\0' || path[len] == '/');
+}
+
+/**
+ * @brief Adds the old records not touched by any change, without stat
+ */
+static void keep_unchanged(Scan *scan, const Library_View *base,
+                           char *const changes[], size_t change_count) {
+  if (base->count == 0)
+    return;
+  bool *drop = calloc(base->count, sizeof(*drop));
+  if (!drop) {
+    scan->failed = true;
+    return;
+  }
+  for (size_t c = 0; c < change_count; c++) {
+    for (size_t i = view_lower_bound(base, changes[c]); i < base->count; i++) {
+      const char *path = base->strings + base->records[i].path;
+      if (strncmp(path, changes[c], strlen(changes[c])) != 0)
+        break;
+      if (below(path, changes[c]))
+        drop[i] = true;
+    }
+  }
+  for (size_t i = 0; i < base->count; i++) {
+    if (drop[i])
+      continue;
+    const Library_Record *r = &base->records[i];
+    add_entry(scan, (Scan_Entry){.path = (char *)base->strings + r->path,
+                                 .mtime_ns = r->mtime_ns,
+                                 .size = r->size,
+                                 .old = r,
+                                 .kept = true});
+  }
+  free(drop);
+}
+
+static int compare_entries(const void *a, const void *b) {
+  return strcmp(((const Scan_Entry *)a)->path, ((const Scan_Entry *)b)->path);
+}
+
+static void free_entry(Scan_Entry *entry) {
+  if (!entry->kept)
+    free(entry->path);
+  free(entry->tags);
+}
+
+/**
+ * @brief Sorts by path and drops the duplicates overlapping changes make
+ */
+static void sort_entries(Scan *scan) {
+  qsort(scan->items, scan->count, sizeof(*scan->items), compare_entries);
+  size_t out = 0;
+  for (size_t i = 0; i < scan->count; i++) {
+    if (out > 0 && strcmp(scan->items[out - 1].path, scan->items[i].path) == 0)
+      free_entry(&scan->items[i]);
+    else
+      scan->items[out++] = scan->items[i];
+  }
+  scan->count = out;
+}
+
+/**
+ * @struct Probe_Job
+ * @brief Entries shared by the probing threads of one rebuild
+ */
+typedef struct {
+  Scan *scan;
+  size_t *todo;       ///< Indices of the entries to probe
+  size_t todo_count;  ///< Number of indices
+  atomic_size_t next; ///< First index not yet claimed
+} Probe_Job;
+
+static void *probe_thread(void *arg) {
+  Probe_Job *job = arg;
+  for (;;) {
+    size_t i = atomic_fetch_add_explicit(&job->next, 1, memory_order_relaxed);
+    if (i >= job->todo_count || !running(job->scan->lib))
+      break;
+    Scan_Entry *entry = &job->scan->items[job->todo[i]];
+    entry->playable = import_probe(entry->path, &entry->info);
+    entry->tags = malloc(sizeof(*entry->tags));
+    if (entry->tags)
+      tags_read(entry->path, entry->tags);
+  }
+  return NULL;
+}
+
+/**
+ * @brief Matches entries with the old index and probes the rest in parallel
+ *
+ * @return Number of entries probed
+ */
+static size_t probe_entries(Scan *scan, const Library_View *base) {
+  size_t *todo = malloc((scan->count ? scan->count : 1) * sizeof(*todo));
+  if (!todo) {
+    scan->failed = true;
+    return 0;
+  }
+  size_t todo_count = 0;
+  for (size_t i = 0; i < scan->count; i++) {
+    Scan_Entry *entry = &scan->items[i];
+    if (entry->kept)
+      continue;
+    const Library_Record *old = view_find(base, entry->path);
+    if (old && old->mtime_ns == entry->mtime_ns && old->size == entry->size)
+      entry->old = old;
+    else
+      todo[todo_count++] = i;
+  }
+
+  if (todo_count > 0) {
+    Probe_Job job = {.scan = scan, .todo = todo, .todo_count = todo_count};
+    long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+    size_t wanted = cpus < 1 ? 1 : (size_t)cpus;
+    if (wanted > LIBRARY_MAX_PROBERS)
+      wanted = LIBRARY_MAX_PROBERS;
+    if (wanted > todo_count)
+      wanted = todo_count;
+
+    pthread_t threads[LIBRARY_MAX_PROBERS];
+    size_t started = 0;
+    while (started < wanted &&
+           pthread_create(&threads[started], NULL, probe_thread, &job) == 0)
+      started++;
+    if (started == 0)
+      probe_thread(&job);
+    for (size_t i = 0; i < started; i++)
+      pthread_join(threads[i], NULL);
+  }
+  free(todo);
+  return todo_count;
+}
+
+/**
+ * @struct Pool
+ * @brief String pool being built for a new index
+ */
+typedef struct {
+  char *data;
+  size_t size;
+  size_t capacity;
+  bool failed;
+} Pool;
+
+static uint32_t intern(Pool *pool, const char *s) {
+  if (!s || !s[0])
+    return 0;
+  size_t len = strlen(s) + 1;
+  if (pool->size + len > UINT32_MAX) {
+    pool->failed = true;
+    return 0;
+  }
+  if (pool->size + len > pool->capacity) {
+    size_t grown = pool->capacity ? pool->capacity * 2 : 1 << 16;
+    while (grown < pool->size + len)
+      grown *= 2;
+    char *data = realloc(pool->data, grown);
+    if (!data) {
+      pool->failed = true;
+      return 0;
+    }
+    pool->data = data;
+    pool->capacity = grown;
+  }
+  uint32_t offset = (uint32_t)pool->size;
+  memcpy(&pool->data[pool->size], s, len);
+  pool->size += len;
+  return offset;
+}
+
+/**
+ * @struct Index_File
+ * @brief What an index is written from
+ */
+typedef struct {
+  Library_Header header;
+  const Library_Record *records;
+  const Pool *pool;
+} Index_File;
+
+static bool put_index(FILE *f, void *user) {
+  const Index_File *index = user;
+  size_t count = index->header.count;
+  return fwrite(&index->header, sizeof(index->header), 1, f) == 1 &&
+         fwrite(index->records, sizeof(*index->records), count, f) ==
+             count &&
+         fwrite(index->pool->data, 1, index->pool->size, f) ==
+             index->pool->size;
+}
+
+/**
+ * @brief Writes the entries as a new index and renames it into place
+ */
+static bool write_index(const char *index_path, const Scan *scan,
+                        const Library_View *base) {
+  Library_Record *records =
+      malloc((scan->count ? scan->count : 1) * sizeof(*records));
+  if (!records)
+    return false;
+  /* Offset 0 is the empty string */
+  Pool pool = {.data = malloc(1 << 16), .size = 1, .capacity = 1 << 16};
+  if (pool.data)
+    pool.data[0] = '\0';
+  else
+    pool.failed = true;
+
+  for (size_t i = 0; i < scan->count && !pool.failed; i++) {
+    const Scan_Entry *entry = &scan->items[i];
+    Library_Record *r = &records[i];
+    *r = (Library_Record){.mtime_ns = entry->mtime_ns, .size = entry->size};
+    r->path = intern(&pool, entry->path);
+    if (entry->old) {
+      const Library_Record *old = entry->old;
+      r->title = intern(&pool, base->strings + old->title);
+      r->artist = intern(&pool, base->strings + old->artist);
+      r->album = intern(&pool, base->strings + old->album);
+      r->length = old->length;
+      r->sample_rate = old->sample_rate;
+      r->channels = old->channels;
+      r->flags = old->flags;
+    } else {
+      if (entry->tags) {
+        r->title = intern(&pool, entry->tags->title);
+        r->artist = intern(&pool, entry->tags->artist);
+        r->album = intern(&pool, entry->tags->album);
+      }
+      if (entry->playable) {
+        r->length = entry->info.length;
+        r->sample_rate = entry->info.sample_rate;
+        r->channels = (uint16_t)entry->info.channels;
+        r->flags = LIBRARY_PLAYABLE;
+      }
+    }
+  }
+
+  bool ok = false;
+  if (!pool.failed) {
+    Index_File index = {.header = {.version = LIBRARY_VERSION,
+                                   .count = (uint32_t)scan->count,
+                                   .strings_size = pool.size},
+                        .records = records,
+                        .pool = &pool};
+    memcpy(index.header.magic, LIBRARY_MAGIC, sizeof(index.header.magic));
+    ok = fs_write_atomic(index_path, put_index, &index, true);
+  }
+  if (!ok)
+    fprintf(stderr, "WARNING: could not write library index %s\n",
+            index_path);
+  free(records);
+  free(pool.data);
+  return ok;
+}
+
+/**
+ * @brief Rebuilds the index from the roots, or applies changes to base
+ *
+ * @param changes Paths named by inotify events, or NULL for a full rescan
+ *        of the roots
+ */
+static void rebuild(Library *lib, Watcher *w, Library_View *base,
+                    char *const changes[], size_t change_count) {
+  atomic_store_explicit(&lib->busy, true, memory_order_relaxed);
+  Scan scan = {.lib = lib};
+  if (changes) {
+    keep_unchanged(&scan, base, changes, change_count);
+    for (size_t i = 0; i < change_count; i++)
+      walk_path(&scan, w, changes[i]);
+  } else {
+    for (size_t i = 0; i < lib->root_count; i++)
+      walk_dir(&scan, w, lib->roots[i], 0);
+  }
+  sort_entries(&scan);
+  size_t probed = running(lib) ? probe_entries(&scan, base) : 0;
+
+  /* Unchanged if every old record is still there and nothing was probed */
+  size_t reused = 0;
+  for (size_t i = 0; i < scan.count; i++)
+    reused += scan.items[i].old != NULL;
+  bool changed = probed > 0 || reused != base->count || !base->map;
+
+  if (changed && running(lib) && !scan.failed &&
+      write_index(lib->index_path, &scan, base)) {
+    Library_View view;
+    if (map_view(lib->index_path, &view)) {
+      unmap_view(base);
+      *base = view;
+    }
+    atomic_fetch_add_explicit(&lib->generation, 1, memory_order_release);
+  }
+
+  for (size_t i = 0; i < scan.count; i++)
+    free_entry(&scan.items[i]);
+  free(scan.items);
+  atomic_store_explicit(&lib->busy, false, memory_order_relaxed);
+}
+
+/* --- Watching --- */
+
+/**
+ * @struct Changes
+ * @brief Paths touched by events since the last rebuild
+ */
+typedef struct {
+  char *paths[LIBRARY_MAX_CHANGES];
+  size_t count;
+  bool overflow; ///< Too many, or events were lost: rescan everything
+} Changes;
+
+static void note_change(Changes *changes, const char *dir, const char *name) {
+  char path[PATH_MAX];
+  if (snprintf(path, sizeof(path), "%s/%s", dir, name) >= (int)sizeof(path))
+    return;
+  for (size_t i = 0; i < changes->count; i++)
+    if (strcmp(changes->paths[i], path) == 0)
+      return;
+  if (changes->count == LIBRARY_MAX_CHANGES ||
+      !(changes->paths[changes->count] = strdup(path))) {
+    changes->overflow = true;
+    return;
+  }
+  changes->count++;
+}
+
+static void clear_changes(Changes *changes) {
+  for (size_t i = 0; i < changes->count; i++)
+    free(changes->paths[i]);
+  changes->count = 0;
+  changes->overflow = false;
+}
+
+/**
+ * @brief Drains the inotify queue into changes
+ *
+ * @return true if any event arrived
+ */
+static bool read_events(Watcher *w, Changes *changes) {
+  char buffer[16384]
+      __attribute__((aligned(__alignof__(struct inotify_event))));
+  bool any = false;
+  ssize_t len;
+  while ((len = read(w->fd, buffer, sizeof(buffer))) > 0) {
+    any = true;
+    for (char *p = buffer; p < buffer + len;) {
+      const struct inotify_event *event = (const void *)p;
+      p += sizeof(*event) + event->len;
+      if (event->mask & IN_Q_OVERFLOW) {
+        changes->overflow = true;
+        continue;
+      }
+      if (event->mask & IN_IGNORED) {
+        unwatch(w, event->wd);
+        continue;
+      }
+      const char *dir = watched_path(w, event->wd);
+      if (!dir || event->len == 0 || event->name[0] == '.')
+        continue;
+      /* A created file is picked up when it is closed after writing */
+      if ((event->mask & IN_CREATE) && !(event->mask & IN_ISDIR))
+        continue;
+      note_change(changes, dir, event->name);
+    }
+  }
+  return any;
+}
+
+static double now_ms(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec * 1000.0 + ts.tv_nsec / 1e6;
+}
+
+static void *library_thread(void *arg) {
+  Library *lib = arg;
+  Watcher w = {.fd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC)};
+  if (w.fd < 0)
+    fprintf(stderr, "WARNING: inotify unavailable, library is not watched\n");
+
+  Library_View base;
+  map_view(lib->index_path, &base);
+  rebuild(lib, &w, &base, NULL, 0);
+
+  Changes changes = {0};
+  double quiet_since = 0.0;
+  while (running(lib) && w.fd >= 0) {
+    struct pollfd pfd = {.fd = w.fd, .events = POLLIN};
+    if (poll(&pfd, 1, LIBRARY_POLL_MS) > 0 && read_events(&w, &changes))
+      quiet_since = now_ms();
+
+    if ((changes.count > 0 || changes.overflow) &&
+        now_ms() - quiet_since >= LIBRARY_SETTLE_MS) {
+      if (changes.overflow)
+        rebuild(lib, &w, &base, NULL, 0);
+      else
+        rebuild(lib, &w, &base, changes.paths, changes.count);
+      clear_changes(&changes);
+    }
+  }
+
+  clear_changes(&changes);
+  for (size_t i = 0; i < w.count; i++)
+    free(w.watches[i].path);
+  free(w.watches);
+  if (w.fd >= 0)
+    close(w.fd);
+  unmap_view(&base);
+  return NULL;
+}
+
+/* --- Render thread API --- */
+
+void library_configure(Library *lib, const char *index_path,
+                       char *const roots[], size_t root_count) {
+  free(lib->index_path);
+  lib->index_path = strdup(index_path);
+  for (size_t i = 0; i < lib->root_count; i++)
+    free(lib->roots[i]);
+  lib->root_count = 0;
+  for (size_t i = 0; i < root_count && i < LIBRARY_MAX_ROOTS; i++)
+    if ((lib->roots[lib->root_count] = strdup(roots[i])))
+      lib->root_count++;
+
+  unmap_view(&lib->view);
+  if (lib->index_path)
+    map_view(lib->index_path, &lib->view);
+  lib->generation_seen =
+      atomic_load_explicit(&lib->generation, memory_order_relaxed);
+}
+
+bool library_start(Library *lib) {
+  if (lib->started || !lib->index_path)
+    return false;
+  atomic_store_explicit(&lib->running, true, memory_order_relaxed);
+  if (pthread_create(&lib->thread, NULL, library_thread, lib) != 0) {
+    atomic_store_explicit(&lib->running, false, memory_order_relaxed);
+    return false;
+  }
+  lib->started = true;
+  return true;
+}
+
+void library_stop(Library *lib) {
+  if (!lib->started)
+    return;
+  atomic_store_explicit(&lib->running, false, memory_order_relaxed);
+  pthread_join(lib->thread, NULL);
+  lib->started = false;
+}
+
+void library_close(Library *lib) {
+  library_stop(lib);
+  unmap_view(&lib->view);
+  free(lib->index_path);
+  lib->index_path = NULL;
+  for (size_t i = 0; i < lib->root_count; i++)
+    free(lib->roots[i]);
+  lib->root_count = 0;
+}
+
+bool library_poll(Library *lib) {
+  unsigned generation =
+      atomic_load_explicit(&lib->generation, memory_order_acquire);
+  if (generation == lib->generation_seen)
+    return false;
+  lib->generation_seen = generation;
+
+  Library_View view;
+  if (!map_view(lib->index_path, &view))
+    return false;
+  unmap_view(&lib->view);
+  lib->view = view;
+  return true;
+}
+
+bool library_view_share(const Library_View *view, Library_View *copy) {
+  *copy = (Library_View){0};
+  if (!view->map)
+    return false;
+  /* An old size of 0 maps the same pages of a shared mapping again */
+  char *map = mremap(view->map, 0, view->map_size, MREMAP_MAYMOVE);
+  if (map == MAP_FAILED)
+    return false;
+  const char *base = view->map;
+  copy->map = map;
+  copy->map_size = view->map_size;
+  copy->records =
+      (const Library_Record *)(map + ((const char *)view->records - base));
+  copy->count = view->count;
+  copy->strings = map + (view->strings - base);
+  return true;
+}
+
+void library_view_release(Library_View *view) { unmap_view(view); }
+
+const Library_Record *library_find(const Library *lib, const char *path) {
+  return view_find(&lib->view, path);
+}
+
+const char *library_string(const Library *lib, uint32_t offset) {
+  return lib->view.strings ? lib->view.strings + offset : "";
+}
+
+bool library_track_info(const Library *lib, const char *path,
+                        Track_Info *info) {
+  const Library_Record *r = library_find(lib, path);
+  struct stat st;
+  if (!r || !(r->flags & LIBRARY_PLAYABLE) || stat(path, &st) != 0 ||
+      mtime_ns(&st) != r->mtime_ns || (uint64_t)st.st_size != r->size)
+    return false;
+  info->length = r->length;
+  info->sample_rate = r->sample_rate;
+  info->channels = r->channels;
+  return true;
+}
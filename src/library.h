@@ -0,0 +1,172 @@
+/**
+ * @file library.h
+ * @brief Persistent index of the music under a few library roots
+ *
+ * The index is one binary file: a header, a record per audio file sorted by
+ * path, then a pool of NUL-terminated strings the records point into by
+ * offset. It is memory-mapped as is, so opening it at startup costs one
+ * mmap() and a validation pass, however large the library is. Looking a
+ * path up is a binary search over the mapped records. The file is a
+ * machine-local cache written in native byte order; one that does not
+ * validate is simply rebuilt.
+ *
+ * A library thread keeps the file current. At start it walks the roots and
+ * rebuilds the index, reusing every record whose file still has the same
+ * mtime and size, so only new or changed files are probed (on a pool of
+ * threads, like the importer). It then watches every directory with
+ * inotify and applies changes incrementally: a burst of events is collected
+ * until the tree has been quiet for a moment, and only the paths named by
+ * the events are walked again. Every rebuild writes a new file and renames
+ * it over the old one, so a reader never sees a half-written index; the
+ * render thread picks the new file up in library_poll().
+ */
+#ifndef LIBRARY_H_
+#define LIBRARY_H_
+
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "importer.h"
+
+#define LIBRARY_MAGIC "MUSULIB"  ///< First 8 bytes of an index (with NUL)
+#define LIBRARY_VERSION 1        ///< Bumped when the layout changes
+#define LIBRARY_MAX_ROOTS 16     ///< Directories indexed
+#define LIBRARY_SETTLE_MS 500    ///< Quiet time before applying changes
+#define LIBRARY_MAX_CHANGES 4096 ///< Pending changes before a full rescan
+
+/**
+ * @struct Library_Header
+ * @brief Start of the index file
+ */
+typedef struct {
+  char magic[8];         ///< LIBRARY_MAGIC
+  uint32_t version;      ///< LIBRARY_VERSION
+  uint32_t count;        ///< Records following the header
+  uint64_t strings_size; ///< Bytes of string pool after the records
+} Library_Header;
+
+/// Library_Record::flags bit: the file decoded when probed
+#define LIBRARY_PLAYABLE 1u
+
+/**
+ * @struct Library_Record
+ * @brief One indexed file
+ *
+ * String fields are offsets into the string pool; offset 0 is the empty
+ * string.
+ */
+typedef struct {
+  int64_t mtime_ns;     ///< Modification time when probed
+  uint64_t size;        ///< File size when probed
+  uint32_t path;        ///< Absolute path, the sort key
+  uint32_t title;       ///< Tag, may be empty
+  uint32_t artist;      ///< Tag, may be empty
+  uint32_t album;       ///< Tag, may be empty
+  float length;         ///< Duration in seconds
+  uint32_t sample_rate; ///< Sample rate in Hz
+  uint16_t channels;    ///< Channel count
+  uint16_t flags;       ///< LIBRARY_PLAYABLE
+  uint32_t reserved;    ///< Zero
+} Library_Record;
+
+/**
+ * @struct Library_View
+ * @brief A mapped, validated index file
+ */
+typedef struct {
+  void *map;                     ///< Whole file, NULL if none
+  size_t map_size;               ///< Bytes mapped
+  const Library_Record *records; ///< count records, sorted by path
+  size_t count;                  ///< Number of records
+  const char *strings;           ///< String pool
+} Library_View;
+
+/**
+ * @struct Library
+ * @brief Index shown to the render thread plus its updating thread
+ *
+ * Embedded in Plug so it survives hot reload.
+ */
+typedef struct {
+  Library_View view;        ///< Render thread's mapping
+  unsigned generation_seen; ///< generation view was mapped at
+
+  char *index_path;               ///< Index file, owned
+  char *roots[LIBRARY_MAX_ROOTS]; ///< Indexed directories, owned
+  size_t root_count;              ///< Number of roots
+
+  pthread_t thread;
+  bool started;           ///< thread exists
+  atomic_bool running;    ///< Cleared to stop the thread
+  atomic_bool busy;       ///< Scanning or probing right now
+  atomic_uint generation; ///< Bumped after each index file written
+} Library;
+
+/**
+ * @brief Sets the index file and the roots, and maps the index if present
+ *
+ * The existing index is usable right away, before library_start().
+ */
+void library_configure(Library *lib, const char *index_path,
+                       char *const roots[], size_t root_count);
+
+/**
+ * @brief Starts the thread that refreshes and watches the index
+ */
+bool library_start(Library *lib);
+
+/**
+ * @brief Stops and joins the library thread
+ */
+void library_stop(Library *lib);
+
+/**
+ * @brief Unmaps the index and frees the configuration
+ */
+void library_close(Library *lib);
+
+/**
+ * @brief Maps a newly written index (render thread, once per frame)
+ *
+ * @return true if the view changed
+ */
+bool library_poll(Library *lib);
+
+/**
+ * @brief Maps the pages of view again, for use on another thread
+ *
+ * The copy stays valid after the render thread moves on to a newer index;
+ * free it with library_view_release().
+ */
+bool library_view_share(const Library_View *view, Library_View *copy);
+
+/**
+ * @brief Unmaps a view obtained from library_view_share()
+ */
+void library_view_release(Library_View *view);
+
+/**
+ * @brief Record for path, or NULL if it is not indexed
+ */
+const Library_Record *library_find(const Library *lib, const char *path);
+
+/**
+ * @brief String at a record offset
+ */
+const char *library_string(const Library *lib, uint32_t offset);
+
+/**
+ * @brief Track info of path from the index, if its entry is still current
+ *
+ * Stats path and compares mtime and size, which is far cheaper than probing
+ * the file.
+ *
+ * @return false if path is not indexed, changed since, or not playable
+ */
+bool library_track_info(const Library *lib, const char *path,
+                        Track_Info *info);
+
+#endif // LIBRARY_H_
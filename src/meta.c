@@ -0,0 +1,510 @@
+/**
+ * @file meta.c
+ * @brief Worker pool reading tags and cover art, thumbnail cache and atlas
+ */
+#include "meta.h"
+
+#include <limits.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "fs_util.h"
+
+/// Bytes of one RGBA thumbnail
+#define THUMB_BYTES (META_THUMB_SIZE * META_THUMB_SIZE * 4)
+
+/// Cover images looked for next to a track without embedded art
+static const char *const cover_names[] = {
+    "cover.jpg", "cover.png", "folder.jpg", "folder.png",
+    "front.jpg", "front.png", "Cover.jpg",  "Folder.jpg",
+};
+
+/**
+ * @struct Thumb_Header
+ * @brief Start of a cache file; the path, the label and, with art, the
+ * pixels follow
+ */
+typedef struct {
+  char magic[8];      ///< META_MAGIC
+  uint32_t version;   ///< META_VERSION
+  uint32_t has_art;   ///< THUMB_BYTES of pixels follow the label
+  int64_t mtime_ns;   ///< Track modification time when made
+  uint64_t size;      ///< Track size when made
+  uint32_t path_len;  ///< Track path, checked against hash collisions
+  uint32_t label_len; ///< 0 if untagged
+} Thumb_Header;
+
+/**
+ * @brief Cache file of path: FNV-1a of the path under the cache directory
+ */
+static bool thumb_path(const char *cache_dir, const char *path, char *out,
+                       size_t size) {
+  uint64_t hash = 0xcbf29ce484222325ull;
+  for (const unsigned char *p = (const unsigned char *)path; *p; p++)
+    hash = (hash ^ *p) * 0x100000001b3ull;
+  int n = snprintf(out, size, "%s/%016llx.thumb", cache_dir,
+                   (unsigned long long)hash);
+  return n > 0 && (size_t)n < size;
+}
+
+/**
+ * @brief Reads a cache file that is still current for the track
+ */
+static bool read_thumb(const char *file, const char *path, int64_t mtime_ns,
+                       uint64_t size, Meta_Result *result) {
+  FILE *f = fopen(file, "rb");
+  if (!f)
+    return false;
+
+  Thumb_Header header;
+  char stored[PATH_MAX];
+  char label[META_LABEL_MAX];
+  uint8_t *pixels = NULL;
+  size_t path_len = strlen(path);
+  bool ok = fread(&header, sizeof(header), 1, f) == 1 &&
+            memcmp(header.magic, META_MAGIC, sizeof(header.magic)) == 0 &&
+            header.version == META_VERSION && header.mtime_ns == mtime_ns &&
+            header.size == size && header.path_len == path_len &&
+            header.label_len < sizeof(label) &&
+            fread(stored, 1, path_len, f) == path_len &&
+            memcmp(stored, path, path_len) == 0 &&
+            fread(label, 1, header.label_len, f) == header.label_len;
+  if (ok && header.has_art) {
+    pixels = malloc(THUMB_BYTES);
+    ok = pixels && fread(pixels, 1, THUMB_BYTES, f) == THUMB_BYTES;
+  }
+  fclose(f);
+
+  if (ok) {
+    label[header.label_len] = '\0';
+    result->label = header.label_len ? strdup(label) : NULL;
+    result->pixels = pixels;
+  } else {
+    free(pixels);
+  }
+  return ok;
+}
+
+/**
+ * @struct Thumb_File
+ * @brief What a cache file is written from
+ */
+typedef struct {
+  Thumb_Header header;
+  const char *path;
+  const Meta_Result *result;
+} Thumb_File;
+
+static bool put_thumb(FILE *f, void *user) {
+  const Thumb_File *t = user;
+  const Meta_Result *result = t->result;
+  return fwrite(&t->header, sizeof(t->header), 1, f) == 1 &&
+         fwrite(t->path, 1, t->header.path_len, f) == t->header.path_len &&
+         fwrite(result->label ? result->label : "", 1, t->header.label_len,
+                f) == t->header.label_len &&
+         (!result->pixels ||
+          fwrite(result->pixels, 1, THUMB_BYTES, f) == THUMB_BYTES);
+}
+
+/**
+ * @brief Writes a cache file and renames it into place
+ *
+ * The cache only saves work, so a write that fails is simply dropped, and
+ * it is not synced.
+ */
+static void write_thumb(const char *file, const char *path, int64_t mtime_ns,
+                        uint64_t size, const Meta_Result *result) {
+  Thumb_File t = {
+      .header = {.version = META_VERSION,
+                 .has_art = result->pixels != NULL,
+                 .mtime_ns = mtime_ns,
+                 .size = size,
+                 .path_len = (uint32_t)strlen(path),
+                 .label_len =
+                     result->label ? (uint32_t)strlen(result->label) : 0},
+      .path = path,
+      .result = result,
+  };
+  memcpy(t.header.magic, META_MAGIC, sizeof(t.header.magic));
+  fs_write_atomic(file, put_thumb, &t, false);
+}
+
+/**
+ * @brief "Artist - Title", just the title, or NULL without one
+ */
+static char *make_label(const Track_Tags *tags) {
+  if (!tags->title[0])
+    return NULL;
+  char label[META_LABEL_MAX];
+  if (tags->artist[0])
+    snprintf(label, sizeof(label), "%s - %s", tags->artist, tags->title);
+  else
+    snprintf(label, sizeof(label), "%s", tags->title);
+  return strdup(label);
+}
+
+/**
+ * @brief File type raylib needs to decode an image held in memory
+ */
+static const char *image_type(const unsigned char *data, size_t size) {
+  if (size >= 8 && memcmp(data, "\x89PNG\r\n\x1a\n", 8) == 0)
+    return ".png";
+  if (size >= 3 && memcmp(data, "\xFF\xD8\xFF", 3) == 0)
+    return ".jpg";
+  if (size >= 2 && memcmp(data, "BM", 2) == 0)
+    return ".bmp";
+  return NULL;
+}
+
+/**
+ * @brief Crops image to its centered square and scales that down to a
+ * thumbnail; unloads image
+ *
+ * @return THUMB_BYTES of RGBA, or NULL
+ */
+static uint8_t *make_thumbnail(Image image) {
+  if (!IsImageValid(image))
+    return NULL;
+  int side = image.width < image.height ? image.width : image.height;
+  ImageCrop(&image, (Rectangle){(float)(image.width - side) / 2,
+                                (float)(image.height - side) / 2,
+                                (float)side, (float)side});
+  ImageFormat(&image, PIXELFORMAT_UNCOMPRESSED_R8G8B8A8);
+  ImageResize(&image, META_THUMB_SIZE, META_THUMB_SIZE);
+
+  uint8_t *pixels = NULL;
+  if (image.data && image.width == META_THUMB_SIZE &&
+      image.height == META_THUMB_SIZE &&
+      image.format == PIXELFORMAT_UNCOMPRESSED_R8G8B8A8 &&
+      (pixels = malloc(THUMB_BYTES)))
+    memcpy(pixels, image.data, THUMB_BYTES);
+  UnloadImage(image);
+  return pixels;
+}
+
+/**
+ * @brief Thumbnail of a cover image in the track's directory
+ */
+static uint8_t *folder_thumbnail(const char *path) {
+  const char *slash = strrchr(path, '/');
+  int dir_len = slash ? (int)(slash - path) : 1;
+  const char *dir = slash ? path : ".";
+  for (size_t i = 0; i < sizeof(cover_names) / sizeof(*cover_names); i++) {
+    char cover[PATH_MAX];
+    if (snprintf(cover, sizeof(cover), "%.*s/%s", dir_len, dir,
+                 cover_names[i]) >= (int)sizeof(cover) ||
+        access(cover, R_OK) != 0)
+      continue;
+    uint8_t *pixels = make_thumbnail(LoadImage(cover));
+    if (pixels)
+      return pixels;
+  }
+  return NULL;
+}
+
+/**
+ * @brief Fills in the label and thumbnail of path, from the cache if it is
+ * current, otherwise from the file (and then caches them)
+ */
+static void describe(const char *cache_dir, const char *path,
+                     Meta_Result *result) {
+  struct stat st;
+  if (stat(path, &st) != 0)
+    return;
+  int64_t mtime_ns =
+      (int64_t)st.st_mtim.tv_sec * 1000000000 + st.st_mtim.tv_nsec;
+
+  char file[PATH_MAX];
+  bool cached = cache_dir && thumb_path(cache_dir, path, file, sizeof(file));
+  if (cached &&
+      read_thumb(file, path, mtime_ns, (uint64_t)st.st_size, result))
+    return;
+
+  Track_Tags tags;
+  Track_Art art;
+  tags_read_art(path, &tags, &art);
+  result->label = make_label(&tags);
+  const char *type = image_type(art.data, art.size);
+  if (type && art.size <= INT_MAX)
+    result->pixels =
+        make_thumbnail(LoadImageFromMemory(type, art.data, (int)art.size));
+  free(art.data);
+  if (!result->pixels)
+    result->pixels = folder_thumbnail(path);
+
+  if (cached)
+    write_thumb(file, path, mtime_ns, (uint64_t)st.st_size, result);
+}
+
+static void free_result(Meta_Result *result) {
+  free(result->label);
+  free(result->pixels);
+}
+
+/**
+ * @brief Worker: takes the newest request, describes the track, and
+ * queues the result
+ */
+static void *meta_thread(void *arg) {
+  Meta *m = arg;
+  pthread_mutex_lock(&m->lock);
+  while (m->running) {
+    if (m->request_count == 0) {
+      pthread_cond_wait(&m->wake, &m->lock);
+      continue;
+    }
+    m->request_count--;
+    Meta_Request request =
+        m->requests[(m->request_start + m->request_count) % META_MAX_REQUESTS];
+    pthread_mutex_unlock(&m->lock);
+
+    Meta_Result result = {.id = request.id};
+    describe(m->cache_dir, request.path, &result);
+    free(request.path);
+
+    pthread_mutex_lock(&m->lock);
+    if (m->result_count == m->result_capacity) {
+      size_t capacity = m->result_capacity ? m->result_capacity * 2 : 64;
+      Meta_Result *results =
+          realloc(m->results, capacity * sizeof(*results));
+      if (results) {
+        m->results = results;
+        m->result_capacity = capacity;
+      }
+    }
+    /* On allocation failure the entry stays requested and shows no tags */
+    if (m->result_count < m->result_capacity)
+      m->results[m->result_count++] = result;
+    else
+      free_result(&result);
+  }
+  pthread_mutex_unlock(&m->lock);
+  return NULL;
+}
+
+bool meta_start(Meta *m, const char *cache_dir) {
+  if (!m->initialized) {
+    if (pthread_mutex_init(&m->lock, NULL) != 0)
+      return false;
+    if (pthread_cond_init(&m->wake, NULL) != 0) {
+      pthread_mutex_destroy(&m->lock);
+      return false;
+    }
+    for (size_t i = 0; i < META_ATLAS_TILES; i++)
+      m->tiles[i].owner = -1;
+    m->initialized = true;
+  }
+  if (cache_dir && (!m->cache_dir || strcmp(m->cache_dir, cache_dir) != 0)) {
+    free(m->cache_dir);
+    m->cache_dir = strdup(cache_dir);
+  }
+
+  long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+  unsigned wanted = cpus < 1                  ? 1
+                    : cpus > META_MAX_WORKERS ? META_MAX_WORKERS
+                                              : (unsigned)cpus;
+
+  m->running = true;
+  m->thread_count = 0;
+  while (m->thread_count < wanted &&
+         pthread_create(&m->threads[m->thread_count], NULL, meta_thread,
+                        m) == 0)
+    m->thread_count++;
+
+  if (m->thread_count == 0) {
+    m->running = false;
+    return false;
+  }
+  return true;
+}
+
+void meta_stop(Meta *m) {
+  if (!m->initialized)
+    return;
+  pthread_mutex_lock(&m->lock);
+  m->running = false;
+  pthread_cond_broadcast(&m->wake);
+  pthread_mutex_unlock(&m->lock);
+
+  for (unsigned i = 0; i < m->thread_count; i++)
+    pthread_join(m->threads[i], NULL);
+  m->thread_count = 0;
+
+  /* Results of finished requests are kept; waiting ones are asked again */
+  for (size_t i = 0; i < m->request_count; i++) {
+    Meta_Request *request =
+        &m->requests[(m->request_start + i) % META_MAX_REQUESTS];
+    m->entries[request->id].requested = false;
+    free(request->path);
+  }
+  m->request_start = 0;
+  m->request_count = 0;
+}
+
+void meta_free(Meta *m) {
+  if (!m->initialized)
+    return;
+  meta_stop(m);
+  for (size_t i = 0; i < m->result_count; i++)
+    free_result(&m->results[i]);
+  free(m->results);
+  for (size_t i = 0; i < m->entry_count; i++)
+    free(m->entries[i].label);
+  free(m->entries);
+  if (IsTextureValid(m->atlas))
+    UnloadTexture(m->atlas);
+  free(m->cache_dir);
+  pthread_cond_destroy(&m->wake);
+  pthread_mutex_destroy(&m->lock);
+  memset(m, 0, sizeof(*m));
+}
+
+/**
+ * @brief Entry of track id, growing the table as needed
+ */
+static Meta_Entry *entry_at(Meta *m, uint32_t id) {
+  if (id >= m->entry_count) {
+    size_t count = m->entry_count ? m->entry_count : 256;
+    while (count <= id)
+      count *= 2;
+    Meta_Entry *entries = realloc(m->entries, count * sizeof(*entries));
+    if (!entries)
+      return NULL;
+    for (size_t i = m->entry_count; i < count; i++)
+      entries[i] = (Meta_Entry){.tile = -1};
+    m->entries = entries;
+    m->entry_count = count;
+  }
+  return &m->entries[id];
+}
+
+/**
+ * @brief Pushes a request, dropping the oldest one if the ring is full
+ */
+static void request(Meta *m, uint32_t id, const char *path) {
+  char *copy = strdup(path);
+  if (!copy)
+    return;
+  pthread_mutex_lock(&m->lock);
+  if (m->request_count == META_MAX_REQUESTS) {
+    Meta_Request *oldest = &m->requests[m->request_start];
+    m->entries[oldest->id].requested = false;
+    free(oldest->path);
+    m->request_start = (m->request_start + 1) % META_MAX_REQUESTS;
+    m->request_count--;
+  }
+  m->requests[(m->request_start + m->request_count) % META_MAX_REQUESTS] =
+      (Meta_Request){.id = id, .path = copy};
+  m->request_count++;
+  pthread_cond_signal(&m->wake);
+  pthread_mutex_unlock(&m->lock);
+  m->entries[id].requested = true;
+}
+
+const Meta_Entry *meta_get(Meta *m, uint32_t id, const char *path) {
+  static const Meta_Entry unknown = {.tile = -1};
+  Meta_Entry *entry = m->initialized ? entry_at(m, id) : NULL;
+  if (!entry)
+    return &unknown;
+  if (entry->tile >= 0)
+    m->tiles[entry->tile].last_use = m->frame;
+  /* Evicted art is asked for again; the cache makes that cheap */
+  bool wanted = !entry->known || (entry->has_art && entry->tile < 0);
+  if (wanted && !entry->requested && m->running)
+    request(m, id, path);
+  return entry;
+}
+
+Rectangle meta_tile_rect(int tile) {
+  return (Rectangle){
+      (float)(tile % META_ATLAS_SIDE * META_THUMB_SIZE),
+      (float)(tile / META_ATLAS_SIDE * META_THUMB_SIZE),
+      META_THUMB_SIZE,
+      META_THUMB_SIZE,
+  };
+}
+
+/**
+ * @brief A free tile, or the one drawn longest ago if it was not drawn
+ * last frame; -1 if every tile is on screen
+ */
+static int claim_tile(Meta *m) {
+  int best = -1;
+  for (int i = 0; i < META_ATLAS_TILES; i++) {
+    if (m->tiles[i].owner < 0)
+      return i;
+    if (m->tiles[i].last_use + 1 < m->frame &&
+        (best < 0 || m->tiles[i].last_use < m->tiles[best].last_use))
+      best = i;
+  }
+  if (best >= 0)
+    m->entries[m->tiles[best].owner].tile = -1;
+  return best;
+}
+
+/**
+ * @brief Hands a result over to its entry, uploading its thumbnail
+ *
+ * @return false if no tile is free this frame; the result is then kept
+ */
+static bool apply_result(Meta *m, Meta_Result *result) {
+  Meta_Entry *entry = entry_at(m, result->id);
+  if (!entry) {
+    free_result(result);
+    return true;
+  }
+
+  if (result->pixels) {
+    if (!IsTextureValid(m->atlas)) {
+      Image blank = GenImageColor(META_ATLAS_SIZE, META_ATLAS_SIZE, BLANK);
+      m->atlas = LoadTextureFromImage(blank);
+      UnloadImage(blank);
+      SetTextureFilter(m->atlas, TEXTURE_FILTER_BILINEAR);
+    }
+    int tile = entry->tile >= 0 ? entry->tile : claim_tile(m);
+    if (tile < 0)
+      return false;
+    if (IsTextureValid(m->atlas)) {
+      UpdateTextureRec(m->atlas, meta_tile_rect(tile), result->pixels);
+      m->tiles[tile] = (Meta_Tile){.owner = result->id, .last_use = m->frame};
+      entry->tile = tile;
+    }
+  }
+
+  free(entry->label);
+  entry->label = result->label;
+  result->label = NULL;
+  entry->has_art = entry->tile >= 0;
+  entry->known = true;
+  entry->requested = false;
+  free_result(result);
+  return true;
+}
+
+void meta_update(Meta *m) {
+  m->frame++;
+  if (!m->initialized)
+    return;
+
+  pthread_mutex_lock(&m->lock);
+  size_t done = 0;
+  unsigned uploads = 0;
+  for (; done < m->result_count; done++) {
+    Meta_Result *result = &m->results[done];
+    if (result->pixels && uploads == META_UPLOAD_BUDGET)
+      break;
+    bool upload = result->pixels != NULL;
+    if (!apply_result(m, result))
+      break;
+    uploads += upload;
+  }
+  if (done > 0) {
+    m->result_count -= done;
+    memmove(m->results, m->results + done,
+            m->result_count * sizeof(*m->results));
+  }
+  pthread_mutex_unlock(&m->lock);
+}
@@ -0,0 +1,164 @@
+/**
+ * @file meta.h
+ * @brief Track labels and cover thumbnails for the queue, made off-thread
+ *
+ * The queue asks for the tracks it shows with meta_get(), every frame.
+ * Tracks not known yet are pushed onto a request stack that a small pool
+ * of worker threads takes from the top, so the rows on screen right now
+ * are served before the ones scrolled past; when the stack is full the
+ * oldest request is dropped and asked for again if it comes back into
+ * view.
+ *
+ * A worker reads the tags (see tags.h) and the cover art, embedded or a
+ * cover image next to the file, and scales the art down to a
+ * META_THUMB_SIZE square. The outcome is kept in an on-disk thumbnail
+ * cache, one small file per track named by a hash of its path and checked
+ * against the track's mtime and size, so the next start only reads that
+ * file back.
+ *
+ * Thumbnails are drawn from one atlas texture. Finished thumbnails are
+ * uploaded into its tiles by meta_update() on the render thread, at most
+ * META_UPLOAD_BUDGET per frame, so scrolling through a long queue never
+ * stalls a frame on texture uploads. When every tile is taken the one
+ * used longest ago is recycled.
+ */
+#ifndef META_H_
+#define META_H_
+
+#include <pthread.h>
+#include <raylib.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "tags.h"
+
+#define META_THUMB_SIZE 64    ///< Thumbnail side in pixels
+#define META_ATLAS_SIZE 1024  ///< Atlas side in pixels
+#define META_MAX_WORKERS 4    ///< Upper bound on worker threads
+#define META_MAX_REQUESTS 256 ///< Pending requests before the oldest drops
+#define META_UPLOAD_BUDGET 8  ///< Tiles uploaded per frame at most
+#define META_MAGIC "MUSUTHB"  ///< First 8 bytes of a cache file (with NUL)
+#define META_VERSION 1        ///< Bumped when the cache layout changes
+
+/// Longest label, "Artist - Title" with the NUL
+#define META_LABEL_MAX (2 * TAGS_TEXT_MAX + 2)
+/// Tiles along one side of the atlas
+#define META_ATLAS_SIDE (META_ATLAS_SIZE / META_THUMB_SIZE)
+/// Tiles in the atlas
+#define META_ATLAS_TILES (META_ATLAS_SIDE * META_ATLAS_SIDE)
+
+/**
+ * @struct Meta_Entry
+ * @brief What the render thread knows about one track
+ */
+typedef struct {
+  char *label;    ///< "Artist - Title", NULL if untagged; owned
+  int tile;       ///< Atlas tile holding the art, or -1
+  bool requested; ///< Queued or being worked on
+  bool known;     ///< A result came back
+  bool has_art;   ///< The track has art (it may not be in a tile now)
+} Meta_Entry;
+
+/**
+ * @struct Meta_Request
+ * @brief A track waiting for a worker
+ */
+typedef struct {
+  uint32_t id; ///< Track index
+  char *path;  ///< Owned
+} Meta_Request;
+
+/**
+ * @struct Meta_Result
+ * @brief A worker's findings waiting for the render thread
+ */
+typedef struct {
+  uint32_t id;     ///< Track index
+  char *label;     ///< Owned, may be NULL
+  uint8_t *pixels; ///< META_THUMB_SIZE square of RGBA, owned; NULL if no art
+} Meta_Result;
+
+/**
+ * @struct Meta_Tile
+ * @brief Owner of one atlas tile
+ */
+typedef struct {
+  int64_t owner;     ///< Track index shown in the tile, or -1
+  uint64_t last_use; ///< Frame the tile was last drawn
+} Meta_Tile;
+
+/**
+ * @struct Meta
+ * @brief Worker pool, results and atlas, embedded in Plug
+ */
+typedef struct {
+  pthread_mutex_t lock;
+  pthread_cond_t wake; ///< Signalled on new requests and shutdown
+
+  /* Guarded by lock */
+  Meta_Request requests[META_MAX_REQUESTS]; ///< Ring, newest on top
+  size_t request_start;                     ///< Oldest request
+  size_t request_count;                     ///< Requests in the ring
+  Meta_Result *results;                     ///< Finished, oldest first
+  size_t result_count;
+  size_t result_capacity;
+  bool running;
+
+  /* Render thread only */
+  Meta_Entry *entries; ///< Indexed by track
+  size_t entry_count;
+  Texture2D atlas;                   ///< Created on first upload
+  Meta_Tile tiles[META_ATLAS_TILES]; ///< Who owns each tile
+  uint64_t frame;                    ///< Counts meta_update() calls
+
+  char *cache_dir; ///< Thumbnail cache directory, owned; NULL for none
+
+  pthread_t threads[META_MAX_WORKERS];
+  unsigned thread_count;
+  bool initialized; ///< lock and wake exist
+} Meta;
+
+/**
+ * @brief Starts the workers, keeping whatever is already known
+ *
+ * @param cache_dir Thumbnail cache directory, created when first written;
+ *        NULL keeps the one given before (none at first: no cache)
+ */
+bool meta_start(Meta *m, const char *cache_dir);
+
+/**
+ * @brief Stops and joins the workers
+ *
+ * Requests not taken yet are forgotten and asked for again when their
+ * tracks are next drawn.
+ */
+void meta_stop(Meta *m);
+
+/**
+ * @brief Stops the workers and frees everything, the atlas included
+ *
+ * Needs the GL context, so call it before CloseWindow().
+ */
+void meta_free(Meta *m);
+
+/**
+ * @brief Entry of track id, requesting it on first sight (render thread)
+ *
+ * Also marks its tile as in use this frame, so call it only for tracks
+ * that are drawn.
+ */
+const Meta_Entry *meta_get(Meta *m, uint32_t id, const char *path);
+
+/**
+ * @brief Applies finished results and uploads up to META_UPLOAD_BUDGET
+ * thumbnails (render thread, once per frame)
+ */
+void meta_update(Meta *m);
+
+/**
+ * @brief Source rectangle of an atlas tile
+ */
+Rectangle meta_tile_rect(int tile);
+
+#endif // META_H_
@@ -74,6 +74,7 @@ int main(void) {
     plug_update();
   }
 
+  plug_shutdown();
   CloseWindow();
   CloseAudioDevice();
   return 0;
@@ -0,0 +1,461 @@
+/**
+ * @file player.c
+ * @brief Feeder thread: command processing and periodic stream refills
+ */
+#include "player.h"
+
+#include <errno.h>
+#include <sched.h>
+#include <time.h>
+
+#define PLAYER_MASK (PLAYER_QUEUE_SIZE - 1)
+
+_Static_assert((PLAYER_QUEUE_SIZE & PLAYER_MASK) == 0,
+               "PLAYER_QUEUE_SIZE must be a power of two");
+
+/* raylib stream processors carry no user pointer: the taps find the player
+ * through this (set by player_start()) */
+static Player *tapped;
+
+static void tap(unsigned slot, void *frames, unsigned count) {
+  Player *p = tapped;
+  crossfade_process(&p->fade, slot, frames, count, p->processor);
+}
+
+static void tap_0(void *frames, unsigned count) { tap(0, frames, count); }
+static void tap_1(void *frames, unsigned count) { tap(1, frames, count); }
+
+/// Processor attached to the music playing in each crossfade slot
+static const AudioCallback taps[CROSSFADE_SLOTS] = {tap_0, tap_1};
+
+static unsigned to_ms(float seconds) {
+  return seconds > 0.0f ? (unsigned)(seconds * 1000.0f + 0.5f) : 0;
+}
+
+/**
+ * @brief Opens path as a new stream; false if raylib cannot decode it
+ */
+static bool open_music(const char *path, Music *music) {
+  *music = LoadMusicStream(path);
+  return IsMusicValid(*music);
+}
+
+/**
+ * @brief Rewinds music and decodes both halves of its stream buffer
+ *
+ * Done before the music starts, so the first mixer period already has
+ * audio to play.
+ */
+static void prime(Music music) {
+  StopMusicStream(music);
+  UpdateMusicStream(music);
+}
+
+static void publish_position(Player *p) {
+  atomic_store_explicit(&p->length_ms, to_ms(GetMusicTimeLength(p->music)),
+                        memory_order_relaxed);
+  atomic_store_explicit(&p->played_ms, 0, memory_order_relaxed);
+  atomic_store_explicit(&p->current_tag, p->tag, memory_order_release);
+}
+
+/**
+ * @brief Stops the previous music of an advance if it is still playing out
+ */
+static void drop_outgoing(Player *p) {
+  if (!p->has_outgoing)
+    return;
+  /* The incoming slot may still be fading: it now plays alone */
+  atomic_store_explicit(&p->fade.solo, true, memory_order_relaxed);
+  DetachAudioStreamProcessor(p->outgoing.stream, taps[1 - p->slot]);
+  UnloadMusicStream(p->outgoing);
+  p->has_outgoing = false;
+}
+
+/**
+ * @brief Stops and closes the current music
+ */
+static void close_current(Player *p) {
+  if (!p->has_music)
+    return;
+  DetachAudioStreamProcessor(p->music.stream, taps[p->slot]);
+  UnloadMusicStream(p->music);
+  p->has_music = false;
+  p->playing = false;
+}
+
+/**
+ * @brief Makes an already primed stream the current one
+ *
+ * Moves the capture tap to the other crossfade slot and starts next. On an
+ * advance the previous music keeps playing: for fade frames while the two
+ * cross, or just its last buffered samples on a gapless splice. Otherwise it
+ * is closed right after next starts, so the swap falls within one mixer
+ * period.
+ *
+ * @param fade Crossfade length in frames, 0 for none
+ */
+static void switch_to(Player *p, Music next, int tag, bool gapless,
+                      unsigned fade) {
+  drop_outgoing(p);
+  unsigned slot = 1 - p->slot;
+  if (p->has_music)
+    DetachAudioStreamProcessor(p->music.stream, taps[p->slot]);
+  if (p->on_switch)
+    p->on_switch(p->user, next, gapless);
+
+  bool crossing = fade > 0 && p->has_music;
+  if (crossing) {
+    crossfade_begin(&p->fade, slot, fade, p->device_channels);
+    AttachAudioStreamProcessor(p->music.stream, taps[p->slot]);
+  } else {
+    crossfade_reset(&p->fade, slot, p->device_channels);
+  }
+  AttachAudioStreamProcessor(next.stream, taps[slot]);
+
+  SetMusicVolume(next, p->volume);
+  PlayMusicStream(next);
+  if (p->has_music) {
+    if (gapless) {
+      p->outgoing = p->music;
+      p->has_outgoing = true;
+      p->outgoing_ticks = 0;
+      p->outgoing_time = PLAYER_PREFETCH;
+      if (crossing)
+        p->outgoing_time += (float)fade / p->device_rate;
+    } else {
+      UnloadMusicStream(p->music);
+    }
+  }
+
+  p->slot = slot;
+  p->music = next;
+  p->tag = tag;
+  p->has_music = true;
+  p->playing = true;
+  publish_position(p);
+}
+
+/**
+ * @brief Closes the prefetched next music, restoring looping on the current
+ * one
+ */
+static void unprime(Player *p) {
+  if (!p->next_primed)
+    return;
+  if (p->has_music)
+    p->music.looping = p->looping;
+  UnloadMusicStream(p->next);
+  p->next_primed = false;
+}
+
+/**
+ * @brief Forgets the queued next music
+ */
+static void unqueue(Player *p) {
+  unprime(p);
+  p->has_next = false;
+}
+
+static void execute(Player *p, const Player_Command *cmd) {
+  switch (cmd->kind) {
+  case PLAYER_CMD_PLAY: {
+    unqueue(p);
+    drop_outgoing(p);
+
+    Music next;
+    if (!open_music(cmd->path, &next)) {
+      /* Gone or unreadable since it was added: nothing plays */
+      close_current(p);
+      atomic_store_explicit(&p->length_ms, 0, memory_order_relaxed);
+      atomic_store_explicit(&p->active_generation, cmd->generation,
+                            memory_order_release);
+      break;
+    }
+    prime(next);
+    p->looping = next.looping;
+    switch_to(p, next, cmd->tag, false, 0);
+    atomic_store_explicit(&p->active_generation, cmd->generation,
+                          memory_order_release);
+    break;
+  }
+  case PLAYER_CMD_QUEUE:
+    unqueue(p);
+    p->next_path = cmd->path;
+    p->next_tag = cmd->tag;
+    p->has_next = true;
+    break;
+  case PLAYER_CMD_UNQUEUE:
+    unqueue(p);
+    break;
+  case PLAYER_CMD_STOP:
+    unqueue(p);
+    drop_outgoing(p);
+    close_current(p);
+    break;
+  case PLAYER_CMD_PAUSE:
+    if (p->has_music)
+      PauseMusicStream(p->music);
+    if (p->has_outgoing)
+      PauseMusicStream(p->outgoing);
+    p->playing = false;
+    break;
+  case PLAYER_CMD_RESUME:
+    if (p->has_music) {
+      ResumeMusicStream(p->music);
+      if (p->has_outgoing)
+        ResumeMusicStream(p->outgoing);
+      p->playing = true;
+    }
+    break;
+  case PLAYER_CMD_SEEK:
+    if (p->has_music) {
+      /* Seeking back from inside the prefetch window: prime again later */
+      unprime(p);
+      SeekMusicStream(p->music, cmd->value);
+    }
+    break;
+  case PLAYER_CMD_VOLUME:
+    p->volume = cmd->value;
+    if (p->has_music)
+      SetMusicVolume(p->music, p->volume);
+    if (p->has_outgoing)
+      SetMusicVolume(p->outgoing, p->volume);
+    break;
+  case PLAYER_CMD_CROSSFADE:
+    p->crossfade = cmd->value < 0.0f                   ? 0.0f
+                   : cmd->value > PLAYER_MAX_CROSSFADE ? PLAYER_MAX_CROSSFADE
+                                                       : cmd->value;
+    break;
+  }
+}
+
+/**
+ * @brief One refill tick: decode, prefetch and advance at the track end
+ */
+static void feed(Player *p) {
+  if (!p->has_music || !p->playing)
+    return;
+
+  if (p->has_outgoing) {
+    /* Play out the fade or tail of the previous music, then let it go */
+    UpdateMusicStream(p->outgoing);
+    if (!IsMusicStreamPlaying(p->outgoing) ||
+        ++p->outgoing_ticks * PLAYER_PERIOD > p->outgoing_time)
+      drop_outgoing(p);
+  }
+
+  UpdateMusicStream(p->music);
+  float played = GetMusicTimePlayed(p->music);
+  float remaining = GetMusicTimeLength(p->music) - played;
+
+  if (p->has_next) {
+    float lead =
+        p->crossfade > PLAYER_PREFETCH ? p->crossfade : PLAYER_PREFETCH;
+    if (!p->next_primed && remaining <= lead) {
+      /* Open the next music and decode its start ahead of time, and make
+       * the current one stop at its end instead of looping */
+      if (open_music(p->next_path, &p->next)) {
+        prime(p->next);
+        p->music.looping = false;
+        p->next_primed = true;
+      } else {
+        /* Unplayable: the current music keeps looping */
+        p->has_next = false;
+      }
+    }
+    bool crossing = p->crossfade > 0.0f && remaining <= p->crossfade &&
+                    remaining > PLAYER_PERIOD;
+    if (p->next_primed &&
+        (crossing || remaining <= PLAYER_PERIOD / 2 ||
+         !IsMusicStreamPlaying(p->music))) {
+      unsigned fade =
+          crossing ? (unsigned)(remaining * p->device_rate) : 0;
+      p->has_next = false;
+      p->next_primed = false;
+      p->looping = p->next.looping;
+      switch_to(p, p->next, p->next_tag, true, fade);
+      atomic_fetch_add_explicit(&p->advances, 1, memory_order_release);
+      return;
+    }
+  }
+
+  atomic_store_explicit(&p->played_ms, to_ms(played), memory_order_relaxed);
+}
+
+/**
+ * @brief Executes every queued command in order
+ */
+static void drain(Player *p) {
+  unsigned tail = atomic_load_explicit(&p->tail, memory_order_relaxed);
+  unsigned head = atomic_load_explicit(&p->head, memory_order_acquire);
+  while (tail != head) {
+    execute(p, &p->queue[tail & PLAYER_MASK]);
+    tail++;
+    atomic_store_explicit(&p->tail, tail, memory_order_release);
+  }
+}
+
+/**
+ * @brief Asks for realtime scheduling; silently stays normal if not allowed
+ */
+static bool raise_priority(pthread_t thread) {
+  struct sched_param param = {
+      .sched_priority = sched_get_priority_min(SCHED_FIFO),
+  };
+  return pthread_setschedparam(thread, SCHED_FIFO, &param) == 0;
+}
+
+static void timespec_add(struct timespec *t, double seconds) {
+  t->tv_nsec += (long)(seconds * 1e9);
+  while (t->tv_nsec >= 1000000000L) {
+    t->tv_sec += 1;
+    t->tv_nsec -= 1000000000L;
+  }
+}
+
+static bool timespec_before(const struct timespec *a,
+                            const struct timespec *b) {
+  return a->tv_sec < b->tv_sec ||
+         (a->tv_sec == b->tv_sec && a->tv_nsec < b->tv_nsec);
+}
+
+static void *player_thread(void *arg) {
+  Player *p = arg;
+
+  struct timespec next;
+  clock_gettime(CLOCK_REALTIME, &next);
+
+  while (atomic_load_explicit(&p->running, memory_order_acquire)) {
+    drain(p);
+
+    /* Refill on a fixed cadence; commands wake us in between without
+     * shifting the schedule */
+    struct timespec now;
+    clock_gettime(CLOCK_REALTIME, &now);
+    if (!timespec_before(&now, &next)) {
+      feed(p);
+      timespec_add(&next, PLAYER_PERIOD);
+      /* Fell behind (e.g. the process was stopped): restart the clock */
+      if (timespec_before(&next, &now)) {
+        next = now;
+        timespec_add(&next, PLAYER_PERIOD);
+      }
+    }
+
+    while (sem_timedwait(&p->wake, &next) != 0 && errno == EINTR) {
+    }
+  }
+
+  drain(p);
+  return NULL;
+}
+
+/**
+ * @brief Finds out the format raylib mixes in, which is what processors
+ * receive whatever the track's own rate and channels
+ *
+ * raylib has no getter for it, but stores a Sound converted to it.
+ */
+static void probe_device(Player *p) {
+  float silence = 0.0f;
+  Sound probe = LoadSoundFromWave((Wave){.frameCount = 1,
+                                         .sampleRate = PLAYER_DEVICE_RATE,
+                                         .sampleSize = 32,
+                                         .channels = 1,
+                                         .data = &silence});
+  p->device_rate = probe.stream.sampleRate ? probe.stream.sampleRate
+                                           : PLAYER_DEVICE_RATE;
+  p->device_channels =
+      probe.stream.channels ? probe.stream.channels : PLAYER_DEVICE_CHANNELS;
+  UnloadSound(probe);
+}
+
+bool player_start(Player *p, AudioCallback processor,
+                  Player_Switch_Hook *on_switch, void *user) {
+  if (sem_init(&p->wake, 0, 0) != 0)
+    return false;
+
+  probe_device(p);
+  p->processor = processor;
+  p->on_switch = on_switch;
+  p->user = user;
+  tapped = p;
+  if (p->has_music)
+    AttachAudioStreamProcessor(p->music.stream, taps[p->slot]);
+
+  atomic_store(&p->running, true);
+  if (pthread_create(&p->thread, NULL, player_thread, p) != 0) {
+    atomic_store(&p->running, false);
+    sem_destroy(&p->wake);
+    if (p->has_music)
+      DetachAudioStreamProcessor(p->music.stream, taps[p->slot]);
+    return false;
+  }
+  p->realtime = raise_priority(p->thread);
+  return true;
+}
+
+void player_stop(Player *p) {
+  if (!atomic_exchange(&p->running, false))
+    return;
+  sem_post(&p->wake);
+  pthread_join(p->thread, NULL);
+  sem_destroy(&p->wake);
+
+  /* The taps are code of this module, which may be about to be unloaded */
+  drop_outgoing(p);
+  if (p->has_music)
+    DetachAudioStreamProcessor(p->music.stream, taps[p->slot]);
+}
+
+bool player_send(Player *p, Player_Command cmd) {
+  unsigned head = atomic_load_explicit(&p->head, memory_order_relaxed);
+  unsigned tail = atomic_load_explicit(&p->tail, memory_order_acquire);
+  if (head - tail == PLAYER_QUEUE_SIZE)
+    return false;
+
+  p->queue[head & PLAYER_MASK] = cmd;
+  atomic_store_explicit(&p->head, head + 1, memory_order_release);
+  if (atomic_load_explicit(&p->running, memory_order_relaxed))
+    sem_post(&p->wake);
+  return true;
+}
+
+bool player_play(Player *p, const char *path, int tag) {
+  unsigned generation = p->generation + 1;
+  if (!player_send(p, (Player_Command){
+                          .kind = PLAYER_CMD_PLAY,
+                          .path = path,
+                          .tag = tag,
+                          .generation = generation,
+                      }))
+    return false;
+  p->generation = generation;
+  return true;
+}
+
+bool player_position(Player *p, float *played, float *length) {
+  /* Generation 0 means nothing was ever played */
+  if (p->generation == 0 ||
+      atomic_load_explicit(&p->active_generation, memory_order_acquire) !=
+          p->generation)
+    return false;
+  *length =
+      atomic_load_explicit(&p->length_ms, memory_order_relaxed) / 1000.0f;
+  *played =
+      atomic_load_explicit(&p->played_ms, memory_order_relaxed) / 1000.0f;
+  return true;
+}
+
+bool player_advanced(Player *p, unsigned *seen, int *tag) {
+  /* Wait for a pending PLAY, whose tag replaces the advanced one */
+  if (atomic_load_explicit(&p->active_generation, memory_order_acquire) !=
+      p->generation)
+    return false;
+  unsigned advances = atomic_load_explicit(&p->advances, memory_order_acquire);
+  if (advances == *seen)
+    return false;
+  *seen = advances;
+  *tag = atomic_load_explicit(&p->current_tag, memory_order_relaxed);
+  return true;
+}
@@ -0,0 +1,206 @@
+/**
+ * @file player.h
+ * @brief Audio feeder thread owning music decoding and playback control
+ *
+ * raylib music streams must be refilled regularly with UpdateMusicStream().
+ * Doing that from the render loop ties decoding to the frame rate, so a
+ * slow frame starves the stream. The player runs the refill on its own
+ * thread at a fixed cadence (raised to realtime priority when permitted).
+ *
+ * The render thread never touches a Music at all. It sends commands (play,
+ * pause, seek, volume...) naming files by path through a lock-free
+ * single-producer queue and reads back the playback position the feeder
+ * publishes. The feeder opens a stream only when it is about to play it and
+ * closes it when it is done, so at most the current music, the prefetched
+ * next one and, during an advance, the outgoing one are open at a time.
+ *
+ * Track switches happen entirely on the feeder: the next stream is opened,
+ * and its buffer decoded before it starts, the capture processor moves
+ * over, and the old stream is closed right after the new one starts, so
+ * the swap falls within one mixer period and the render thread never
+ * waits.
+ *
+ * For gapless playback the UI queues the music that follows the current
+ * one. PLAYER_PREFETCH seconds before the end the feeder opens it and
+ * turns looping off on the current music; when less than half a refill
+ * period is left it starts the queued music while the old one plays out
+ * its last buffered samples.
+ *
+ * With a crossfade set, the queued music is opened and started that many
+ * seconds before the end instead, and both play with equal-power gains
+ * until the old one ends (see crossfade.h). The capture processor then
+ * receives the sum of both.
+ */
+#ifndef PLAYER_H_
+#define PLAYER_H_
+
+#include <pthread.h>
+#include <raylib.h>
+#include <semaphore.h>
+#include <stdatomic.h>
+#include <stdbool.h>
+
+#include "crossfade.h"
+
+#define PLAYER_QUEUE_SIZE 64       ///< Pending commands (power of two)
+#define PLAYER_PERIOD 0.005        ///< Seconds between two stream refills
+#define PLAYER_PREFETCH 0.3f       ///< Seconds before the end to prime the next
+#define PLAYER_MAX_CROSSFADE 12.0f ///< Longest crossfade in seconds
+#define PLAYER_DEVICE_RATE 48000   ///< Mixing rate assumed if not found out
+#define PLAYER_DEVICE_CHANNELS 2   ///< Channels assumed likewise
+
+/**
+ * @brief Called on the feeder thread during a switch, while no stream has
+ * the capture processor attached
+ *
+ * @param next Stream about to start
+ * @param gapless true for an automatic advance to the queued music
+ */
+typedef void Player_Switch_Hook(void *user, Music next, bool gapless);
+
+/**
+ * @enum Player_Command_Kind
+ * @brief Operations the feeder thread performs on behalf of the UI
+ */
+typedef enum {
+  PLAYER_CMD_PLAY,      ///< Replace the current music with path, from 0
+  PLAYER_CMD_QUEUE,     ///< Continue gaplessly with path after the current
+  PLAYER_CMD_UNQUEUE,   ///< Forget the queued music
+  PLAYER_CMD_STOP,      ///< Stop and close the current music
+  PLAYER_CMD_PAUSE,     ///< Pause the current music
+  PLAYER_CMD_RESUME,    ///< Resume the current music
+  PLAYER_CMD_SEEK,      ///< Seek to value seconds
+  PLAYER_CMD_VOLUME,    ///< Set the music volume to value
+  PLAYER_CMD_CROSSFADE, ///< Crossfade value seconds into queued music
+} Player_Command_Kind;
+
+/**
+ * @struct Player_Command
+ * @brief One queued operation
+ */
+typedef struct {
+  Player_Command_Kind kind;
+  const char *path;    ///< File to play (PLAY, QUEUE), must stay valid
+  int tag;             ///< Caller's id for path, e.g. its playlist index
+  float value;         ///< Seconds (SEEK, CROSSFADE) or volume (VOLUME)
+  unsigned generation; ///< Playback generation started by PLAY
+} Player_Command;
+
+/**
+ * @struct Player
+ * @brief Feeder thread state, embedded in Plug so it survives hot reload
+ */
+typedef struct {
+  /* Command queue: render thread produces, feeder consumes */
+  Player_Command queue[PLAYER_QUEUE_SIZE];
+  atomic_uint head; ///< Next slot the producer writes
+  atomic_uint tail; ///< Next slot the consumer reads
+  sem_t wake;       ///< Posted with every command
+
+  /* Owned by the render thread */
+  unsigned generation; ///< Generation of the last PLAY sent
+
+  /* Set by player_start() (code addresses change across hot reload) */
+  AudioCallback processor;       ///< Receives the audio of whatever plays
+  Player_Switch_Hook *on_switch; ///< Optional switch notification
+  void *user;                    ///< Passed to on_switch
+  unsigned device_rate;          ///< Sample rate the processors receive
+  unsigned device_channels;      ///< Channels the processors receive
+
+  /* Owned by the feeder thread */
+  Music music;     ///< Currently open stream
+  int tag;         ///< Tag of music
+  bool has_music;  ///< Whether music is valid
+  bool playing;    ///< Started and not paused
+  bool looping;    ///< Looping flag music had before a prefetch cleared it
+  float volume;    ///< Volume applied to every started stream
+  float crossfade; ///< Crossfade length in seconds, 0 for gapless
+  unsigned slot;   ///< Crossfade slot of music
+
+  /* Gapless advance, owned by the feeder thread */
+  const char *next_path;   ///< Queued file to continue with
+  int next_tag;            ///< Tag of next_path
+  bool has_next;           ///< Whether next_path is valid
+  bool next_primed;        ///< next is open and decoded ahead
+  Music next;              ///< Stream of next_path once primed
+  Music outgoing;          ///< Previous music playing out after an advance
+  bool has_outgoing;       ///< Whether outgoing is valid
+  unsigned outgoing_ticks; ///< Refills spent on outgoing
+  float outgoing_time;     ///< Seconds outgoing may keep playing
+
+  Crossfade fade; ///< Gains and capture mix, run by the stream processors
+
+  /* Published by the feeder thread */
+  atomic_uint active_generation; ///< Generation the position refers to
+  atomic_uint advances;          ///< Number of gapless advances so far
+  atomic_int current_tag;        ///< Tag of the current music
+  atomic_uint played_ms;         ///< Position in the current music
+  atomic_uint length_ms;         ///< Length of the current music
+
+  pthread_t thread;
+  atomic_bool running;
+  bool realtime; ///< Whether the feeder got realtime scheduling
+} Player;
+
+/**
+ * @brief Starts the feeder thread
+ *
+ * Playback state is kept across player_stop()/player_start(), so a stream
+ * that was playing continues (e.g. across hot reload).
+ *
+ * @param processor Receives the audio of whatever music is playing, mixed
+ *        during a crossfade (may be NULL)
+ * @param on_switch Called for every switch while processor receives
+ *        nothing (may be NULL)
+ * @return false if the thread could not be created
+ */
+bool player_start(Player *p, AudioCallback processor,
+                  Player_Switch_Hook *on_switch, void *user);
+
+/**
+ * @brief Stops and joins the feeder thread
+ *
+ * Queued commands are executed before the thread exits, then the processor
+ * is detached from the current music. A crossfade in progress is cut short.
+ */
+void player_stop(Player *p);
+
+/**
+ * @brief Queues a command (render thread only)
+ *
+ * Never blocks.
+ *
+ * @return false if the queue is full and the command was dropped
+ */
+bool player_send(Player *p, Player_Command cmd);
+
+/**
+ * @brief Starts music from the beginning, replacing the current one
+ *
+ * Clears the gapless queue. If path cannot be opened nothing plays and the
+ * position reports a length of 0.
+ *
+ * @param path Audio file, must stay valid until another PLAY or a STOP has
+ *        been processed
+ * @param tag Reported back by player_advanced() while path is current
+ */
+bool player_play(Player *p, const char *path, int tag);
+
+/**
+ * @brief Reports an automatic advance to the queued music
+ *
+ * @param seen Advance count the caller saw last, updated when true is
+ *        returned
+ * @param tag Output: tag of the music playing now
+ * @return true if playback moved on by itself since *seen
+ */
+bool player_advanced(Player *p, unsigned *seen, int *tag);
+
+/**
+ * @brief Playback position of the music started by the last player_play()
+ *
+ * @return false until the feeder has started that music
+ */
+bool player_position(Player *p, float *played, float *length);
+
+#endif // PLAYER_H_
@@ -0,0 +1,285 @@
+/**
+ * @file playlist.c
+ * @brief Column storage, string arena, sort and shuffle of the playlist
+ */
+#include "playlist.h"
+
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+
+/// Bytes per arena chunk
+#define CHUNK_SIZE ((size_t)1 << PLAYLIST_CHUNK_BITS)
+
+/**
+ * @brief Doubles every column; on failure the ones already grown just stay
+ * larger than needed
+ */
+static bool grow(Playlist *pl) {
+  size_t capacity = pl->capacity ? pl->capacity * 2 : 1024;
+  if (capacity > PLAYLIST_NONE)
+    capacity = PLAYLIST_NONE;
+  if (capacity <= pl->count)
+    return false;
+
+#define GROW_COLUMN(column)                                                    \
+  do {                                                                         \
+    void *grown = realloc(pl->column, capacity * sizeof(*pl->column));         \
+    if (!grown)                                                                \
+      return false;                                                            \
+    pl->column = grown;                                                        \
+  } while (0)
+  GROW_COLUMN(path);
+  GROW_COLUMN(name);
+  GROW_COLUMN(length);
+  GROW_COLUMN(sample_rate);
+  GROW_COLUMN(channels);
+  GROW_COLUMN(flags);
+  GROW_COLUMN(position);
+  GROW_COLUMN(order);
+#undef GROW_COLUMN
+
+  pl->capacity = capacity;
+  return true;
+}
+
+/**
+ * @brief Copies a string into the arena
+ *
+ * @return false if it does not fit or memory ran out
+ */
+static bool arena_store(Playlist *pl, const char *s, size_t len,
+                        uint32_t *offset) {
+  size_t size = len + 1;
+  if (size > CHUNK_SIZE)
+    return false;
+  if (pl->chunk_count == 0 || pl->chunk_used + size > CHUNK_SIZE) {
+    if (pl->chunk_count == PLAYLIST_MAX_CHUNKS)
+      return false;
+    char *chunk = malloc(CHUNK_SIZE);
+    if (!chunk)
+      return false;
+    pl->chunks[pl->chunk_count++] = chunk;
+    pl->chunk_used = 0;
+  }
+  size_t chunk = pl->chunk_count - 1;
+  memcpy(pl->chunks[chunk] + pl->chunk_used, s, size);
+  *offset = (uint32_t)(chunk << PLAYLIST_CHUNK_BITS | pl->chunk_used);
+  pl->chunk_used += size;
+  return true;
+}
+
+uint32_t playlist_append(Playlist *pl, const char *path,
+                         const Track_Info *info) {
+  size_t len = strlen(path);
+  if (len > UINT16_MAX || (pl->count == pl->capacity && !grow(pl)))
+    return PLAYLIST_NONE;
+  uint32_t offset;
+  if (!arena_store(pl, path, len, &offset))
+    return PLAYLIST_NONE;
+
+  const char *slash = strrchr(path, '/');
+  uint32_t id = (uint32_t)pl->count++;
+  pl->path[id] = offset;
+  pl->name[id] = slash ? (uint16_t)(slash - path + 1) : 0;
+  pl->length[id] = info ? info->length : 0.0f;
+  pl->sample_rate[id] = info ? info->sample_rate : 0;
+  pl->channels[id] = info ? (uint8_t)info->channels : 0;
+  pl->flags[id] = info ? PLAYLIST_PROBED : 0;
+  pl->position[id] = id;
+  pl->order[id] = id;
+  return id;
+}
+
+void playlist_set_length(Playlist *pl, uint32_t id, float length) {
+  pl->length[id] = length;
+  pl->flags[id] |= PLAYLIST_TIMED;
+}
+
+const char *playlist_path(const Playlist *pl, uint32_t id) {
+  uint32_t offset = pl->path[id];
+  return pl->chunks[offset >> PLAYLIST_CHUNK_BITS] +
+         (offset & (CHUNK_SIZE - 1));
+}
+
+const char *playlist_name(const Playlist *pl, uint32_t id) {
+  return playlist_path(pl, id) + pl->name[id];
+}
+
+uint32_t playlist_next(const Playlist *pl, uint32_t id) {
+  size_t position = (size_t)pl->position[id] + 1;
+  return position < pl->count ? pl->order[position] : PLAYLIST_NONE;
+}
+
+uint32_t playlist_prev(const Playlist *pl, uint32_t id) {
+  uint32_t position = pl->position[id];
+  return position > 0 ? pl->order[position - 1] : PLAYLIST_NONE;
+}
+
+static void update_positions(Playlist *pl) {
+  for (size_t i = 0; i < pl->count; i++)
+    pl->position[pl->order[i]] = (uint32_t)i;
+}
+
+/**
+ * @struct Sort_Key
+ * @brief Track id with the start of its sort key packed into an integer
+ *
+ * Most comparisons are settled by prefix alone, so sorting mostly streams
+ * through the key array instead of following paths into the arena.
+ */
+typedef struct {
+  uint64_t prefix; ///< First 8 key bytes, big-endian, or the number
+  uint32_t id;
+} Sort_Key;
+
+static uint64_t string_prefix(const char *s, bool fold) {
+  uint64_t prefix = 0;
+  size_t i = 0;
+  for (; i < 8 && s[i]; i++) {
+    unsigned char c = (unsigned char)s[i];
+    if (fold && c >= 'A' && c <= 'Z')
+      c += 'a' - 'A';
+    prefix = prefix << 8 | c;
+  }
+  return prefix << (8 * (8 - i));
+}
+
+static int compare_keys(const Playlist *pl, Playlist_Key key,
+                        const Sort_Key *a, const Sort_Key *b) {
+  if (a->prefix != b->prefix)
+    return a->prefix < b->prefix ? -1 : 1;
+  /* A NUL among the first 8 bytes: both strings already ended */
+  if ((a->prefix & 0xFF) == 0)
+    return 0;
+  switch (key) {
+  case PLAYLIST_BY_NAME:
+    return strcasecmp(playlist_name(pl, a->id) + 8,
+                      playlist_name(pl, b->id) + 8);
+  case PLAYLIST_BY_PATH:
+    return strcmp(playlist_path(pl, a->id) + 8, playlist_path(pl, b->id) + 8);
+  default:
+    return 0;
+  }
+}
+
+/**
+ * @brief Stable bottom-up merge sort of keys, using tmp as scratch
+ *
+ * @return keys or tmp, whichever holds the sorted run
+ */
+static Sort_Key *merge_sort(const Playlist *pl, Playlist_Key key,
+                            Sort_Key *keys, Sort_Key *tmp, size_t n) {
+  for (size_t width = 1; width < n; width *= 2) {
+    for (size_t lo = 0; lo < n; lo += 2 * width) {
+      size_t mid = lo + width < n ? lo + width : n;
+      size_t hi = lo + 2 * width < n ? lo + 2 * width : n;
+      size_t i = lo, j = mid, k = lo;
+      while (i < mid && j < hi)
+        tmp[k++] = compare_keys(pl, key, &keys[j], &keys[i]) < 0 ? keys[j++]
+                                                                 : keys[i++];
+      while (i < mid)
+        tmp[k++] = keys[i++];
+      while (j < hi)
+        tmp[k++] = keys[j++];
+    }
+    Sort_Key *swap = keys;
+    keys = tmp;
+    tmp = swap;
+  }
+  return keys;
+}
+
+void playlist_sort(Playlist *pl, Playlist_Key key) {
+  if (pl->count < 2)
+    return;
+  Sort_Key *keys = malloc(pl->count * sizeof(*keys));
+  Sort_Key *tmp = malloc(pl->count * sizeof(*tmp));
+  if (!keys || !tmp) {
+    free(keys);
+    free(tmp);
+    return;
+  }
+
+  for (size_t i = 0; i < pl->count; i++) {
+    uint32_t id = pl->order[i];
+    uint64_t prefix = id;
+    if (key == PLAYLIST_BY_NAME) {
+      prefix = string_prefix(playlist_name(pl, id), true);
+    } else if (key == PLAYLIST_BY_PATH) {
+      prefix = string_prefix(playlist_path(pl, id), false);
+    } else if (key == PLAYLIST_BY_LENGTH) {
+      /* Non-negative floats order like their bit patterns */
+      uint32_t bits;
+      memcpy(&bits, &pl->length[id], sizeof(bits));
+      prefix = (pl->flags[id] & (PLAYLIST_PROBED | PLAYLIST_TIMED))
+                   ? bits
+                   : UINT64_MAX;
+    }
+    keys[i] = (Sort_Key){.prefix = prefix, .id = id};
+  }
+
+  Sort_Key *sorted = merge_sort(pl, key, keys, tmp, pl->count);
+  for (size_t i = 0; i < pl->count; i++)
+    pl->order[i] = sorted[i].id;
+  update_positions(pl);
+  free(keys);
+  free(tmp);
+}
+
+bool playlist_set_order(Playlist *pl, const uint32_t *order) {
+  /* position doubles as the set of ids seen */
+  for (size_t i = 0; i < pl->count; i++)
+    pl->position[i] = PLAYLIST_NONE;
+  for (size_t i = 0; i < pl->count; i++) {
+    uint32_t id = order[i];
+    if (id >= pl->count || pl->position[id] != PLAYLIST_NONE) {
+      update_positions(pl);
+      return false;
+    }
+    pl->position[id] = (uint32_t)i;
+  }
+  if (pl->count > 0)
+    memcpy(pl->order, order, pl->count * sizeof(*order));
+  return true;
+}
+
+/// splitmix64: a fast generator that is fine for shuffling
+static uint64_t next_random(uint64_t *state) {
+  uint64_t z = (*state += 0x9E3779B97F4A7C15ull);
+  z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ull;
+  z = (z ^ (z >> 27)) * 0x94D049BB133111EBull;
+  return z ^ (z >> 31);
+}
+
+void playlist_shuffle(Playlist *pl, uint32_t first, uint64_t seed) {
+  /* Fisher-Yates over the 4-byte ids only */
+  for (size_t i = pl->count; i > 1; i--) {
+    size_t j = (size_t)(((next_random(&seed) >> 32) * (uint64_t)i) >> 32);
+    uint32_t swap = pl->order[i - 1];
+    pl->order[i - 1] = pl->order[j];
+    pl->order[j] = swap;
+  }
+  update_positions(pl);
+  if (first != PLAYLIST_NONE && first < pl->count) {
+    uint32_t at = pl->position[first];
+    pl->order[at] = pl->order[0];
+    pl->order[0] = first;
+    pl->position[pl->order[at]] = at;
+    pl->position[first] = 0;
+  }
+}
+
+void playlist_free(Playlist *pl) {
+  free(pl->path);
+  free(pl->name);
+  free(pl->length);
+  free(pl->sample_rate);
+  free(pl->channels);
+  free(pl->flags);
+  free(pl->position);
+  free(pl->order);
+  for (size_t i = 0; i < pl->chunk_count; i++)
+    free(pl->chunks[i]);
+  memset(pl, 0, sizeof(*pl));
+}
@@ -0,0 +1,130 @@
+/**
+ * @file playlist.h
+ * @brief Playlist stored as columns, with its paths in one string arena
+ *
+ * Each field of a track is its own array indexed by track id, the order
+ * tracks were added in, so a pass over one field (durations for a sort,
+ * say) reads only that field, contiguously. Paths are appended to a string
+ * arena and named by a 32-bit offset; the arena grows in fixed chunks that
+ * never move, so a path pointer handed to the player stays valid for the
+ * life of the playlist. There is no allocation per track.
+ *
+ * Ids never change. Sorting and shuffling only permute the play order, a
+ * separate array of ids, so everything keyed by track id (search hits,
+ * thumbnails, the player's tags) survives them.
+ */
+#ifndef PLAYLIST_H_
+#define PLAYLIST_H_
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "track_info.h"
+
+#define PLAYLIST_CHUNK_BITS 20   ///< log2 of the arena chunk size (1 MiB)
+#define PLAYLIST_MAX_CHUNKS 4096 ///< 4 GiB of paths: all 32-bit offsets
+#define PLAYLIST_NONE UINT32_MAX ///< No track
+
+/// Playlist::flags bit: length, sample_rate and channels are known
+#define PLAYLIST_PROBED 1u
+/// Playlist::flags bit: length is known without probing (playlist files)
+#define PLAYLIST_TIMED 2u
+
+/**
+ * @enum Playlist_Key
+ * @brief Sort orders
+ */
+typedef enum {
+  PLAYLIST_BY_NAME,   ///< File name, ASCII case-insensitive
+  PLAYLIST_BY_PATH,   ///< Full path, bytewise
+  PLAYLIST_BY_LENGTH, ///< Duration, unknown ones last
+  PLAYLIST_BY_ADDED,  ///< Track id, the order tracks were added in
+} Playlist_Key;
+
+/**
+ * @struct Playlist
+ * @brief Track columns, play order and path arena; embedded in Plug
+ */
+typedef struct {
+  /* Columns, indexed by track id */
+  uint32_t *path;        ///< Arena offset of the path
+  uint16_t *name;        ///< Offset of the file name within the path
+  float *length;         ///< Duration in seconds
+  uint32_t *sample_rate; ///< Sample rate in Hz
+  uint8_t *channels;     ///< Channel count
+  uint8_t *flags;        ///< PLAYLIST_PROBED, PLAYLIST_TIMED
+  uint32_t *position;    ///< Place of the track in order
+  uint32_t *order;       ///< Track ids in play order
+  size_t count;          ///< Number of tracks
+  size_t capacity;       ///< Rows allocated in every column
+
+  /* String arena */
+  char *chunks[PLAYLIST_MAX_CHUNKS]; ///< Never moved once allocated
+  size_t chunk_count;                ///< Chunks allocated
+  size_t chunk_used;                 ///< Bytes used in the last chunk
+} Playlist;
+
+/**
+ * @brief Appends a track at the end of the play order
+ *
+ * @param info What probing found, or NULL if not probed yet
+ * @return Id of the new track, or PLAYLIST_NONE if out of memory
+ */
+uint32_t playlist_append(Playlist *pl, const char *path,
+                         const Track_Info *info);
+
+/**
+ * @brief Records the length of a track that is not probed yet, e.g. the
+ * one a playlist file gives
+ */
+void playlist_set_length(Playlist *pl, uint32_t id, float length);
+
+/**
+ * @brief Path of track id, valid until playlist_free()
+ */
+const char *playlist_path(const Playlist *pl, uint32_t id);
+
+/**
+ * @brief File name part of the path of track id
+ */
+const char *playlist_name(const Playlist *pl, uint32_t id);
+
+/**
+ * @brief Track after id in play order, or PLAYLIST_NONE after the last
+ */
+uint32_t playlist_next(const Playlist *pl, uint32_t id);
+
+/**
+ * @brief Track before id in play order, or PLAYLIST_NONE before the first
+ */
+uint32_t playlist_prev(const Playlist *pl, uint32_t id);
+
+/**
+ * @brief Sorts the play order; ties keep their relative order
+ */
+void playlist_sort(Playlist *pl, Playlist_Key key);
+
+/**
+ * @brief Replaces the play order
+ *
+ * @param order Every track id once, in play order
+ * @return false, leaving the play order as it was, if order is not a
+ *         permutation of the ids
+ */
+bool playlist_set_order(Playlist *pl, const uint32_t *order);
+
+/**
+ * @brief Shuffles the play order
+ *
+ * @param first Track moved to the front (e.g. the one playing), or
+ *        PLAYLIST_NONE
+ */
+void playlist_shuffle(Playlist *pl, uint32_t first, uint64_t seed);
+
+/**
+ * @brief Frees the columns and the arena
+ */
+void playlist_free(Playlist *pl);
+
+#endif // PLAYLIST_H_
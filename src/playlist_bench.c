@@ -0,0 +1,273 @@
+/**
+ * @file playlist_bench.c
+ * @brief Correctness check and cost of the column playlist on 1M tracks
+ *
+ * Fills a playlist (playlist.c) with a million synthetic paths and runs
+ * the operations the queue needs over it: sorting by name and by length,
+ * shuffling, and a substring scan over every file name. The same work is
+ * timed on the layout the playlist replaced, an array of { path pointer,
+ * Track_Info } with one strdup() per path, and the heap used by each is
+ * compared. The check verifies both sort orders, that a shuffle is a
+ * permutation with the requested track in front, and that positions and
+ * paths stay consistent.
+ */
+#include <malloc.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <time.h>
+
+#include "playlist.h"
+
+#define BENCH_TRACKS 1000000
+#define BENCH_PATH_MAX 128
+
+/**
+ * @struct Old_Track
+ * @brief Playlist entry as it was stored before
+ */
+typedef struct {
+  const char *file_name;
+  Track_Info info;
+} Old_Track;
+
+static Old_Track *old_tracks;
+static size_t old_count;
+static size_t old_capacity;
+
+static size_t sink; ///< Keeps the compiler from dropping the work
+
+static double now_seconds(void) {
+  struct timespec t;
+  clock_gettime(CLOCK_MONOTONIC, &t);
+  return t.tv_sec + t.tv_nsec * 1e-9;
+}
+
+/// Bytes currently allocated from the heap
+static size_t heap_used(void) {
+#ifdef __GLIBC__
+  struct mallinfo2 info = mallinfo2();
+  return info.uordblks + info.hblkhd;
+#else
+  return 0;
+#endif
+}
+
+static uint64_t next_random(uint64_t *state) {
+  uint64_t z = (*state += 0x9E3779B97F4A7C15ull);
+  z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ull;
+  z = (z ^ (z >> 27)) * 0x94D049BB133111EBull;
+  return z ^ (z >> 31);
+}
+
+/**
+ * @brief Synthetic track i: a path in an artist/album tree and a length
+ */
+static void make_track(size_t i, char *path, Track_Info *info) {
+  uint64_t state = i;
+  uint64_t r = next_random(&state);
+  snprintf(path, BENCH_PATH_MAX,
+           "/home/user/Music/Artist %03u/Album %02u/%02u - %s Title %zu.flac",
+           (unsigned)(r % 997), (unsigned)(r >> 10) % 20,
+           (unsigned)(r >> 20) % 16 + 1, (r >> 30) & 1 ? "Track" : "song", i);
+  info->length = (float)((r >> 40) % 600000) / 1000.0f;
+  info->sample_rate = 44100;
+  info->channels = 2;
+}
+
+static const char *old_name(const Old_Track *t) {
+  const char *slash = strrchr(t->file_name, '/');
+  return slash ? slash + 1 : t->file_name;
+}
+
+static int compare_old_names(const void *a, const void *b) {
+  return strcasecmp(old_name(a), old_name(b));
+}
+
+static int compare_old_lengths(const void *a, const void *b) {
+  float x = ((const Old_Track *)a)->info.length;
+  float y = ((const Old_Track *)b)->info.length;
+  return (x > y) - (x < y);
+}
+
+static void old_append(const char *path, const Track_Info *info) {
+  if (old_count == old_capacity) {
+    old_capacity = old_capacity ? old_capacity * 2 : 256;
+    old_tracks = realloc(old_tracks, old_capacity * sizeof(*old_tracks));
+  }
+  old_tracks[old_count++] = (Old_Track){strdup(path), *info};
+}
+
+static void old_shuffle(uint64_t seed) {
+  for (size_t i = old_count; i > 1; i--) {
+    size_t j = (size_t)(((next_random(&seed) >> 32) * (uint64_t)i) >> 32);
+    Old_Track swap = old_tracks[i - 1];
+    old_tracks[i - 1] = old_tracks[j];
+    old_tracks[j] = swap;
+  }
+}
+
+static size_t old_scan(const char *needle) {
+  size_t hits = 0;
+  for (size_t i = 0; i < old_count; i++)
+    hits += strstr(old_name(&old_tracks[i]), needle) != NULL;
+  return hits;
+}
+
+/**
+ * @brief Scans file names in id order, i.e. straight through the arena,
+ * whatever the play order
+ */
+static size_t new_scan(const Playlist *pl, const char *needle) {
+  size_t hits = 0;
+  for (uint32_t id = 0; id < pl->count; id++)
+    hits += strstr(playlist_name(pl, id), needle) != NULL;
+  return hits;
+}
+
+/**
+ * @brief order is a permutation, position its inverse
+ */
+static bool check_order(const Playlist *pl) {
+  for (size_t i = 0; i < pl->count; i++)
+    if (pl->order[i] >= pl->count || pl->position[pl->order[i]] != i)
+      return false;
+  uint32_t first = pl->order[0];
+  uint32_t last = pl->order[pl->count - 1];
+  return playlist_prev(pl, first) == PLAYLIST_NONE &&
+         playlist_next(pl, last) == PLAYLIST_NONE &&
+         playlist_next(pl, first) == pl->order[1] &&
+         playlist_prev(pl, pl->order[1]) == first;
+}
+
+static bool check_sorted(const Playlist *pl, Playlist_Key key) {
+  for (size_t i = 1; i < pl->count; i++) {
+    uint32_t a = pl->order[i - 1], b = pl->order[i];
+    int cmp = key == PLAYLIST_BY_NAME
+                  ? strcasecmp(playlist_name(pl, a), playlist_name(pl, b))
+                  : (pl->length[a] > pl->length[b]) -
+                        (pl->length[a] < pl->length[b]);
+    /* Ties must keep the previous order, here the id order */
+    if (cmp > 0 || (cmp == 0 && a > b))
+      return false;
+  }
+  return check_order(pl);
+}
+
+static bool check_paths(const Playlist *pl) {
+  char path[BENCH_PATH_MAX];
+  Track_Info info;
+  for (size_t i = 0; i < pl->count; i += 997) {
+    make_track(i, path, &info);
+    if (strcmp(playlist_path(pl, (uint32_t)i), path) != 0 ||
+        strcmp(playlist_name(pl, (uint32_t)i), strrchr(path, '/') + 1) != 0)
+      return false;
+  }
+  return true;
+}
+
+static void report(const char *what, double old_ms, double new_ms) {
+  printf("  %-18s %10.1f ms %10.1f ms %8.1fx\n", what, old_ms, new_ms,
+         old_ms / new_ms);
+}
+
+int main(void) {
+  char path[BENCH_PATH_MAX];
+  Track_Info info;
+  bool ok = true;
+
+  printf("Playlist of %d tracks, old array of structs vs columns:\n",
+         BENCH_TRACKS);
+  printf("  %-18s %13s %13s %9s\n", "", "old", "new", "speedup");
+
+  size_t heap = heap_used();
+  double start = now_seconds();
+  for (size_t i = 0; i < BENCH_TRACKS; i++) {
+    make_track(i, path, &info);
+    old_append(path, &info);
+  }
+  double old_build = (now_seconds() - start) * 1e3;
+  size_t old_bytes = heap_used() - heap;
+
+  static Playlist pl;
+  heap = heap_used();
+  start = now_seconds();
+  for (size_t i = 0; i < BENCH_TRACKS; i++) {
+    make_track(i, path, &info);
+    playlist_append(&pl, path, &info);
+  }
+  double new_build = (now_seconds() - start) * 1e3;
+  size_t new_bytes = heap_used() - heap;
+  report("build", old_build, new_build);
+  bool paths = check_paths(&pl) && check_order(&pl);
+  ok &= paths;
+
+  start = now_seconds();
+  qsort(old_tracks, old_count, sizeof(*old_tracks), compare_old_names);
+  double old_ms = (now_seconds() - start) * 1e3;
+  start = now_seconds();
+  playlist_sort(&pl, PLAYLIST_BY_NAME);
+  double new_ms = (now_seconds() - start) * 1e3;
+  report("sort by name", old_ms, new_ms);
+  bool by_name = check_sorted(&pl, PLAYLIST_BY_NAME);
+  ok &= by_name;
+
+  playlist_sort(&pl, PLAYLIST_BY_ADDED);
+  bool by_added = true;
+  for (size_t i = 0; i < pl.count; i++)
+    by_added &= pl.order[i] == i;
+  ok &= by_added;
+
+  start = now_seconds();
+  qsort(old_tracks, old_count, sizeof(*old_tracks), compare_old_lengths);
+  old_ms = (now_seconds() - start) * 1e3;
+  start = now_seconds();
+  playlist_sort(&pl, PLAYLIST_BY_LENGTH);
+  new_ms = (now_seconds() - start) * 1e3;
+  report("sort by length", old_ms, new_ms);
+  bool by_length = check_sorted(&pl, PLAYLIST_BY_LENGTH);
+  ok &= by_length;
+
+  start = now_seconds();
+  old_shuffle(42);
+  old_ms = (now_seconds() - start) * 1e3;
+  start = now_seconds();
+  playlist_shuffle(&pl, 12345, 42);
+  new_ms = (now_seconds() - start) * 1e3;
+  report("shuffle", old_ms, new_ms);
+  bool shuffled = pl.order[0] == 12345 && check_order(&pl) && check_paths(&pl);
+  ok &= shuffled;
+
+  /* After the shuffle the old strings are visited in random heap order */
+  start = now_seconds();
+  size_t old_hits = old_scan("Track Title 7");
+  old_ms = (now_seconds() - start) * 1e3;
+  start = now_seconds();
+  size_t new_hits = new_scan(&pl, "Track Title 7");
+  new_ms = (now_seconds() - start) * 1e3;
+  report("scan names", old_ms, new_ms);
+  bool scanned = old_hits == new_hits;
+  ok &= scanned;
+  sink += old_hits;
+
+  if (old_bytes && new_bytes)
+    printf("  %-18s %10.1f MB %10.1f MB %8.1fx less\n", "heap", old_bytes / 1e6,
+           new_bytes / 1e6, (double)old_bytes / new_bytes);
+  printf("  %-18s %10.1f B  %10.1f B\n", "heap per track",
+         (double)old_bytes / BENCH_TRACKS, (double)new_bytes / BENCH_TRACKS);
+
+  printf("\nChecks: paths %s, by name %s, by added %s, by length %s, "
+         "shuffle %s, scan %s\n",
+         paths ? "OK" : "FAIL", by_name ? "OK" : "FAIL",
+         by_added ? "OK" : "FAIL", by_length ? "OK" : "FAIL",
+         shuffled ? "OK" : "FAIL", scanned ? "OK" : "FAIL");
+  printf("  (checksum %zu)\n", sink);
+
+  for (size_t i = 0; i < old_count; i++)
+    free((char *)old_tracks[i].file_name);
+  free(old_tracks);
+  playlist_free(&pl);
+  return ok ? 0 : 1;
+}
@@ -0,0 +1,515 @@
+/**
+ * @file playlist_file.c
+ * @brief In-place parsing of mapped M3U/PLS files, and the saver thread
+ */
+#include "playlist_file.h"
+
+#include <fcntl.h>
+#include <limits.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "fs_util.h"
+
+/**
+ * @struct Reader
+ * @brief Parse state shared by both formats
+ */
+typedef struct {
+  Playlist_File_Sink *sink;
+  void *user;
+  const char *dir;     ///< Directory of the playlist file, no final slash
+  size_t dir_len;      ///< Bytes of dir
+  bool stopped;        ///< The sink asked to stop
+  char path[PATH_MAX]; ///< Entry being resolved
+} Reader;
+
+Playlist_File_Format playlist_file_format(const char *path) {
+  const char *dot = strrchr(path, '.');
+  if (!dot || strchr(dot, '/'))
+    return PLAYLIST_FILE_NONE;
+  if (strcasecmp(dot, ".m3u") == 0 || strcasecmp(dot, ".m3u8") == 0)
+    return PLAYLIST_FILE_M3U;
+  if (strcasecmp(dot, ".pls") == 0)
+    return PLAYLIST_FILE_PLS;
+  return PLAYLIST_FILE_NONE;
+}
+
+static bool is_blank(char c) { return c == ' ' || c == '\t' || c == '\r'; }
+
+/**
+ * @brief Takes the next line of [*at, end), without its line break and
+ * surrounding blanks
+ *
+ * @return false at the end of the file
+ */
+static bool next_line(const char **at, const char *end, const char **line,
+                      size_t *len) {
+  if (*at >= end)
+    return false;
+  const char *start = *at;
+  const char *newline = memchr(start, '\n', (size_t)(end - start));
+  const char *stop = newline ? newline : end;
+  *at = newline ? newline + 1 : end;
+  while (start < stop && is_blank(*start))
+    start++;
+  while (stop > start && is_blank(stop[-1]))
+    stop--;
+  *line = start;
+  *len = (size_t)(stop - start);
+  return true;
+}
+
+/// ASCII case-insensitive prefix test on an unterminated line
+static bool has_prefix(const char *line, size_t len, const char *prefix) {
+  size_t n = strlen(prefix);
+  return len >= n && strncasecmp(line, prefix, n) == 0;
+}
+
+/**
+ * @brief Reads a decimal number such as "-1" or "215.5" at the start of s
+ *
+ * strtof() cannot be used: the mapped text has no terminator.
+ */
+static bool parse_number(const char *s, size_t len, float *value) {
+  size_t i = 0;
+  bool negative = i < len && s[i] == '-';
+  if (negative)
+    i++;
+  double number = 0.0, scale = 1.0;
+  size_t digits = 0;
+  for (; i < len && s[i] >= '0' && s[i] <= '9'; i++, digits++)
+    number = number * 10 + (s[i] - '0');
+  if (i < len && s[i] == '.')
+    for (i++; i < len && s[i] >= '0' && s[i] <= '9'; i++, digits++) {
+      scale /= 10;
+      number += (s[i] - '0') * scale;
+    }
+  if (digits == 0)
+    return false;
+  *value = (float)(negative ? -number : number);
+  return true;
+}
+
+/// "scheme://" in front of an entry
+static bool is_url(const char *entry, size_t len) {
+  size_t i = 0;
+  while (i < len && ((entry[i] >= 'a' && entry[i] <= 'z') ||
+                     (entry[i] >= 'A' && entry[i] <= 'Z')))
+    i++;
+  return i > 0 && len - i >= 3 && memcmp(entry + i, "://", 3) == 0;
+}
+
+static int hex_digit(char c) {
+  if (c >= '0' && c <= '9')
+    return c - '0';
+  if (c >= 'a' && c <= 'f')
+    return c - 'a' + 10;
+  if (c >= 'A' && c <= 'F')
+    return c - 'A' + 10;
+  return -1;
+}
+
+/**
+ * @brief Decodes the %XX escapes of a file:// URI path into out
+ */
+static bool decode_uri(char *out, size_t size, const char *s, size_t len) {
+  size_t n = 0;
+  for (size_t i = 0; i < len; i++) {
+    char c = s[i];
+    if (c == '%' && i + 2 < len && hex_digit(s[i + 1]) >= 0 &&
+        hex_digit(s[i + 2]) >= 0) {
+      c = (char)(hex_digit(s[i + 1]) << 4 | hex_digit(s[i + 2]));
+      i += 2;
+    }
+    if (c == '\0' || n + 1 >= size)
+      return false;
+    out[n++] = c;
+  }
+  out[n] = '\0';
+  return true;
+}
+
+/**
+ * @brief Turns an entry into a path in r->path
+ *
+ * @return false for entries that are not local files, or too long
+ */
+static bool resolve(Reader *r, const char *entry, size_t len) {
+  if (has_prefix(entry, len, "file://")) {
+    entry += 7;
+    len -= 7;
+    if (has_prefix(entry, len, "localhost")) {
+      entry += 9;
+      len -= 9;
+    }
+    return len > 0 && entry[0] == '/' &&
+           decode_uri(r->path, sizeof(r->path), entry, len);
+  }
+  if (is_url(entry, len))
+    return false;
+
+  size_t at = 0;
+  if (entry[0] != '/') {
+    while (len > 2 && entry[0] == '.' && entry[1] == '/') {
+      entry += 2;
+      len -= 2;
+    }
+    if (r->dir_len + 1 >= sizeof(r->path))
+      return false;
+    memcpy(r->path, r->dir, r->dir_len);
+    at = r->dir_len;
+    r->path[at++] = '/';
+  }
+  if (at + len >= sizeof(r->path) || memchr(entry, '\0', len))
+    return false;
+  memcpy(r->path + at, entry, len);
+  r->path[at + len] = '\0';
+  return true;
+}
+
+static void emit(Reader *r, float length) {
+  if (!r->sink(r->user, r->path, length))
+    r->stopped = true;
+}
+
+/**
+ * @brief Every line that is neither blank nor a comment is an entry; an
+ * #EXTINF:length,title line gives the length of the entry after it
+ */
+static void read_m3u(Reader *r, const char *at, const char *end) {
+  const char *line;
+  size_t len;
+  float length = -1.0f;
+  while (!r->stopped && next_line(&at, end, &line, &len)) {
+    if (len == 0)
+      continue;
+    if (line[0] == '#') {
+      if (has_prefix(line, len, "#EXTINF:") &&
+          !parse_number(line + 8, len - 8, &length))
+        length = -1.0f;
+      continue;
+    }
+    if (resolve(r, line, len))
+      emit(r, length);
+    length = -1.0f;
+  }
+}
+
+/**
+ * @brief Splits a "KeyN=value" line of a PLS file
+ */
+static bool pls_field(const char *line, size_t len, const char *key,
+                      unsigned long *number, const char **value,
+                      size_t *value_len) {
+  if (!has_prefix(line, len, key))
+    return false;
+  size_t i = strlen(key);
+  *number = 0;
+  size_t digits = 0;
+  for (; i < len && line[i] >= '0' && line[i] <= '9'; i++, digits++)
+    *number = *number * 10 + (unsigned long)(line[i] - '0');
+  if (digits == 0 || i == len || line[i] != '=')
+    return false;
+  *value = line + i + 1;
+  *value_len = len - i - 1;
+  return true;
+}
+
+/**
+ * @brief Streams FileN= entries; each is held back until the next one so
+ * that the LengthN= written after it can be attached
+ */
+static void read_pls(Reader *r, const char *at, const char *end) {
+  const char *line, *value;
+  size_t len, value_len;
+  unsigned long number, pending_number = 0;
+  bool pending = false;
+  float pending_length = -1.0f;
+  while (!r->stopped && next_line(&at, end, &line, &len)) {
+    if (pls_field(line, len, "File", &number, &value, &value_len)) {
+      if (pending)
+        emit(r, pending_length);
+      pending =
+          !r->stopped && value_len > 0 && resolve(r, value, value_len);
+      pending_number = number;
+      pending_length = -1.0f;
+    } else if (pls_field(line, len, "Length", &number, &value,
+                         &value_len)) {
+      float length;
+      if (pending && number == pending_number &&
+          parse_number(value, value_len, &length))
+        pending_length = length;
+    }
+  }
+  if (pending && !r->stopped)
+    emit(r, pending_length);
+}
+
+bool playlist_file_read(const char *file, Playlist_File_Sink *sink,
+                        void *user) {
+  int fd = open(file, O_RDONLY | O_CLOEXEC);
+  if (fd < 0)
+    return false;
+  struct stat st;
+  if (fstat(fd, &st) != 0 || !S_ISREG(st.st_mode)) {
+    close(fd);
+    return false;
+  }
+  if (st.st_size == 0) {
+    close(fd);
+    return true;
+  }
+  size_t size = (size_t)st.st_size;
+  void *map = mmap(NULL, size, PROT_READ, MAP_PRIVATE, fd, 0);
+  close(fd);
+  if (map == MAP_FAILED)
+    return false;
+  madvise(map, size, MADV_SEQUENTIAL);
+
+  Reader r = {.sink = sink, .user = user};
+  const char *slash = strrchr(file, '/');
+  r.dir = slash ? file : ".";
+  r.dir_len = slash ? (size_t)(slash - file) : 1;
+
+  const char *at = map, *end = at + size;
+  if (size >= 3 && memcmp(at, "\xEF\xBB\xBF", 3) == 0)
+    at += 3;
+  /* A .pls saved under another name still starts with its section */
+  const char *peek = at, *line;
+  size_t len;
+  bool pls = playlist_file_format(file) == PLAYLIST_FILE_PLS ||
+             (next_line(&peek, end, &line, &len) && len == 10 &&
+              strncasecmp(line, "[playlist]", len) == 0);
+  if (pls)
+    read_pls(&r, at, end);
+  else
+    read_m3u(&r, at, end);
+
+  munmap(map, size);
+  return true;
+}
+
+/// Length to write: whole seconds, or -1 if unknown
+static long entry_length(const Playlist *pl, uint32_t id) {
+  if (!(pl->flags[id] & (PLAYLIST_PROBED | PLAYLIST_TIMED)))
+    return -1;
+  return (long)(pl->length[id] + 0.5f);
+}
+
+/// File name without its extension, as the title of an entry
+static size_t title_length(const char *name) {
+  const char *dot = strrchr(name, '.');
+  return dot && dot != name ? (size_t)(dot - name) : strlen(name);
+}
+
+/**
+ * @struct Text
+ * @brief Playlist file being built
+ */
+typedef struct {
+  char *data;
+  size_t size;
+  size_t capacity;
+  bool failed;
+} Text;
+
+static void append(Text *t, const char *s, size_t len) {
+  if (t->failed)
+    return;
+  if (t->size + len > t->capacity) {
+    size_t grown = t->capacity ? t->capacity * 2 : 1 << 16;
+    while (grown < t->size + len)
+      grown *= 2;
+    char *data = realloc(t->data, grown);
+    if (!data) {
+      t->failed = true;
+      return;
+    }
+    t->data = data;
+    t->capacity = grown;
+  }
+  memcpy(&t->data[t->size], s, len);
+  t->size += len;
+}
+
+static void append_string(Text *t, const char *s) { append(t, s, strlen(s)); }
+
+/// Decimal digits of n; with printf() a build took twice as long
+static void append_number(Text *t, long n) {
+  char digits[24];
+  char *at = digits + sizeof(digits);
+  unsigned long u = n < 0 ? 0ul - (unsigned long)n : (unsigned long)n;
+  do
+    *--at = (char)('0' + u % 10);
+  while (u /= 10);
+  if (n < 0)
+    *--at = '-';
+  append(t, at, (size_t)(digits + sizeof(digits) - at));
+}
+
+char *playlist_file_build(const Playlist *pl, Playlist_File_Format format,
+                          size_t *size) {
+  bool pls = format == PLAYLIST_FILE_PLS;
+  Text t = {0};
+  append_string(&t, pls ? "[playlist]\n" : "#EXTM3U\n");
+  long number = 0;
+  for (size_t i = 0; i < pl->count; i++) {
+    uint32_t id = pl->order[i];
+    const char *path = playlist_path(pl, id);
+    /* Neither format can hold a line break in a path */
+    if (strpbrk(path, "\r\n"))
+      continue;
+    const char *name = playlist_name(pl, id);
+    long length = entry_length(pl, id);
+    size_t title = title_length(name);
+    number++;
+    if (pls) {
+      append_string(&t, "File");
+      append_number(&t, number);
+      append_string(&t, "=");
+      append_string(&t, path);
+      append_string(&t, "\nTitle");
+      append_number(&t, number);
+      append_string(&t, "=");
+      append(&t, name, title);
+      append_string(&t, "\nLength");
+      append_number(&t, number);
+      append_string(&t, "=");
+      append_number(&t, length);
+      append_string(&t, "\n");
+    } else {
+      append_string(&t, "#EXTINF:");
+      append_number(&t, length);
+      append_string(&t, ",");
+      append(&t, name, title);
+      append_string(&t, "\n");
+      append_string(&t, path);
+      append_string(&t, "\n");
+    }
+  }
+  if (pls) {
+    append_string(&t, "NumberOfEntries=");
+    append_number(&t, number);
+    append_string(&t, "\nVersion=2\n");
+  }
+  if (t.failed) {
+    free(t.data);
+    return NULL;
+  }
+  *size = t.size;
+  return t.data;
+}
+
+static bool write_save(const Playlist_Save *save) {
+  if (fs_write_buffer(save->file, save->text, save->size, true))
+    return true;
+  fprintf(stderr, "WARNING: could not save playlist %s\n", save->file);
+  return false;
+}
+
+static void free_save(Playlist_Save *save) {
+  free(save->file);
+  free(save->text);
+  free(save);
+}
+
+/**
+ * @brief Writes saves as they are submitted; on stop, writes the ones
+ * still queued before returning
+ */
+static void *saver_thread(void *arg) {
+  Playlist_Saver *s = arg;
+  pthread_mutex_lock(&s->lock);
+  for (;;) {
+    while (s->running && !s->first)
+      pthread_cond_wait(&s->wake, &s->lock);
+    Playlist_Save *save = s->first;
+    if (!save)
+      break;
+    s->first = save->next;
+    if (!s->first)
+      s->last = NULL;
+    pthread_mutex_unlock(&s->lock);
+
+    write_save(save);
+    free_save(save);
+
+    pthread_mutex_lock(&s->lock);
+  }
+  pthread_mutex_unlock(&s->lock);
+  return NULL;
+}
+
+bool playlist_saver_start(Playlist_Saver *s) {
+  if (!s->initialized) {
+    if (pthread_mutex_init(&s->lock, NULL) != 0)
+      return false;
+    if (pthread_cond_init(&s->wake, NULL) != 0) {
+      pthread_mutex_destroy(&s->lock);
+      return false;
+    }
+    s->initialized = true;
+  }
+  if (s->started)
+    return true;
+  s->running = true;
+  if (pthread_create(&s->thread, NULL, saver_thread, s) != 0) {
+    s->running = false;
+    return false;
+  }
+  s->started = true;
+  return true;
+}
+
+bool playlist_saver_submit(Playlist_Saver *s, const char *file, char *text,
+                           size_t size) {
+  Playlist_Save *save = malloc(sizeof(*save));
+  char *copy = strdup(file);
+  if (!save || !copy) {
+    free(save);
+    free(copy);
+    free(text);
+    return false;
+  }
+  *save = (Playlist_Save){.file = copy, .text = text, .size = size};
+  if (!s->started) {
+    bool ok = write_save(save);
+    free_save(save);
+    return ok;
+  }
+  pthread_mutex_lock(&s->lock);
+  if (s->last)
+    s->last->next = save;
+  else
+    s->first = save;
+  s->last = save;
+  pthread_cond_signal(&s->wake);
+  pthread_mutex_unlock(&s->lock);
+  return true;
+}
+
+void playlist_saver_stop(Playlist_Saver *s) {
+  if (!s->started)
+    return;
+  pthread_mutex_lock(&s->lock);
+  s->running = false;
+  pthread_cond_signal(&s->wake);
+  pthread_mutex_unlock(&s->lock);
+  pthread_join(s->thread, NULL);
+  s->started = false;
+}
+
+void playlist_saver_free(Playlist_Saver *s) {
+  if (!s->initialized)
+    return;
+  playlist_saver_stop(s);
+  pthread_cond_destroy(&s->wake);
+  pthread_mutex_destroy(&s->lock);
+  memset(s, 0, sizeof(*s));
+}
@@ -0,0 +1,126 @@
+/**
+ * @file playlist_file.h
+ * @brief M3U/M3U8 and PLS playlist files: streaming load, atomic save
+ *
+ * A playlist file is memory-mapped and parsed in place, line by line, and
+ * each entry is handed to a sink as soon as it is read: nothing is opened
+ * or decoded, so a 100k-line file loads in milliseconds and the tracks are
+ * probed later, when played. Relative entries are resolved against the
+ * directory of the playlist file, file:// URIs are decoded and other URLs
+ * (streams, which the player cannot open) are skipped.
+ *
+ * Saving is split in two. The text of the file is built in memory on the
+ * caller's thread, which takes a few milliseconds even for 100k tracks.
+ * A saver thread then writes it to a temporary file next to the target,
+ * syncs it and renames it over the target, so the sync does not stall a
+ * frame and a crash leaves either the old file or the new one.
+ */
+#ifndef PLAYLIST_FILE_H_
+#define PLAYLIST_FILE_H_
+
+#include <pthread.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+#include "playlist.h"
+
+/**
+ * @enum Playlist_File_Format
+ * @brief Formats, told apart by extension
+ */
+typedef enum {
+  PLAYLIST_FILE_NONE, ///< Not a playlist file
+  PLAYLIST_FILE_M3U,  ///< .m3u or .m3u8, plain or extended (#EXTINF)
+  PLAYLIST_FILE_PLS,  ///< .pls ([playlist], FileN=, LengthN=)
+} Playlist_File_Format;
+
+/**
+ * @brief Receives one entry of a playlist file
+ *
+ * @param path Resolved path, valid only during the call
+ * @param length Duration in seconds from the file, or negative if unknown
+ * @return false to stop reading
+ */
+typedef bool Playlist_File_Sink(void *user, const char *path, float length);
+
+/**
+ * @struct Playlist_Save
+ * @brief A playlist file waiting to be written
+ */
+typedef struct Playlist_Save {
+  struct Playlist_Save *next; ///< Submitted after this one
+  char *file;                 ///< Target path, owned
+  char *text;                 ///< Contents, owned
+  size_t size;                ///< Bytes of text
+} Playlist_Save;
+
+/**
+ * @struct Playlist_Saver
+ * @brief Thread writing saved playlist files
+ *
+ * Embedded in Plug so it survives hot reload.
+ */
+typedef struct {
+  pthread_mutex_t lock;
+  pthread_cond_t wake; ///< Signalled on a new save and shutdown
+  bool initialized;    ///< lock and wake exist
+  bool running;        ///< Cleared to stop the thread
+  bool started;        ///< thread exists
+
+  Playlist_Save *first; ///< Oldest save not written yet
+  Playlist_Save *last;  ///< Newest save, where the next one is linked
+  pthread_t thread;
+} Playlist_Saver;
+
+/**
+ * @brief Format of path, from its extension
+ */
+Playlist_File_Format playlist_file_format(const char *path);
+
+/**
+ * @brief Streams the entries of a playlist file to sink, in file order
+ *
+ * @return false if the file could not be read
+ */
+bool playlist_file_read(const char *file, Playlist_File_Sink *sink,
+                        void *user);
+
+/**
+ * @brief Builds the text of a playlist file holding pl in play order
+ *
+ * Builds PLS for PLAYLIST_FILE_PLS, extended M3U otherwise; paths are
+ * written as stored, in UTF-8.
+ *
+ * @param size Output: bytes of the text
+ * @return The text in a new heap buffer, or NULL if memory ran out
+ */
+char *playlist_file_build(const Playlist *pl, Playlist_File_Format format,
+                          size_t *size);
+
+/**
+ * @brief Starts the saver thread
+ */
+bool playlist_saver_start(Playlist_Saver *s);
+
+/**
+ * @brief Queues text from playlist_file_build() to be written to file
+ *
+ * Takes ownership of text. Saves are written in the order submitted; if
+ * the thread is not running the file is written before returning.
+ *
+ * @return false if the save could not be queued or written
+ */
+bool playlist_saver_submit(Playlist_Saver *s, const char *file, char *text,
+                           size_t size);
+
+/**
+ * @brief Writes the saves still queued and joins the thread
+ */
+void playlist_saver_stop(Playlist_Saver *s);
+
+/**
+ * @brief Stops the saver and frees it
+ */
+void playlist_saver_free(Playlist_Saver *s);
+
+#endif // PLAYLIST_FILE_H_
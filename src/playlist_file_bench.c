@@ -0,0 +1,191 @@
+/**
+ * @file playlist_file_bench.c
+ * @brief Correctness check and load time of M3U/PLS playlist files
+ *
+ * Writes a 100,000-entry extended M3U file in a temporary directory, with
+ * the things real files contain: a byte order mark, CRLF line ends,
+ * comments, relative entries, file:// URIs with escapes and stream URLs
+ * that must be skipped. It is then loaded into a playlist (playlist.c)
+ * through playlist_file.c the way the queue loads it, and the load is
+ * timed. The check compares every entry and length with what was written,
+ * then saves the playlist as M3U and as PLS the way the queue does (text
+ * built on the calling thread, written by the saver thread), timing the
+ * build, and verifies that reading each back gives the same playlist.
+ */
+#include <limits.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "playlist_file.h"
+
+#define BENCH_ENTRIES 100000
+#define BENCH_LOADS 20 ///< Loads timed; the fastest is reported
+#define BENCH_PATH_MAX 160
+
+static char dir[] = "/tmp/playlist_file_bench.XXXXXX";
+
+static double now_seconds(void) {
+  struct timespec t;
+  clock_gettime(CLOCK_MONOTONIC, &t);
+  return t.tv_sec + t.tv_nsec * 1e-9;
+}
+
+/**
+ * @brief Entry i: the path it resolves to and its length in whole seconds
+ */
+static void expected_entry(size_t i, char *path, int *length) {
+  snprintf(path, BENCH_PATH_MAX, "%s%s/Artist %03zu/%02zu - Song %zu.flac",
+           i % 4 == 0 ? "" : dir, i % 4 == 0 ? "/srv/music" : "",
+           i % 997, i % 16 + 1, i);
+  *length = (int)(i * 7919 % 600);
+}
+
+static bool write_source(const char *file) {
+  FILE *f = fopen(file, "w");
+  if (!f)
+    return false;
+  fputs("\xEF\xBB\xBF#EXTM3U\n", f);
+  for (size_t i = 0; i < BENCH_ENTRIES; i++) {
+    const char *eol = i % 3 == 0 ? "\r\n" : "\n";
+    char path[BENCH_PATH_MAX];
+    int length;
+    expected_entry(i, path, &length);
+    fprintf(f, "#EXTINF:%d,Artist %03zu - Song %zu%s", length, i % 997, i,
+            eol);
+    if (i % 4 == 0) /* Absolute */
+      fprintf(f, "%s%s", path, eol);
+    else if (i % 4 == 1) /* Relative */
+      fprintf(f, "./Artist %03zu/%02zu - Song %zu.flac%s", i % 997,
+              i % 16 + 1, i, eol);
+    else if (i % 4 == 2) /* URI; %20 is a space */
+      fprintf(f, "file://%s/Artist%%20%03zu/%02zu%%20-%%20Song%%20%zu.flac%s",
+              dir, i % 997, i % 16 + 1, i, eol);
+    else
+      fprintf(f, "  Artist %03zu/%02zu - Song %zu.flac  %s", i % 997,
+              i % 16 + 1, i, eol);
+    if (i % 1000 == 0) /* A stream and a comment, both skipped */
+      fprintf(f, "# comment\n#EXTINF:-1,Radio\nhttp://radio.example/x\n\n");
+  }
+  return fclose(f) == 0;
+}
+
+static bool append_entry(void *user, const char *path, float length) {
+  Playlist *pl = user;
+  uint32_t id = playlist_append(pl, path, NULL);
+  if (id == PLAYLIST_NONE)
+    return false;
+  if (length >= 0.0f)
+    playlist_set_length(pl, id, length);
+  return true;
+}
+
+static bool load(const char *file, Playlist *pl) {
+  playlist_free(pl);
+  return playlist_file_read(file, append_entry, pl);
+}
+
+static bool check_loaded(const Playlist *pl) {
+  if (pl->count != BENCH_ENTRIES)
+    return false;
+  for (size_t i = 0; i < pl->count; i++) {
+    char path[BENCH_PATH_MAX];
+    int length;
+    expected_entry(i, path, &length);
+    if (strcmp(playlist_path(pl, (uint32_t)i), path) != 0 ||
+        !(pl->flags[i] & PLAYLIST_TIMED) || pl->length[i] != length)
+      return false;
+  }
+  return true;
+}
+
+/**
+ * @brief Same paths and lengths in the same play order
+ */
+static bool same_playlist(const Playlist *a, const Playlist *b) {
+  if (a->count != b->count)
+    return false;
+  for (size_t i = 0; i < a->count; i++) {
+    uint32_t x = a->order[i], y = b->order[i];
+    if (strcmp(playlist_path(a, x), playlist_path(b, y)) != 0 ||
+        a->length[x] != b->length[y])
+      return false;
+  }
+  return true;
+}
+
+/**
+ * @brief Saves pl in the format of file's extension and reads it back
+ *
+ * @param build_ms Output: time spent building the text, the part that
+ *        runs on the render thread
+ */
+static bool round_trip(const Playlist *pl, const char *file,
+                       double *build_ms) {
+  static Playlist copy;
+  Playlist_Saver saver = {0};
+  bool saved = playlist_saver_start(&saver);
+  double start = now_seconds();
+  size_t size;
+  char *text = playlist_file_build(pl, playlist_file_format(file), &size);
+  *build_ms = (now_seconds() - start) * 1e3;
+  saved = saved && text && playlist_saver_submit(&saver, file, text, size);
+  if (!saved)
+    free(text);
+  /* Returns once the file is written */
+  playlist_saver_free(&saver);
+  bool ok = saved && load(file, &copy) && same_playlist(pl, &copy);
+  playlist_free(&copy);
+  unlink(file);
+  return ok;
+}
+
+int main(void) {
+  if (!mkdtemp(dir)) {
+    perror("mkdtemp");
+    return 1;
+  }
+  char source[PATH_MAX], m3u[PATH_MAX], pls[PATH_MAX];
+  snprintf(source, sizeof(source), "%s/source.m3u8", dir);
+  snprintf(m3u, sizeof(m3u), "%s/saved.m3u8", dir);
+  snprintf(pls, sizeof(pls), "%s/saved.pls", dir);
+  if (!write_source(source)) {
+    fprintf(stderr, "could not write %s\n", source);
+    return 1;
+  }
+
+  static Playlist pl;
+  double best = 1e9;
+  bool read = true;
+  for (int k = 0; k < BENCH_LOADS; k++) {
+    double start = now_seconds();
+    read &= load(source, &pl);
+    double ms = (now_seconds() - start) * 1e3;
+    if (ms < best)
+      best = ms;
+  }
+  bool loaded = read && check_loaded(&pl);
+
+  /* Save in a shuffled order, so the round trip checks the order too */
+  playlist_shuffle(&pl, PLAYLIST_NONE, 42);
+  double m3u_ms, pls_ms;
+  bool m3u_ok = round_trip(&pl, m3u, &m3u_ms);
+  bool pls_ok = round_trip(&pl, pls, &pls_ms);
+
+  printf("Playlist file of %d entries:\n", BENCH_ENTRIES);
+  printf("  %-14s %8.1f ms  (%.0f entries/s)\n", "load", best,
+         BENCH_ENTRIES / best * 1e3);
+  printf("  %-14s %8.1f ms\n", "build M3U", m3u_ms);
+  printf("  %-14s %8.1f ms\n", "build PLS", pls_ms);
+  printf("\nChecks: load %s, M3U round trip %s, PLS round trip %s\n",
+         loaded ? "OK" : "FAIL", m3u_ok ? "OK" : "FAIL",
+         pls_ok ? "OK" : "FAIL");
+
+  playlist_free(&pl);
+  unlink(source);
+  rmdir(dir);
+  return loaded && m3u_ok && pls_ok ? 0 : 1;
+}
@@ -21,40 +21,33 @@
 #include <time.h>
 #include <unistd.h>
 
-#include "tinyfiledialogs.h"
+#include "analyzer.h"
+#include "dir_model.h"
+#include "fft_engine.h"
+#include "importer.h"
+#include "library.h"
+#include "file_dialog.h"
+#include "meta.h"
+#include "player.h"
+#include "playlist.h"
+#include "playlist_file.h"
+#include "queue_view.h"
+#include "search.h"
+#include "session.h"
 #define NOB_IMPLEMENTATION
 #define NOB_STRIP_PREFIX
 #include "../thirdparty/nob.h"
 
 /* Configuration constants */
 #define DURATION_BAR 2.0f          ///< Duration for bar animation transitions
-#define N (1 << 13)                ///< FFT sample size (8192 samples)
-#define BARS 72                    ///< Number of frequency bars to display
 #define FONT_SIZE 64               ///< Base font size for UI text
-#define PI 3.14159265358979323846f ///< Pi constant for FFT calculations
+#define CROSSFADE_KEY_STEP 2.0f    ///< Seconds added per press of X
+#define QUEUE_FONT_SIZE 24.0f      ///< Text size of the queue rows
+#define SESSION_SAVE_INTERVAL 30.0 ///< Seconds between session snapshots
 
 #define GLSL_VERSION 330
 /* Global audio settings */
 
-/**
- * @struct Track
- * @brief Represents a single audio track with its file path and music stream
- */
-typedef struct {
-  const char *file_name; ///< Path to the audio file
-  Music music;           ///< Raylib music stream handle
-} Track;
-
-/**
- * @struct Tracks
- * @brief Dynamic array of tracks (playlist)
- */
-typedef struct {
-  Track *items;    ///< Array of track items
-  size_t count;    ///< Current number of tracks
-  size_t capacity; ///< Allocated capacity
-} Tracks;
-
 /**
  * @enum Ui_Icon
  * @brief Enumeration of UI icon types
@@ -77,20 +70,42 @@ typedef struct {
   float value;      ///< Current slider value (0.0 to 1.0)
 } VolumeSlider;
 
+/**
+ * @enum Bar_Quad_Kind
+ * @brief Primitives of the bar renderer, told apart by bars.fs
+ */
+typedef enum {
+  BAR_QUAD_LINE,  ///< Solid bar body
+  BAR_QUAD_SMEAR, ///< Soft glow stretched between smear and bar height
+  BAR_QUAD_TIP,   ///< Glowing circle at the top of the bar
+  COUNT_BAR_QUAD_KINDS,
+} Bar_Quad_Kind;
+
+/**
+ * @struct Bar_Quad
+ * @brief One textured rectangle of the bar batch
+ */
+typedef struct {
+  Rectangle rec; ///< Screen rectangle
+  float v0, v1;  ///< Vertical texture range (smears use half the glow)
+  Color color;
+} Bar_Quad;
+
+#define MAX_BAR_QUADS (ANALYZER_MAX_CHANNELS * ANALYZER_MAX_BARS)
+
 /**
  * @struct Plug
  * @brief Main plugin state containing all application data
  */
 typedef struct {
-  Font font;         ///< Font for UI text rendering
-  Tracks tracks;     ///< Playlist of audio tracks
-  int current_track; ///< Index of currently playing track
+  Font font;                ///< Font for UI text rendering
+  Playlist playlist;        ///< Tracks and their play order (playlist.h)
+  int current_track;        ///< Id of the track playing (with has_music)
+  Playlist_Key queue_order; ///< Last sort picked with A
   Texture2D icons_textures[COUNT_UI_ICONS]; ///< Loaded UI icon textures
 
   // Shaders
-  Shader circle;
-  float circle_radius_location;
-  float circle_power_location;
+  Shader bars_shader; ///< Draws bar lines, smears and tips in one batch
 
   bool error;      ///< Error state flag
   bool has_music;  ///< Whether any music is loaded
@@ -100,38 +115,58 @@ typedef struct {
   double last_mouse_move_time; ///< Timestamp of last mouse movement
   bool mouse_active;           ///< Whether mouse is recently active
 
-  float queue_scroll; ///< Queue panel scroll offset
+  double queue_scroll;         ///< Queue panel scroll offset
+  Queue_Metrics queue_metrics; ///< Text widths of the queue rows
 
   // Volume config
   VolumeSlider volume_slider; ///< Volume slider state
   double master_vol;          ///< Master volume level (0.0 to 1.0)
   double volume_saved;        ///< Saved volume for mute/unmute toggle
+  float crossfade;            ///< Crossfade between tracks in seconds
   int volume_level; ///< Volume level indicator (0-2: muted, low, high)
 
   // Browser config
   bool show_browser;      ///< Flag para mostrar/ocultar el explorador interno
-  FilePathList dir_files; ///< Lista de archivos en el directorio actual
+  Dir_Model browser;      ///< Listado del directorio actual, hecho aparte
   char current_dir[512];
   int browser_scroll;
+  char playlist_file[512]; ///< Playlist file last loaded or saved
 
   Rectangle ui_recs[COUNT_UI_ICONS]; ///< Collision rectangles for UI buttons
                                      ///< Global plugin instance
 
-  /* Audio processing buffers */
-  unsigned sample_rate; ///< Current track sample rate
-  float samples[N];
-  atomic_uint sample_write;
-  float window[N];           ///< Hann window for FFT
-  float complex spectrum[N]; ///< FFT output spectrum
-  float smear[BARS];         ///< Smear effect buffer for motion blur
-  float bars[BARS];          ///< Smoothed bar heights for visualization
-  bool window_ready;         ///< Whether Hann window is initialized
-
-  float bass_history;  ///< Persistent low-frequency energy state
-  float overall_level; ///< Persistent overall volume level for dynamic scaling
-
-  float stabilization_timer;
-  bool is_stabilizing;
+  Importer importer; ///< Probes dropped files and folders in the background
+  File_Dialog file_dialog; ///< Native open dialog running on its own thread
+  Library library;         ///< Index of the music roots, kept current
+  Meta meta;               ///< Queue labels and cover thumbnails
+  Session session;         ///< Writes the session snapshot (session.h)
+  double session_saved_at; ///< GetTime() of the last snapshot
+  Playlist_Saver saver;    ///< Writes the playlist files saved
+
+  /* Search box */
+  Search search;                           ///< Trigram indexes, built aside
+  bool search_open;                        ///< The box has the keyboard
+  char search_text[SEARCH_QUERY_MAX];      ///< Query typed so far
+  Search_Source search_source;             ///< Library or queue
+  Search_Hit search_hits[SEARCH_MAX_HITS]; ///< Best first
+  size_t search_hit_count;                 ///< Hits for search_text
+  unsigned search_generation;              ///< Library generation of hits
+  unsigned search_revision;                ///< Search revision of hits
+
+  /* Audio processing */
+  Player player;                ///< Feeder thread decoding the music
+  int queued_track;             ///< Track queued for gapless advance, or -1
+  unsigned seen_advances;       ///< Gapless advances already followed
+  atomic_uint capture_channels; ///< Channel count seen by process_audio
+  Analyzer analyzer;            ///< Background FFT analysis worker
+  Analyzer_Mode analyzer_mode;  ///< Channel mode selected with the C key
+  /// Smear effect buffer for motion blur, per displayed channel
+  float smear[ANALYZER_MAX_CHANNELS][ANALYZER_MAX_BARS];
+
+  /* Bar renderer */
+  Bar_Quad bar_quads[COUNT_BAR_QUAD_KINDS][MAX_BAR_QUADS]; ///< Per-frame batch
+  Color palette[ANALYZER_MAX_BARS]; ///< Rainbow colors for palette_bars bars
+  unsigned palette_bars;            ///< Bar count the palette was built for
 } Plug;
 Plug *plug = NULL;
 /* Compile-time assertion to ensure icon array matches enum */
@@ -168,18 +203,6 @@ void *plug_load_resoruces(const char *file_path, size_t *size) {
   return data;
 }
 
-/**
- * @brief Gets pointer to the currently playing track
- * @return Pointer to current Track, or NULL if no track is playing
- */
-static Track *current_track(void) {
-  if (0 <= plug->current_track &&
-      (size_t)plug->current_track < plug->tracks.count) {
-    return &plug->tracks.items[plug->current_track];
-  }
-  return NULL;
-}
-
 /**
  * @brief Updates mouse activity state for UI auto-hiding in fullscreen
  *
@@ -200,57 +223,11 @@ static void update_mouse_state(void) {
   plug->mouse_active = (GetTime() - plug->last_mouse_move_time) < MOUSE_TIMEOUT;
 }
 
-/**
- * @brief Computes Fast Fourier Transform using Cooley-Tukey algorithm
- *
- * Recursive radix-2 decimation-in-time FFT implementation.
- *
- * @param in Input array of real samples
- * @param stride Stride between samples (used for recursion)
- * @param out Output array for complex frequency spectrum
- * @param n Number of samples (must be power of 2)
- */
-static void compute_fft(float in[], size_t stride, float complex out[],
-                        size_t n) {
-  /* Base case: single sample */
-  if (n == 1) {
-    out[0] = in[0];
-    return;
-  }
-
-  /* Recursively compute FFT of even and odd samples */
-  compute_fft(in, stride * 2, out, n / 2);
-  compute_fft(in + stride, stride * 2, out + n / 2, n / 2);
-
-  /* Combine results using butterfly operations */
-  for (size_t k = 0; k < n / 2; k++) {
-    float t = (float)k / n;
-    float complex v = cexpf(-2.0f * I * PI * t) * out[k + n / 2];
-    float complex e = out[k];
-    out[k] = e + v;
-    out[k + n / 2] = e - v;
-  }
-}
-
-/**
- * @brief Calculates amplitude of a complex number using infinity norm
- *
- * Uses max(|real|, |imag|) as a fast approximation of magnitude.
- *
- * @param z Complex number
- * @return Amplitude (infinity norm)
- */
-static float get_amplitude(float complex z) {
-  float a = fabsf(crealf(z));
-  float b = fabsf(cimagf(z));
-  return (a > b) ? a : b;
-}
-
 /**
  * @brief Audio stream callback that captures samples for visualization
  *
- * Called by Raylib for each audio buffer. Maintains a ring buffer of samples
- * for FFT processing.
+ * Called by Raylib for each audio buffer. Hands the samples to the analyzer
+ * ring buffer and wakes its worker thread.
  *
  * @param bufferData Interleaved audio samples from stream
  * @param frames Number of frames in buffer
@@ -261,21 +238,39 @@ static void process_audio(void *bufferData, unsigned int frames) {
   if (!plug)
     return;
 
-  Track *t = current_track();
-  if (!t)
+  /* Published by on_track_switch(): the device's channel count */
+  unsigned channels =
+      atomic_load_explicit(&plug->capture_channels, memory_order_relaxed);
+  if (channels == 0)
     return;
 
-  float *fs = (float *)bufferData;
-  unsigned ch = t->music.stream.channels;
-
-  unsigned w = atomic_load_explicit(&plug->sample_write, memory_order_relaxed);
+  analyzer_push(&plug->analyzer, bufferData, frames, channels);
+}
 
-  for (unsigned i = 0; i < frames; i++) {
-    plug->samples[w] = fs[i * ch]; // canal 0 (mono)
-    w = (w + 1) % N;
-  }
+/**
+ * @brief Player hook run on the feeder thread during a track switch
+ *
+ * process_audio receives nothing at this point, so the analyzer can be
+ * reset as its producer. It receives the device's mixing format, not the
+ * track's, so that is the rate and layout analyzed. A gapless or
+ * crossfading advance keeps the analysis history, so the bars flow
+ * straight into the next track.
+ */
+static void on_track_switch(void *user, Music next, bool gapless) {
+  (void)user;
+  (void)next;
+  unsigned rate = plug->player.device_rate;
+  if (!gapless || atomic_load(&plug->analyzer.sample_rate) != rate)
+    analyzer_reset(&plug->analyzer, rate);
+  atomic_store(&plug->capture_channels, plug->player.device_channels);
+}
 
-  atomic_store_explicit(&plug->sample_write, w, memory_order_release);
+/**
+ * @brief Queues a playback command that needs no music handle
+ */
+static void send_player_command(Player_Command_Kind kind, float value) {
+  player_send(&plug->player,
+              (Player_Command){.kind = kind, .value = value});
 }
 
 /**
@@ -289,9 +284,8 @@ static void draw_progress(void) {
     return;
 
   /* Calculate progress percentage */
-  float played = GetMusicTimePlayed(current_track()->music);
-  float total = GetMusicTimeLength(current_track()->music);
-  if (total <= 0.0f)
+  float played, total;
+  if (!player_position(&plug->player, &played, &total) || total <= 0.0f)
     return;
 
   float t = played / total;
@@ -330,7 +324,7 @@ static void draw_progress(void) {
         nt = 0;
       if (nt > 1)
         nt = 1;
-      SeekMusicStream(current_track()->music, total * nt);
+      send_player_command(PLAYER_CMD_SEEK, total * nt);
     }
   }
 }
@@ -338,54 +332,49 @@ static void draw_progress(void) {
 /**
  * @brief Switches to a different track in the playlist
  *
- * Stops current track, updates processors, and starts new track.
- * Handles wraparound for next/previous navigation.
+ * Only queues the switch: the feeder thread primes the new stream, moves
+ * the capture processor and swaps streams, so this never blocks rendering.
  *
- * @param index Index of track to switch to (-1 for last, >count wraps to first)
+ * @param id Id of the track to switch to
  */
-static void switch_track(int index) {
-  if (plug->tracks.count == 0)
+static void switch_track(int id) {
+  if (id < 0 || (size_t)id >= plug->playlist.count)
     return;
-
-  /* Detach audio processor from previous track */
-  Track *prev = current_track();
-  if (prev) {
-    StopMusicStream(prev->music);
-    WaitTime(0.05f);
-    DetachAudioStreamProcessor(prev->music.stream, process_audio);
-  }
-
-  /* Handle wraparound */
-
-  if (index < 0)
-    plug->current_track = plug->tracks.count - 1;
-  else if ((size_t)index >= plug->tracks.count)
-    plug->current_track = 0;
-  else
-    plug->current_track = index;
+  plug->current_track = id;
 
   /* Reset visualization buffers for clean transition */
-  memset(plug->samples, 0, sizeof(plug->samples));
-  memset(plug->bars, 0, sizeof(plug->bars));
   memset(plug->smear, 0, sizeof(plug->smear));
-  memset(plug->spectrum, 0, sizeof(plug->spectrum));
-  atomic_store(&plug->sample_write, 0);
 
-  plug->bass_history = 0.0f;
-  plug->overall_level = 0.5f;
-
-  /* Setup and start new track */
-  Track *next = current_track();
-  plug->sample_rate = next->music.stream.sampleRate;
-  AttachAudioStreamProcessor(next->music.stream, process_audio);
-  SetMusicVolume(next->music, plug->master_vol);
-  PlayMusicStream(next->music);
+  player_play(&plug->player, playlist_path(&plug->playlist, (uint32_t)id),
+              id);
+  /* PLAY clears the feeder's gapless queue */
+  plug->queued_track = -1;
 
   plug->paused = false;
   plug->has_music = true;
+}
 
-  plug->is_stabilizing = true;
-  plug->stabilization_timer = 0.5f;
+/**
+ * @brief Switches to the next (direction 1) or previous (-1) track in play
+ * order, wrapping around at either end
+ */
+static void step_track(int direction) {
+  const Playlist *pl = &plug->playlist;
+  if (pl->count == 0)
+    return;
+  uint32_t id = direction > 0 ? playlist_next(pl, plug->current_track)
+                              : playlist_prev(pl, plug->current_track);
+  if (id == PLAYLIST_NONE)
+    id = pl->order[direction > 0 ? 0 : pl->count - 1];
+  switch_track((int)id);
+}
+
+/**
+ * @brief Measures a queue label (user is the text)
+ */
+static float measure_queue_text(void *user, size_t track) {
+  (void)track;
+  return MeasureTextEx(plug->font, user, QUEUE_FONT_SIZE, 0).x;
 }
 
 /**
@@ -395,7 +384,12 @@ static void switch_track(int index) {
  * - Scrollable track list
  * - Click to select track
  * - Highlights current track
+ * - Cover thumbnail and "Artist - Title" once the tags are read (meta.h)
  * - Auto-scrolling text for long names
+ *
+ * Only the visible rows are visited, found from the scroll offset, and text
+ * widths are measured once per track (queue_view.h), so a frame costs the
+ * same for 10 or a million queued tracks.
  */
 static void draw_queue(void) {
   if (plug->fullscreen || !plug->has_music)
@@ -411,39 +405,43 @@ static void draw_queue(void) {
                 (Color){0x15, 0x15, 0x15, 0xFF});
 
   /* Layout constants */
-  float item_height = 50.0f;
-  float font_size = 24.0f;
+  Queue_Layout layout = {.top = 10.0f,
+                         .row_height = 50.0f,
+                         .row_spacing = 10.0f,
+                         .height = queue_height};
   float side_padding = 10.0f;
   float inner_padding = 15.0f;
 
   /* Handle mouse wheel scrolling */
-  if (CheckCollisionPointRec(GetMousePosition(),
-                             (Rectangle){0, 0, queue_width, queue_height})) {
-    plug->queue_scroll += GetMouseWheelMove() * 25.0f;
+  Vector2 mouse = GetMousePosition();
+  bool mouse_in_queue = CheckCollisionPointRec(
+      mouse, (Rectangle){0, 0, queue_width, queue_height});
+  if (mouse_in_queue) {
+    plug->queue_scroll += GetMouseWheelMove() * 25.0;
   }
 
-  /* Clamp scroll to valid range */
-  float content_height = (float)plug->tracks.count * (item_height + 10.0f);
-  float max_scroll = (content_height > queue_height)
-                         ? (queue_height - content_height - 20.0f)
-                         : 0.0f;
-  if (plug->queue_scroll < max_scroll)
-    plug->queue_scroll = max_scroll;
-  if (plug->queue_scroll > 0)
-    plug->queue_scroll = 0;
-
-  /* Render each track item */
-  for (size_t i = 0; i < plug->tracks.count; i++) {
-    float y_pos = i * (item_height + 10.0f) + plug->queue_scroll + 10.0f;
-
-    /* Skip offscreen items for performance */
-    if (y_pos + item_height < 0 || y_pos > queue_height)
-      continue;
+  /* While searching the queue only the hits are listed, best first */
+  bool filtered = plug->search_open && plug->search_source == SEARCH_QUEUE;
+  size_t rows = filtered ? plug->search_hit_count : plug->playlist.count;
+
+  plug->queue_scroll = queue_clamp_scroll(&layout, plug->queue_scroll, rows);
+
+  /* The row under the mouse, if any */
+  size_t hover_row = QUEUE_NO_ROW;
+  if (mouse_in_queue && mouse.x >= side_padding &&
+      mouse.x <= queue_width - side_padding)
+    hover_row = queue_row_at(&layout, plug->queue_scroll, rows, mouse.y);
+
+  /* Render the visible track items */
+  Queue_Range visible = queue_visible(&layout, plug->queue_scroll, rows);
+  for (size_t row = visible.first; row < visible.end; row++) {
+    size_t i = filtered ? plug->search_hits[row].id : plug->playlist.order[row];
+    float y_pos = queue_row_y(&layout, plug->queue_scroll, row);
 
     Rectangle item_rec = {side_padding, y_pos, queue_width - (side_padding * 2),
-                          item_height};
+                          layout.row_height};
     bool is_current = (i == (size_t)plug->current_track);
-    bool is_hover = CheckCollisionPointRec(GetMousePosition(), item_rec);
+    bool is_hover = row == hover_row;
 
     /* Determine item background color */
     Color base_color = is_current ? (Color){0x3b, 0x59, 0xd8, 0xFF}
@@ -453,22 +451,38 @@ static void draw_queue(void) {
 
     DrawRectangleRounded(item_rec, 0.2f, 8, base_color);
 
-    /* Extract filename from path */
-    const char *name = GetFileName(plug->tracks.items[i].file_name);
-    Vector2 text_size = MeasureTextEx(plug->font, name, font_size, 0);
-
-    float available_space = item_rec.width - (inner_padding * 2);
-    Vector2 text_pos = {item_rec.x + inner_padding,
-                        item_rec.y + (item_rec.height / 2) - (text_size.y / 2)};
+    /* Cover on the left, the text in the rest of the row */
+    const char *path = playlist_path(&plug->playlist, (uint32_t)i);
+    const Meta_Entry *meta = meta_get(&plug->meta, (uint32_t)i, path);
+    float thumb_size = item_rec.height - 10.0f;
+    if (meta->tile >= 0)
+      DrawTexturePro(plug->meta.atlas, meta_tile_rect(meta->tile),
+                     (Rectangle){item_rec.x + 5, item_rec.y + 5, thumb_size,
+                                 thumb_size},
+                     (Vector2){0}, 0, WHITE);
+    Rectangle text_rec = {item_rec.x + thumb_size + 5, item_rec.y,
+                          item_rec.width - thumb_size - 5, item_rec.height};
+
+    /* Tags when known, the file name until then */
+    const char *name =
+        meta->label ? meta->label : playlist_name(&plug->playlist, (uint32_t)i);
+    float text_width = queue_text_width(
+        &plug->queue_metrics, i, meta->label ? 2 : 1, QUEUE_FONT_SIZE,
+        measure_queue_text, (void *)name);
+
+    float available_space = text_rec.width - (inner_padding * 2);
+    Vector2 text_pos = {text_rec.x + inner_padding,
+                        text_rec.y + (text_rec.height / 2) -
+                            (QUEUE_FONT_SIZE / 2)};
 
     /* Enable scissor mode for text clipping */
-    BeginScissorMode((int)item_rec.x + 5, (int)item_rec.y,
-                     (int)item_rec.width - 10, (int)item_rec.height);
+    BeginScissorMode((int)text_rec.x + 5, (int)text_rec.y,
+                     (int)text_rec.width - 10, (int)text_rec.height);
 
     /* Animate text scrolling for long filenames on hover */
-    if (is_hover && text_size.x > available_space) {
+    if (is_hover && text_width > available_space) {
       float speed = 30.0f;
-      float total_dist = text_size.x - available_space + 20.0f;
+      float total_dist = text_width - available_space + 20.0f;
       float time = (float)GetTime();
 
       /* Ping-pong scrolling animation */
@@ -477,12 +491,12 @@ static void draw_queue(void) {
         offset = total_dist * 2 - offset;
 
       text_pos.x -= offset;
-    } else if (text_size.x <= available_space) {
+    } else if (text_width <= available_space) {
       /* Center text if it fits */
-      text_pos.x = item_rec.x + (item_rec.width / 2) - (text_size.x / 2);
+      text_pos.x = text_rec.x + (text_rec.width / 2) - (text_width / 2);
     }
 
-    DrawTextEx(plug->font, name, text_pos, font_size, 0, WHITE);
+    DrawTextEx(plug->font, name, text_pos, QUEUE_FONT_SIZE, 0, WHITE);
 
     EndScissorMode();
 
@@ -494,13 +508,33 @@ static void draw_queue(void) {
 }
 
 /**
- * @brief Renders frequency visualization plug->bars with advanced effects
+ * @brief Horizontal center of bar i of channel c
+ *
+ * A single channel runs low to high frequencies left to right. In stereo the
+ * left channel is mirrored onto the left half, so both channels start from
+ * the bass in the middle of the screen.
+ */
+static float bar_center_x(unsigned c, int i, int bars, unsigned channels,
+                          float start_x, float cell_width) {
+  int cell = i;
+  if (channels == 2)
+    cell = (c == 0) ? bars - 1 - i : bars + i;
+  return start_x + cell * cell_width + cell_width / 2;
+}
+
+/**
+ * @brief Renders the latest analyzer frame as bars with advanced effects
  *
- * Draws plug->bars with:
- * - Smooth lines as plug->bars
+ * Draws bars with:
+ * - Smooth lines as bars
  * - Glowing circles at tips
  * - Smear trails for motion blur effect
  * - Rainbow HSV coloring
+ * - Mirrored left/right halves in stereo mode
+ *
+ * All three primitives are collected into one quad batch and submitted
+ * with a single shader (bars.fs), so the whole spectrum costs one draw
+ * call instead of one pass per effect.
  */
 static void draw_bars(void) {
   int w = GetRenderWidth();
@@ -509,10 +543,18 @@ static void draw_bars(void) {
   if (!plug->has_music)
     return;
 
+  /* Pick up the newest finished analysis without waiting for the worker */
+  const Analyzer_Frame *frame =
+      analyzer_display_frame(&plug->analyzer, GetTime());
+  unsigned channels = frame->channels;
+  int bars = (int)frame->bar_count;
+  if (bars == 0)
+    return;
+
   /* Calculate bar layout based on mode */
   float start_x = plug->fullscreen ? 0 : w * 0.20f;
   float available_w = plug->fullscreen ? w : w * 0.80f;
-  float cell_width = available_w / BARS;
+  float cell_width = available_w / (bars * channels);
 
   /* FIX: Ajustar base_y y max_bar_height para evitar overflow */
   float base_y;
@@ -534,239 +576,100 @@ static void draw_bars(void) {
     max_bar_height_factor = 0.6f;
   }
 
-  /* Global visual parameters */
-  float saturation = 0.75f;
-  float value = 1.0f;
-
-  /* PASS 1: Draw bar lines */
-  for (int i = 0; i < BARS; i++) {
-    float intensity = plug->bars[i];
-    if (intensity > 1.2f)
-      intensity = 1.2f;
-    if (intensity < 0.0f)
-      intensity = 0.0f;
-
-    /* Update smear with slower decay */
-    float smear_speed = 3.0f;
-    plug->smear[i] +=
-        (intensity - plug->smear[i]) * smear_speed * GetFrameTime();
-
-    /* Calculate positions with corrected height */
-    float bar_height = intensity * h * max_bar_height_factor;
-    float x = start_x + i * cell_width + cell_width / 2;
-    float y_top = base_y - bar_height;
-
-    /* Rainbow color based on position */
-    float hue = (float)i / BARS * 360.0f;
-    Color color = ColorFromHSV(hue, saturation, value);
-
-    /* Draw line with variable thickness */
-    float thickness = cell_width / 3.0f * sqrtf(intensity);
-    Vector2 start_pos = {x, y_top};
-    Vector2 end_pos = {x, base_y};
-    DrawLineEx(start_pos, end_pos, thickness, color);
+  /* Rainbow palette, rebuilt only when the bar count changes */
+  if (plug->palette_bars != (unsigned)bars) {
+    for (int i = 0; i < bars; i++)
+      plug->palette[i] = ColorFromHSV((float)i / bars * 360.0f, 0.75f, 1.0f);
+    plug->palette_bars = (unsigned)bars;
   }
 
-  /* Get default 1x1 white texture for shader effects */
-  Texture2D default_tex = {.id = rlGetTextureIdDefault(),
-                           .width = 1,
-                           .height = 1,
-                           .mipmaps = 1,
-                           .format = PIXELFORMAT_UNCOMPRESSED_R8G8B8A8};
-
-  /* PASS 2: Draw smear trails (motion blur) */
-  SetShaderValue(plug->circle, plug->circle_radius_location, (float[1]){0.3f},
-                 SHADER_UNIFORM_FLOAT);
-  SetShaderValue(plug->circle, plug->circle_power_location, (float[1]){3.0f},
-                 SHADER_UNIFORM_FLOAT);
-
-  BeginShaderMode(plug->circle);
-  for (int i = 0; i < BARS; i++) {
-    float intensity = plug->bars[i];
-    if (intensity < 0.0f)
-      intensity = 0.0f;
-    if (intensity > 1.2f)
-      intensity = 1.2f;
-
-    float start_height = plug->smear[i] * h * max_bar_height_factor;
-    float end_height = intensity * h * max_bar_height_factor;
-
-    float x = start_x + i * cell_width + cell_width / 2;
-    float y_start = base_y - start_height;
-    float y_end = base_y - end_height;
-
-    float hue = (float)i / BARS * 360.0f;
-    Color color = ColorFromHSV(hue, saturation, value);
-
-    float radius = cell_width * 1.2f * sqrtf(intensity);
-
-    /* Draw smear as stretched texture */
-    if (y_end >= y_start) {
-      Rectangle dest = {x - radius / 2, y_start, radius, y_end - y_start};
-      Rectangle src = {0, 0, 1, 0.5f};
-      DrawTexturePro(default_tex, src, dest, (Vector2){0, 0}, 0, color);
-    } else {
-      Rectangle dest = {x - radius / 2, y_end, radius, y_start - y_end};
-      Rectangle src = {0, 0.5f, 1, 0.5f};
-      DrawTexturePro(default_tex, src, dest, (Vector2){0, 0}, 0, color);
+  /* Build the batch: every kind is appended to its own list so that lines,
+   * smears and tips still layer in that order */
+  size_t counts[COUNT_BAR_QUAD_KINDS] = {0};
+  float smear_speed = 3.0f;
+  float dt = GetFrameTime();
+
+  for (unsigned c = 0; c < channels; c++) {
+    for (int i = 0; i < bars; i++) {
+      float intensity = frame->bars[c][i];
+      if (intensity > 1.2f)
+        intensity = 1.2f;
+      if (intensity < 0.0f)
+        intensity = 0.0f;
+
+      /* Update smear with slower decay */
+      plug->smear[c][i] += (intensity - plug->smear[c][i]) * smear_speed * dt;
+      if (intensity <= 0.0f && plug->smear[c][i] <= 0.0f)
+        continue;
+
+      float x = bar_center_x(c, i, bars, channels, start_x, cell_width);
+      float y_top = base_y - intensity * h * max_bar_height_factor;
+      float y_smear = base_y - plug->smear[c][i] * h * max_bar_height_factor;
+      float size = sqrtf(intensity);
+      Color color = plug->palette[i];
+
+      /* Line with variable thickness */
+      float thickness = cell_width / 3.0f * size;
+      plug->bar_quads[BAR_QUAD_LINE][counts[BAR_QUAD_LINE]++] = (Bar_Quad){
+          .rec = {x - thickness / 2, y_top, thickness, base_y - y_top},
+          .v0 = 0.0f,
+          .v1 = 1.0f,
+          .color = color,
+      };
+
+      /* Smear trail from the smoothed height to the bar: upper half of the
+       * glow when the bar falls, lower half when it rises */
+      float width = cell_width * 1.2f * size;
+      bool falling = y_top >= y_smear;
+      plug->bar_quads[BAR_QUAD_SMEAR][counts[BAR_QUAD_SMEAR]++] = (Bar_Quad){
+          .rec = {x - width / 2, falling ? y_smear : y_top, width,
+                  fabsf(y_top - y_smear)},
+          .v0 = falling ? 0.0f : 0.5f,
+          .v1 = falling ? 0.5f : 1.0f,
+          .color = color,
+      };
+
+      /* Circle size based on intensity */
+      float radius = cell_width * 0.8f * size;
+      plug->bar_quads[BAR_QUAD_TIP][counts[BAR_QUAD_TIP]++] = (Bar_Quad){
+          .rec = {x - radius, y_top - radius, 2 * radius, 2 * radius},
+          .v0 = 0.0f,
+          .v1 = 1.0f,
+          .color = color,
+      };
     }
   }
-  EndShaderMode();
-
-  /* PASS 3: Draw glowing circles at bar tips */
-  SetShaderValue(plug->circle, plug->circle_radius_location, (float[1]){0.07f},
-                 SHADER_UNIFORM_FLOAT);
-  SetShaderValue(plug->circle, plug->circle_power_location, (float[1]){5.0f},
-                 SHADER_UNIFORM_FLOAT);
-
-  BeginShaderMode(plug->circle);
-  for (int i = 0; i < BARS; i++) {
-    float intensity = plug->bars[i];
-    if (intensity < 0.0f)
-      intensity = 0.0f;
-    if (intensity > 1.2f)
-      intensity = 1.2f;
-
-    float bar_height = intensity * h * max_bar_height_factor;
-    float x = start_x + i * cell_width + cell_width / 2;
-    float y = base_y - bar_height;
-
-    float hue = (float)i / BARS * 360.0f;
-    Color color = ColorFromHSV(hue, saturation, value);
-
-    /* Circle size based on intensity */
-    float radius = cell_width * 0.8f * sqrtf(intensity);
-
-    Vector2 position = {x - radius, y - radius};
-    DrawTextureEx(default_tex, position, 0, 2 * radius, color);
-  }
-  EndShaderMode();
-}
-
-/**
- * @brief Updates visualization by computing FFT and smoothing plug->bars
- *
- * Processing pipeline:
- * 1. Apply Hann window to samples
- * 2. Compute FFT to get frequency spectrum
- * 3. Map spectrum to logarithmic frequency bins
- * 4. Apply enhanced bass boost and smoothing
- */
-static void update_visualizer(void) {
-  if (plug->has_music && !plug->paused) {
-    if (plug->is_stabilizing) {
-      plug->stabilization_timer -= GetFrameTime();
-      if (plug->stabilization_timer <= 0.0f) {
-        plug->is_stabilizing = false;
-      }
-    }
-
-    if (!plug->window_ready) {
-      for (size_t i = 0; i < N; i++) {
-        plug->window[i] = 0.5f * (1.0f - cosf(2.0f * PI * i / (N - 1)));
-      }
-      plug->window_ready = true;
-    }
-
-    float tmp[N];
-    unsigned w =
-        atomic_load_explicit(&plug->sample_write, memory_order_acquire);
-    for (size_t i = 0; i < N; i++) {
-      size_t idx = (w + i) % N;
-      tmp[i] = plug->samples[idx] * plug->window[i];
-    }
-
-    compute_fft(tmp, 1, plug->spectrum, N);
-
-    float max_amp = 1e-6f;
-    for (size_t i = 0; i < N / 2; i++) {
-      float a = get_amplitude(plug->spectrum[i]);
-      if (a > max_amp)
-        max_amp = a;
-    }
-
-    if (plug->is_stabilizing) {
-      if (max_amp < 0.01f)
-        max_amp = 0.01f;
-    }
-
-    float freq_min = 20.0f;
-    float freq_max = plug->sample_rate * 0.5f;
-    int bass_bands = 8;
-
-    float current_bass_energy = 0.0f;
-
-    for (int i = 0; i < BARS; i++) {
-      float t0 = (float)i / BARS;
-      float t1 = (float)(i + 1) / BARS;
-      float f0 = freq_min * powf(freq_max / freq_min, t0);
-      float f1 = freq_min * powf(freq_max / freq_min, t1);
-      size_t k0 = (size_t)(f0 * N / plug->sample_rate);
-      size_t k1 = (size_t)(f1 * N / plug->sample_rate);
-      if (k1 <= k0)
-        k1 = k0 + 1;
-
-      float band_max = 0.0f;
-      for (size_t k = k0; k < k1 && k < N / 2; k++) {
-        float a = get_amplitude(plug->spectrum[k]);
-        if (a > band_max)
-          band_max = a;
-      }
-
-      float normalized = band_max / max_amp;
-
-      float bass_boost = 1.0f;
-      if (i < bass_bands) {
-        float bass_factor = 1.0f - ((float)i / bass_bands);
-        bass_boost = 1.0f + bass_factor * 3.5f;
-        current_bass_energy += normalized;
-      }
-
-      float target = normalized * bass_boost;
-      target = sqrtf(target);
-
-      if (plug->is_stabilizing) {
-        if (target > 0.6f) {
-          target *= 0.4f;
-        }
-      }
-
-      plug->overall_level = 0.95f * plug->overall_level + 0.05f * normalized;
-      target *= (1.0f + plug->overall_level * 0.5f);
-
-      if (target > 0.85f) {
-        float excess = target - 0.85f;
-        target = 0.85f + excess * 0.3f;
-      }
 
-      if (target > 1.5f)
-        target = 1.5f;
-
-      if (i == 0) {
-        plug->bass_history = 0.9f * plug->bass_history + 0.1f * target;
-      }
-
-      float dt = GetFrameTime();
-      float smoothness_up = 20.0f + plug->bass_history * 10.0f;
-      float smoothness_down = 4.5f + plug->bass_history * 2.0f;
-
-      if (plug->is_stabilizing) {
-        smoothness_up *= 0.3f;
-        smoothness_down *= 2.0f;
-      }
-
-      if (target > plug->bars[i]) {
-        plug->bars[i] += (target - plug->bars[i]) * smoothness_up * dt;
-      } else {
-        plug->bars[i] += (target - plug->bars[i]) * smoothness_down * dt;
-      }
+  /* Submit everything as one textured quad batch: one draw call */
+  size_t total = counts[BAR_QUAD_LINE] + counts[BAR_QUAD_SMEAR] +
+                 counts[BAR_QUAD_TIP];
+  if (total == 0)
+    return;
 
-      if (plug->bars[i] < 0.0f)
-        plug->bars[i] = 0.0f;
-      if (plug->bars[i] > 1.5f)
-        plug->bars[i] = 1.5f;
+  BeginShaderMode(plug->bars_shader);
+  rlCheckRenderBatchLimit(4 * (int)total);
+  rlSetTexture(rlGetTextureIdDefault());
+  rlBegin(RL_QUADS);
+  for (Bar_Quad_Kind kind = 0; kind < COUNT_BAR_QUAD_KINDS; kind++) {
+    /* bars.fs decodes the kind from the integer part of u */
+    float u0 = 2.0f * kind, u1 = u0 + 1.0f;
+    for (size_t q = 0; q < counts[kind]; q++) {
+      const Bar_Quad *quad = &plug->bar_quads[kind][q];
+      Rectangle r = quad->rec;
+      rlColor4ub(quad->color.r, quad->color.g, quad->color.b, quad->color.a);
+      rlTexCoord2f(u0, quad->v0);
+      rlVertex2f(r.x, r.y);
+      rlTexCoord2f(u0, quad->v1);
+      rlVertex2f(r.x, r.y + r.height);
+      rlTexCoord2f(u1, quad->v1);
+      rlVertex2f(r.x + r.width, r.y + r.height);
+      rlTexCoord2f(u1, quad->v0);
+      rlVertex2f(r.x + r.width, r.y);
     }
   }
+  rlEnd();
+  rlSetTexture(0);
+  EndShaderMode();
 }
 
 /**
@@ -820,7 +723,7 @@ static void draw_volume_slider(void) {
 
       plug->volume_slider.value = new_value;
       plug->master_vol = new_value;
-      SetMusicVolume(current_track()->music, plug->master_vol);
+      send_player_command(PLAYER_CMD_VOLUME, plug->master_vol);
 
       /* Update volume level icon */
       if (plug->master_vol <= 0.01f)
@@ -1000,23 +903,36 @@ static void draw_ui_bar(void) {
 }
 
 /**
- * @brief Automatically advances to next track when current track finishes
+ * @brief Keeps the following track queued for a gapless advance
  *
- * Checks if playback is near end of track and switches to next track in queue.
- * Only operates when music is playing and not at end of playlist.
+ * The feeder thread moves on to the queued track by itself at the end of
+ * the current one; this follows such advances and queues the next track
+ * again. Nothing is queued after the last track, which keeps looping.
  */
 static void next_track_in_queue(void) {
-  if (!plug->has_music || plug->tracks.count <= 1 || plug->paused ||
-      (size_t)plug->current_track == plug->tracks.count - 1)
-    return;
-
-  float curr_time = GetMusicTimePlayed(current_track()->music);
-  float total_time = GetMusicTimeLength(current_track()->music);
+  int tag;
+  if (player_advanced(&plug->player, &plug->seen_advances, &tag)) {
+    plug->current_track = tag;
+    plug->queued_track = -1;
+  }
 
-  /* Switch when within 0.1s of end */
-  if (total_time > 0.0f && curr_time >= (total_time - 0.1f)) {
-    switch_track(plug->current_track + 1);
+  int next = -1;
+  if (plug->has_music) {
+    uint32_t id = playlist_next(&plug->playlist, plug->current_track);
+    next = id == PLAYLIST_NONE ? -1 : (int)id;
   }
+  if (next == plug->queued_track)
+    return;
+
+  Player_Command cmd = {.kind = PLAYER_CMD_UNQUEUE};
+  if (next >= 0)
+    cmd = (Player_Command){
+        .kind = PLAYER_CMD_QUEUE,
+        .path = playlist_path(&plug->playlist, (uint32_t)next),
+        .tag = next,
+    };
+  if (player_send(&plug->player, cmd))
+    plug->queued_track = next;
 }
 
 /**
@@ -1034,6 +950,23 @@ static bool is_ui_bar_active(void) {
   return true;
 }
 
+/**
+ * @brief Asks where to save the queue; collect_dialog_result() writes it
+ */
+static void save_queue(void) {
+  const char *path = plug->playlist_file[0]
+                         ? plug->playlist_file
+                         : TextFormat("%s/queue.m3u8", plug->current_dir);
+  file_dialog_save(&plug->file_dialog, "Save Queue", path);
+}
+
+/**
+ * @brief IsKeyPressed() for shortcuts, which the search box silences
+ */
+static bool shortcut_pressed(int key) {
+  return !plug->search_open && IsKeyPressed(key);
+}
+
 /**
  * @brief Handles keyboard and mouse input for playback controls
  *
@@ -1041,32 +974,39 @@ static bool is_ui_bar_active(void) {
  * - F: Toggle fullscreen
  * - SPACE: Play/pause
  * - M: Mute/unmute
+ * - C: Cycle mid / stereo / side analysis
+ * - [ / ]: Halve / double the FFT size
+ * - - / =: Fewer / more bars
+ * - W: Cycle the analysis window
  * - N: Next track
  * - P: Previous track
+ * - S: Shuffle the queue
+ * - Ctrl+S: Save the queue as a playlist file
+ * - A: Sort the queue by name, then length, then back to the order added
+ *
+ * Shortcuts are ignored while the search box is open.
  */
 static void handle_input(void) {
   if (!plug->has_music)
     return;
 
   /* Toggle fullscreen mode */
-  if (IsKeyPressed(KEY_F)) {
+  if (shortcut_pressed(KEY_F)) {
     plug->fullscreen = !plug->fullscreen;
   }
 
   /* Toggle play/pause */
-  if (IsKeyPressed(KEY_SPACE)) {
+  if (shortcut_pressed(KEY_SPACE)) {
 
-    if (plug->paused)
-      ResumeMusicStream(current_track()->music);
-    else
-      PauseMusicStream(current_track()->music);
+    send_player_command(plug->paused ? PLAYER_CMD_RESUME : PLAYER_CMD_PAUSE,
+                        0.0f);
 
     plug->paused = !plug->paused;
   }
 
   /* Toggle mute (keyboard or click on volume icon) */
   Vector2 mouse = GetMousePosition();
-  if (IsKeyPressed(KEY_M) ||
+  if (shortcut_pressed(KEY_M) ||
       (CheckCollisionPointRec(mouse, plug->ui_recs[VOLUME_UI_ICON]) &&
        IsMouseButtonPressed(MOUSE_BUTTON_LEFT))) {
     if (plug->master_vol > 0.0f) {
@@ -1076,17 +1016,69 @@ static void handle_input(void) {
       plug->master_vol =
           (plug->volume_saved > 0.0f) ? plug->volume_saved : 0.5f;
     }
-    SetMusicVolume(current_track()->music, plug->master_vol);
+    send_player_command(PLAYER_CMD_VOLUME, plug->master_vol);
     plug->volume_slider.value = plug->master_vol;
     plug->volume_level =
         (plug->master_vol <= 0.01f) ? 0 : (plug->master_vol <= 0.65f ? 1 : 2);
   }
 
+  /* Cycle analyzer channel mode: mid -> stereo -> side */
+  if (shortcut_pressed(KEY_C)) {
+    plug->analyzer_mode = (plug->analyzer_mode + 1) % COUNT_ANALYZER_MODES;
+    analyzer_set_mode(&plug->analyzer, plug->analyzer_mode);
+  }
+
+  /* Live analysis settings: FFT size, bar count, window shape */
+  Analyzer_Config cfg = analyzer_config(&plug->analyzer);
+  bool reconfigure = true;
+  if (shortcut_pressed(KEY_LEFT_BRACKET))
+    cfg.fft_size /= 2;
+  else if (shortcut_pressed(KEY_RIGHT_BRACKET))
+    cfg.fft_size *= 2;
+  else if (shortcut_pressed(KEY_MINUS))
+    cfg.bars -= 8;
+  else if (shortcut_pressed(KEY_EQUAL))
+    cfg.bars += 8;
+  else if (shortcut_pressed(KEY_W))
+    cfg.window = (cfg.window + 1) % COUNT_FFT_WINDOWS;
+  else
+    reconfigure = false;
+  if (reconfigure)
+    analyzer_configure(&plug->analyzer, cfg);
+
+  /* Crossfade length: steps up to the maximum, then back to gapless */
+  if (shortcut_pressed(KEY_X)) {
+    plug->crossfade += CROSSFADE_KEY_STEP;
+    if (plug->crossfade > PLAYER_MAX_CROSSFADE)
+      plug->crossfade = 0.0f;
+    send_player_command(PLAYER_CMD_CROSSFADE, plug->crossfade);
+  }
+
   /* Next/previous track navigation */
-  if (IsKeyPressed(KEY_N))
-    switch_track(plug->current_track + 1);
-  if (IsKeyPressed(KEY_P))
-    switch_track(plug->current_track - 1);
+  if (shortcut_pressed(KEY_N))
+    step_track(1);
+  if (shortcut_pressed(KEY_P))
+    step_track(-1);
+
+  /* Queue order: shuffle with the playing track first, or cycle sorts */
+  bool ctrl = IsKeyDown(KEY_LEFT_CONTROL) || IsKeyDown(KEY_RIGHT_CONTROL);
+  if (shortcut_pressed(KEY_S) && ctrl) {
+    save_queue();
+  } else if (shortcut_pressed(KEY_S)) {
+    playlist_shuffle(&plug->playlist, plug->current_track,
+                     (uint64_t)time(NULL) ^ (uint64_t)(GetTime() * 1e6));
+    plug->queue_order = PLAYLIST_BY_ADDED;
+  }
+  if (shortcut_pressed(KEY_A)) {
+    static const Playlist_Key sorts[] = {PLAYLIST_BY_NAME, PLAYLIST_BY_LENGTH,
+                                         PLAYLIST_BY_ADDED};
+    size_t count = sizeof(sorts) / sizeof(*sorts);
+    size_t k = 0;
+    while (k + 1 < count && sorts[k] != plug->queue_order)
+      k++;
+    plug->queue_order = sorts[(k + 1) % count];
+    playlist_sort(&plug->playlist, plug->queue_order);
+  }
 
   /* Handle UI button clicks */
   if (IsMouseButtonPressed(MOUSE_BUTTON_LEFT) && is_ui_bar_active()) {
@@ -1094,10 +1086,8 @@ static void handle_input(void) {
     if (CheckCollisionPointRec(mouse, plug->ui_recs[PLAY_UI_ICON])) {
       plug->paused = !plug->paused;
 
-      if (plug->paused)
-        PauseMusicStream(current_track()->music);
-      else
-        ResumeMusicStream(current_track()->music);
+      send_player_command(plug->paused ? PLAYER_CMD_PAUSE : PLAYER_CMD_RESUME,
+                          0.0f);
     }
 
     else if (CheckCollisionPointRec(mouse, plug->ui_recs[FULLSCREEN_UI_ICON])) {
@@ -1106,11 +1096,89 @@ static void handle_input(void) {
   }
 }
 
+/**
+ * @brief Queues a track for search: file name, then library tags
+ */
+static void index_track(uint32_t index) {
+  const char *path = playlist_path(&plug->playlist, index);
+  const Library_Record *record = library_find(&plug->library, path);
+  const char *text = playlist_name(&plug->playlist, index);
+  if (record)
+    text = TextFormat("%s\t%s\t%s\t%s", text,
+                      library_string(&plug->library, record->title),
+                      library_string(&plug->library, record->artist),
+                      library_string(&plug->library, record->album));
+  search_add(&plug->search, index, text);
+}
+
+/**
+ * @brief Probes path and appends it to the playlist
+ *
+ * @return false if the file is not playable
+ */
+static bool append_track(const char *path) {
+  Track_Info info;
+  if (!library_track_info(&plug->library, path, &info) &&
+      !import_probe(path, &info))
+    return false;
+
+  uint32_t id = playlist_append(&plug->playlist, path, &info);
+  if (id == PLAYLIST_NONE)
+    return false;
+  index_track(id);
+  return true;
+}
+
+/**
+ * @brief Playlist file sink: appends an entry without opening it
+ *
+ * Entries in the library take their length from the index; the others
+ * keep the length the file gives, if any, until the player opens them.
+ */
+static bool load_playlist_entry(void *user, const char *path, float length) {
+  (void)user;
+  const Library_Record *record = library_find(&plug->library, path);
+  bool indexed = record && (record->flags & LIBRARY_PLAYABLE);
+  Track_Info info = {0};
+  if (indexed)
+    info = (Track_Info){.length = record->length,
+                        .sample_rate = record->sample_rate,
+                        .channels = record->channels};
+
+  uint32_t id =
+      playlist_append(&plug->playlist, path, indexed ? &info : NULL);
+  if (id == PLAYLIST_NONE)
+    return false;
+  if (!indexed && length >= 0.0f)
+    playlist_set_length(&plug->playlist, id, length);
+  index_track(id);
+  return true;
+}
+
+/**
+ * @brief Appends the entries of an M3U or PLS file to the queue, starting
+ * playback with the first one if nothing was loaded
+ */
+static bool load_playlist_file(const char *file) {
+  size_t first = plug->playlist.count;
+  if (!playlist_file_read(file, load_playlist_entry, NULL)) {
+    fprintf(stderr, "WARNING: could not read playlist %s\n", file);
+    plug->error = true;
+    return false;
+  }
+  snprintf(plug->playlist_file, sizeof(plug->playlist_file), "%s", file);
+  plug->error = false;
+  if (!plug->has_music && plug->playlist.count > first)
+    switch_track((int)first);
+  return true;
+}
+
 /**
  * @brief Handles drag-and-drop file loading
  *
- * Accepts dropped audio files and adds them to the playlist.
- * Automatically starts playback if no music was loaded.
+ * Dropped playlist files are read at once; other files and folders go to
+ * the background importer, and the playlist grows as importer_collect()
+ * hands back probed files.
  */
 
 static void handle_file_drop(void) {
@@ -1118,33 +1186,56 @@ static void handle_file_drop(void) {
     return;
 
   FilePathList files = LoadDroppedFiles();
-
+  /* Swap the paths to import to the front; raylib still frees them all */
+  size_t count = 0;
   for (size_t i = 0; i < files.count; i++) {
-    Music music = LoadMusicStream(files.paths[i]);
-    if (!IsMusicValid(music))
+    if (playlist_file_format(files.paths[i]) != PLAYLIST_FILE_NONE) {
+      load_playlist_file(files.paths[i]);
       continue;
-
-    char *file_path = strdup(files.paths[i]);
-    assert(file_path);
-
-    da_append(&plug->tracks, (CLITERAL(Track){
-                                 .file_name = file_path,
-                                 .music = music,
-                             }));
+    }
+    char *path = files.paths[i];
+    files.paths[i] = files.paths[count];
+    files.paths[count++] = path;
   }
-
+  size_t accepted = importer_submit(&plug->importer, files.paths, count);
+  if (accepted < count)
+    fprintf(stderr, "WARNING: import queue full, %zu paths dropped\n",
+            count - accepted);
   UnloadDroppedFiles(files);
+}
 
-  if (!plug->has_music && plug->tracks.count > 0) {
-    plug->current_track = 0;
-    plug->has_music = true;
-    plug->paused = false;
+/**
+ * @brief Importer sink: appends a probed file to the playlist
+ *
+ * Automatically starts playback with the first playable file if no music
+ * was loaded.
+ */
+static void import_track(void *user, char *path, const Track_Info *info) {
+  (void)user;
+  uint32_t id = playlist_append(&plug->playlist, path, info);
+  free(path);
+  if (id == PLAYLIST_NONE)
+    return;
+  index_track(id);
+  if (!plug->has_music)
+    switch_track((int)id);
+}
+
+/**
+ * @brief Draws a thin progress strip while an import is running
+ */
+static void draw_import_progress(void) {
+  size_t done, total;
+  if (!importer_progress(&plug->importer, &done, &total))
+    return;
 
-    memset(plug->samples, 0, sizeof(plug->samples));
-    atomic_store(&plug->sample_write, 0);
+  int w = GetRenderWidth();
+  float t = total > 0 ? (float)done / total : 0.0f;
+  DrawRectangle(0, 0, w, 6, (Color){0x25, 0x25, 0x25, 0xFF});
+  DrawRectangle(0, 0, (int)(t * w), 6, (Color){0x3b, 0x59, 0xd8, 0xFF});
 
-    switch_track(0);
-  }
+  const char *label = TextFormat("Importing %zu / %zu", done, total);
+  DrawTextEx(plug->font, label, (Vector2){10, 12}, 24.0f, 0, WHITE);
 }
 
 /**
@@ -1168,9 +1259,9 @@ static void load_assets(void) {
 
   /*Load main UI shader*/
   data = plug_load_resoruces(
-      TextFormat("./resources/shaders/glsl%d/circle.fs", GLSL_VERSION),
+      TextFormat("./resources/shaders/glsl%d/bars.fs", GLSL_VERSION),
       &data_size);
-  plug->circle = LoadShaderFromMemory(NULL, data);
+  plug->bars_shader = LoadShaderFromMemory(NULL, data);
   plug_free_resource(data);
 
   /* Load UI icon textures */
@@ -1195,21 +1286,11 @@ static bool add_track_from_path(const char *path) {
   if (!path)
     return false;
 
-  Music music = LoadMusicStream(path);
-  if (!IsMusicValid(music)) {
+  if (!append_track(path)) {
     plug->error = true;
     return false;
   }
 
-  char *path_copy = strdup(path);
-  if (!path_copy)
-    return false;
-
-  da_append(&plug->tracks, (CLITERAL(Track){
-                               .file_name = path_copy,
-                               .music = music,
-                           }));
-
   plug->error = false;
 
   return true;
@@ -1229,12 +1310,114 @@ static void navigate_to_parent_dir(void) {
     *last_slash = '\0';
   }
 
-  if (plug->dir_files.count > 0)
-    UnloadDirectoryFiles(plug->dir_files);
-  plug->dir_files = LoadDirectoryFiles(plug->current_dir);
+  dir_model_open(&plug->browser, plug->current_dir);
   plug->browser_scroll = 0;
 }
 
+/**
+ * @brief Enters the subdirectory name of current_dir.
+ */
+static void enter_dir(const char *name) {
+  char path[sizeof(plug->current_dir)];
+  const char *sep = strcmp(plug->current_dir, "/") == 0 ? "" : "/";
+  snprintf(path, sizeof(path), "%s%s%s", plug->current_dir, sep, name);
+  memcpy(plug->current_dir, path, sizeof(path));
+  dir_model_open(&plug->browser, plug->current_dir);
+  plug->browser_scroll = 0;
+}
+
+/**
+ * @brief Adds a file picked in the browser and closes the browser
+ */
+static void pick_browser_file(const char *path) {
+  if (playlist_file_format(path) != PLAYLIST_FILE_NONE) {
+    if (load_playlist_file(path))
+      plug->show_browser = false;
+    return;
+  }
+  if (add_track_from_path(path)) {
+    if (!plug->has_music) {
+      // Primera canción: siempre reproducir
+      plug->has_music = true;
+      switch_track(0);
+    }
+    // Si ya hay música, simplemente agregar a la cola
+    // No cambiar automáticamente de track
+
+    plug->show_browser = false;
+  }
+}
+
+/**
+ * @brief Right-aligned duration of an indexed file in a browser row
+ */
+static void draw_record_length(Rectangle item_r, const Library_Record *record) {
+  if (!record || !(record->flags & LIBRARY_PLAYABLE))
+    return;
+  int seconds = (int)record->length;
+  const char *length = TextFormat("%d:%02d", seconds / 60, seconds % 60);
+  DrawText(length,
+           (int)(item_r.x + item_r.width) - MeasureText(length, 18) - 10,
+           (int)item_r.y + 8, 18, GRAY);
+}
+
+/**
+ * @brief Library hit id, or NULL if the hits are for another library
+ * generation than the one mapped
+ */
+static const Library_Record *library_hit(size_t row) {
+  uint32_t id = plug->search_hits[row].id;
+  if (plug->search_generation != plug->library.generation_seen ||
+      id >= plug->library.view.count)
+    return NULL;
+  return &plug->library.view.records[id];
+}
+
+/**
+ * @brief Lists the library search hits in place of the directory
+ */
+static void draw_library_hits(Rectangle browser_rec) {
+  float item_h = 35.0f;
+  if (plug->search_generation != plug->library.generation_seen) {
+    DrawText("Indexing library...", (int)browser_rec.x + 20,
+             (int)browser_rec.y + 60, 18, GRAY);
+    return;
+  }
+
+  int view_h = (int)browser_rec.height - 60;
+  size_t rows = (size_t)(view_h / item_h);
+  if (rows > plug->search_hit_count)
+    rows = plug->search_hit_count;
+
+  BeginScissorMode((int)browser_rec.x, (int)browser_rec.y + 50,
+                   (int)browser_rec.width, view_h);
+  for (size_t i = 0; i < rows; i++) {
+    const Library_Record *record = library_hit(i);
+    if (!record)
+      break;
+    const char *path = library_string(&plug->library, record->path);
+    const char *title = library_string(&plug->library, record->title);
+    const char *artist = library_string(&plug->library, record->artist);
+    const char *label = GetFileName(path);
+    if (title[0])
+      label = TextFormat("%s - %s", artist[0] ? artist : "?", title);
+
+    Rectangle item_r = {browser_rec.x + 10, browser_rec.y + 60 + i * item_h,
+                        browser_rec.width - 20, item_h};
+    if (CheckCollisionPointRec(GetMousePosition(), item_r)) {
+      DrawRectangleRec(item_r, (Color){0x30, 0x30, 0x30, 0xFF});
+      if (IsMouseButtonPressed(MOUSE_LEFT_BUTTON)) {
+        plug->search_open = false;
+        pick_browser_file(path);
+        break;
+      }
+    }
+    DrawText(label, (int)item_r.x + 10, (int)item_r.y + 8, 18, WHITE);
+    draw_record_length(item_r, record);
+  }
+  EndScissorMode();
+}
+
 /**
  * @brief Draws the internal file browser with scroll and navigation.
  */
@@ -1249,81 +1432,86 @@ static void draw_internal_browser(void) {
 
   DrawRectangleRec(browser_rec, (Color){0x12, 0x12, 0x12, 0xFA});
   DrawRectangleLinesEx(browser_rec, 2, GRAY);
+  if (plug->search_open) {
+    DrawText(TextFormat("Library: %zu hits", plug->search_hit_count),
+             (int)browser_rec.x + 20, (int)browser_rec.y + 15, 20, SKYBLUE);
+    draw_library_hits(browser_rec);
+    return;
+  }
   DrawText(TextFormat("Browsing: %s", plug->current_dir),
            (int)browser_rec.x + 20, (int)browser_rec.y + 15, 20, SKYBLUE);
 
-  if (plug->dir_files.count == 0) {
-    plug->dir_files = LoadDirectoryFiles(plug->current_dir);
+  // The listing arrives from a helper thread; (re)request it if the shown
+  // one is for another directory (first open, or after hot reload)
+  Dir_Model *browser = &plug->browser;
+  dir_model_poll(browser);
+  if (!dir_model_loading(browser) &&
+      strcmp(browser->current.path, plug->current_dir) != 0)
+    dir_model_open(browser, plug->current_dir);
+  if (dir_model_loading(browser)) {
+    DrawText("Loading...", (int)browser_rec.x + 20, (int)browser_rec.y + 60,
+             18, GRAY);
+    if (IsKeyPressed(KEY_ESCAPE))
+      plug->show_browser = false;
+    return;
   }
 
+  float item_h = 35.0f;
+  int view_h = (int)browser_rec.height - 60;
+  int content_h = (int)(browser->current.count * item_h);
+
   if (CheckCollisionPointRec(GetMousePosition(), browser_rec)) {
     plug->browser_scroll += (int)(GetMouseWheelMove() * 35.0f);
   }
+  if (plug->browser_scroll < view_h - content_h)
+    plug->browser_scroll = view_h - content_h;
   if (plug->browser_scroll > 0)
     plug->browser_scroll = 0;
 
   if (IsKeyPressed(KEY_BACKSPACE)) {
     navigate_to_parent_dir();
+    return;
   }
 
-  float item_h = 35.0f;
-  int render_i = 0;
-
   BeginScissorMode((int)browser_rec.x, (int)browser_rec.y + 50,
-                   (int)browser_rec.width, (int)browser_rec.height - 60);
-
-  for (size_t i = 0; i < plug->dir_files.count; i++) {
-    const char *path = plug->dir_files.paths[i];
-    bool is_dir = DirectoryExists(path);
-    bool is_music =
-        IsFileExtension(path, ".mp3") || IsFileExtension(path, ".wav") ||
-        IsFileExtension(path, ".ogg") || IsFileExtension(path, ".flac");
-    if (!is_dir && !is_music)
-      continue;
-    const char *file_name = GetFileName(path);
-    if (file_name[0] == '.' && strcmp(file_name, "..") != 0)
-      continue;
+                   (int)browser_rec.width, view_h);
+
+  // Only the rows inside the view are laid out and drawn
+  size_t first = (size_t)(-plug->browser_scroll / item_h);
+  size_t last = first + (size_t)(view_h / item_h) + 2;
+  if (last > browser->current.count)
+    last = browser->current.count;
+
+  for (size_t i = first; i < last; i++) {
+    const Dir_Model_Entry *entry = &browser->current.entries[i];
     Rectangle item_r = {browser_rec.x + 10,
-                        browser_rec.y + 60 + (render_i * item_h) +
+                        browser_rec.y + 60 + (i * item_h) +
                             plug->browser_scroll,
                         browser_rec.width - 20, item_h};
-    render_i++;
 
     bool hovered = CheckCollisionPointRec(GetMousePosition(), item_r);
     if (hovered) {
       DrawRectangleRec(item_r, (Color){0x30, 0x30, 0x30, 0xFF});
       if (IsMouseButtonPressed(MOUSE_LEFT_BUTTON)) {
-        if (is_dir) {
-          const char *dir_name = GetFileName(path);
-          if (strcmp(dir_name, "..") == 0) {
-            navigate_to_parent_dir();
-          } else if (strcmp(dir_name, ".") != 0) {
-            snprintf(plug->current_dir, sizeof(plug->current_dir), "%s", path);
-            UnloadDirectoryFiles(plug->dir_files);
-            plug->dir_files = LoadDirectoryFiles(plug->current_dir);
-            plug->browser_scroll = 0;
-          }
+        if (entry->is_dir) {
+          enter_dir(entry->name);
           break;
         } else {
-          if (add_track_from_path(path)) {
-            if (!plug->has_music) {
-              // Primera canción: siempre reproducir
-              plug->has_music = true;
-              switch_track(0);
-            }
-            // Si ya hay música, simplemente agregar a la cola
-            // No cambiar automáticamente de track
-
-            plug->show_browser = false;
-          }
+          pick_browser_file(
+              TextFormat("%s/%s", plug->current_dir, entry->name));
         }
       }
     }
 
-    const char *label =
-        is_dir ? TextFormat("[DIR] %s", GetFileName(path)) : GetFileName(path);
-    DrawText(label, (int)item_r.x + 10, (int)item_r.y + 8, 18,
-             is_dir ? GOLD : WHITE);
+    DrawText(entry->label, (int)item_r.x + 10, (int)item_r.y + 8, 18,
+             entry->is_dir ? GOLD : WHITE);
+
+    /* Duration from the library index, for files it has seen */
+    if (!entry->is_dir)
+      draw_record_length(item_r,
+                         library_find(&plug->library,
+                                      TextFormat("%s/%s", plug->current_dir,
+                                                 entry->name)));
   }
   EndScissorMode();
 
@@ -1331,6 +1519,93 @@ static void draw_internal_browser(void) {
     plug->show_browser = false;
 }
 
+/**
+ * @brief Runs the query again if it or the index it runs against changed
+ */
+static void refresh_search(bool changed) {
+  Search_Source source = plug->show_browser ? SEARCH_LIBRARY : SEARCH_QUEUE;
+  unsigned revision =
+      atomic_load_explicit(&plug->search.revision, memory_order_relaxed);
+  if (!changed && source == plug->search_source &&
+      revision == plug->search_revision)
+    return;
+
+  plug->search_source = source;
+  plug->search_revision = revision;
+  plug->search_hit_count = search_query(
+      &plug->search, source, plug->search_text, plug->search_hits,
+      SEARCH_MAX_HITS, &plug->search_generation);
+}
+
+/**
+ * @brief Search box: '/' opens it over the browser (library) or the queue
+ * panel, typing narrows the list, ENTER picks the best hit, ESC closes it
+ *
+ * Runs after the panels are drawn, so keys it consumes (ESC, BACKSPACE)
+ * never reach the browser in the same frame.
+ */
+static void update_search(void) {
+  char *text = plug->search_text;
+  if (!plug->search_open) {
+    if (!plug->has_music || !IsKeyPressed(KEY_SLASH))
+      return;
+    while (GetCharPressed() > 0) {
+      // Drops the '/' itself
+    }
+    plug->search_open = true;
+    text[0] = '\0';
+    refresh_search(true);
+    return;
+  }
+
+  size_t len = strlen(text);
+  bool changed = false;
+  int codepoint;
+  while ((codepoint = GetCharPressed()) > 0) {
+    int size = 0;
+    const char *utf8 = CodepointToUTF8(codepoint, &size);
+    if (len + (size_t)size < SEARCH_QUERY_MAX) {
+      memcpy(&text[len], utf8, (size_t)size);
+      len += (size_t)size;
+      text[len] = '\0';
+      changed = true;
+    }
+  }
+  if ((IsKeyPressed(KEY_BACKSPACE) || IsKeyPressedRepeat(KEY_BACKSPACE)) &&
+      len > 0) {
+    do
+      len--;
+    while (len > 0 && (text[len] & 0xC0) == 0x80);
+    text[len] = '\0';
+    changed = true;
+  }
+  refresh_search(changed);
+
+  if (IsKeyPressed(KEY_ENTER) && plug->search_hit_count > 0) {
+    plug->search_open = false;
+    if (plug->search_source == SEARCH_QUEUE) {
+      switch_track((int)plug->search_hits[0].id);
+    } else if (library_hit(0)) {
+      pick_browser_file(
+          library_string(&plug->library, library_hit(0)->path));
+    }
+    return;
+  }
+  if (IsKeyPressed(KEY_ESCAPE)) {
+    plug->search_open = false;
+    return;
+  }
+
+  int w = GetRenderWidth();
+  Rectangle box = {w * 0.3f, 10.0f, w * 0.4f, 40.0f};
+  DrawRectangleRec(box, (Color){0x12, 0x12, 0x12, 0xF0});
+  DrawRectangleLinesEx(box, 2, SKYBLUE);
+  const char *scope =
+      plug->search_source == SEARCH_LIBRARY ? "Library" : "Queue";
+  DrawText(TextFormat("%s: %s_", scope, text), (int)box.x + 12,
+           (int)box.y + 10, 20, WHITE);
+}
+
 static void handle_file_inputs(void) {
   Vector2 mouse = GetMousePosition();
 
@@ -1339,13 +1614,11 @@ static void handle_file_inputs(void) {
       CheckCollisionPointRec(mouse, plug->ui_recs[FILE_UI_ICON]) &&
       IsMouseButtonPressed(MOUSE_BUTTON_LEFT);
 
-  if (IsKeyPressed(KEY_O) || icon_clicked) {
+  if (shortcut_pressed(KEY_O) || icon_clicked) {
     plug->show_browser = !plug->show_browser;
     if (plug->show_browser) {
-      // Clean up old list and force fresh reload from current_dir
-      if (plug->dir_files.count > 0)
-        UnloadDirectoryFiles(plug->dir_files);
-      plug->dir_files = LoadDirectoryFiles(plug->current_dir);
+      // Relists current_dir only if it changed on disk since last shown
+      dir_model_open(&plug->browser, plug->current_dir);
       plug->browser_scroll = 0;
     }
   }
@@ -1358,12 +1631,11 @@ static void handle_file_inputs(void) {
 static void handle_tiny_dialogs_open(void) {
   int w = GetRenderWidth();
   int h = GetRenderHeight();
-  const char *filters[] = {"*.wav", "*.ogg", "*.mp3", "*.flac"};
-  const char *path = NULL;
 
   // Logic for first-time load (empty state)
   if (!plug->has_music) {
-    if (IsMouseButtonPressed(MOUSE_LEFT_BUTTON)) {
+    bool dialog_open = file_dialog_busy(&plug->file_dialog);
+    if (IsMouseButtonPressed(MOUSE_LEFT_BUTTON) && !dialog_open) {
       const char *home = getenv("HOME");
       char default_dir[512] = "./"; // Fallback to current directory
 
@@ -1384,19 +1656,17 @@ static void handle_tiny_dialogs_open(void) {
         }
       }
 
-      path =
-          tinyfd_openFileDialog("Select Music", default_dir, ARRAY_LEN(filters),
-                                filters, "Music Files", 0);
-
-      if (add_track_from_path(path)) {
-        plug->has_music = true;
-        switch_track(0);
-      }
+      /* Returns at once; the selection arrives through
+       * collect_dialog_result() */
+      file_dialog_open(&plug->file_dialog, "Select Music", default_dir);
     } else {
       /* Draw central call-to-action message */
-      const char *msg = plug->error ? "Error: Could not load file"
-                                    : "Click to Select File\n(Or Drag & Drop)";
-      Color col = plug->error ? RED : WHITE;
+      const char *msg = "Click to Select File\n(Or Drag & Drop)";
+      if (dialog_open)
+        msg = "Waiting for File Selection...";
+      else if (plug->error)
+        msg = "Error: Could not load file";
+      Color col = plug->error && !dialog_open ? RED : WHITE;
       Vector2 size =
           MeasureTextEx(plug->font, msg, (float)plug->font.baseSize, 0);
       Vector2 pos = {(w - size.x) / 2.0f, (h - size.y) / 2.0f};
@@ -1407,6 +1677,51 @@ static void handle_tiny_dialogs_open(void) {
   }
 }
 
+/**
+ * @brief Hands the files picked in a closed file dialog to the importer,
+ * or saves the queue to the file picked in a save dialog
+ */
+static void collect_dialog_result(void) {
+  char *result;
+  if (!file_dialog_poll(&plug->file_dialog, &result) || !result)
+    return;
+
+  if (plug->file_dialog.save) {
+    /* Only the text is built here; the saver thread syncs it to disk */
+    size_t size;
+    char *text = playlist_file_build(&plug->playlist,
+                                     playlist_file_format(result), &size);
+    if (text &&
+        playlist_saver_submit(&plug->saver, result, text, size))
+      snprintf(plug->playlist_file, sizeof(plug->playlist_file), "%s",
+               result);
+    else
+      fprintf(stderr, "WARNING: could not save playlist %s\n", result);
+    free(result);
+    return;
+  }
+
+  const char separator[] = {FILE_DIALOG_SEPARATOR, '\0'};
+  char *paths[IMPORTER_MAX_ROOTS];
+  size_t count = 0, dropped = 0;
+  char *save = NULL;
+  for (char *path = strtok_r(result, separator, &save); path;
+       path = strtok_r(NULL, separator, &save)) {
+    if (playlist_file_format(path) != PLAYLIST_FILE_NONE)
+      load_playlist_file(path);
+    else if (count < ARRAY_LEN(paths))
+      paths[count++] = path;
+    else
+      dropped++;
+  }
+
+  dropped += count - importer_submit(&plug->importer, paths, count);
+  if (dropped > 0)
+    fprintf(stderr, "WARNING: import queue full, %zu paths dropped\n",
+            dropped);
+  free(result);
+}
+
 /**
  * @brief Unloads all assets from memory
  *
@@ -1415,7 +1730,7 @@ static void handle_tiny_dialogs_open(void) {
 
 static void unload_assets(void) {
   UnloadFont(plug->font);
-  UnloadShader(plug->circle);
+  UnloadShader(plug->bars_shader);
 
   for (Ui_Icon icon = 0; icon < COUNT_UI_ICONS; icon++) {
     UnloadTexture(plug->icons_textures[icon]);
@@ -1429,10 +1744,15 @@ static void unload_assets(void) {
  */
 void plug_post_reload(Plug *prev) {
   plug = prev;
-  if (plug->has_music) {
-    AttachAudioStreamProcessor(current_track()->music.stream, process_audio);
-  }
   load_assets();
+  analyzer_start(&plug->analyzer);
+  player_start(&plug->player, process_audio, on_track_switch, NULL);
+  importer_start(&plug->importer);
+  library_start(&plug->library);
+  search_start(&plug->search);
+  meta_start(&plug->meta, NULL);
+  session_start(&plug->session, NULL);
+  playlist_saver_start(&plug->saver);
 }
 
 /**
@@ -1441,14 +1761,203 @@ void plug_post_reload(Plug *prev) {
  * @return Pointer to plugin state to preserve
  */
 Plug *plug_pre_reload(void) {
-  if (plug->has_music) {
-    DetachAudioStreamProcessor(current_track()->music.stream, process_audio);
-  }
   unload_assets();
+  /* The dialog thread runs code of this library: wait for the user */
+  file_dialog_wait(&plug->file_dialog);
+  dir_model_wait(&plug->browser);
+  library_stop(&plug->library);
+  search_stop(&plug->search);
+  meta_stop(&plug->meta);
+  session_stop(&plug->session);
+  playlist_saver_stop(&plug->saver);
+  importer_stop(&plug->importer);
+  player_stop(&plug->player);
+  analyzer_stop(&plug->analyzer);
+  fft_plan_cache_clear();
 
   return plug;
 }
 
+/**
+ * @brief Reads per-deployment analyzer settings from the environment
+ *
+ * MUSUALIZER_FFT_SIZE, MUSUALIZER_BARS and MUSUALIZER_WINDOW (Hann, Hamming,
+ * Blackman-Harris or Rectangular) override the defaults; invalid values are
+ * clamped or ignored.
+ */
+static Analyzer_Config analyzer_config_from_env(void) {
+  Analyzer_Config cfg = analyzer_default_config();
+  const char *value;
+
+  if ((value = getenv("MUSUALIZER_FFT_SIZE")))
+    cfg.fft_size = (unsigned)strtoul(value, NULL, 10);
+  if ((value = getenv("MUSUALIZER_BARS")))
+    cfg.bars = (unsigned)strtoul(value, NULL, 10);
+  if ((value = getenv("MUSUALIZER_WINDOW")) &&
+      !fft_window_parse(value, &cfg.window))
+    fprintf(stderr, "WARNING: unknown MUSUALIZER_WINDOW '%s'\n", value);
+  return cfg;
+}
+
+/**
+ * @brief Hands the mapped library to the search thread for indexing
+ */
+static void share_library_with_search(void) {
+  Library_View view;
+  if (library_view_share(&plug->library.view, &view))
+    search_set_library(&plug->search, view, plug->library.generation_seen);
+}
+
+/**
+ * @brief Path of name under the musualizer cache directory
+ *
+ * $XDG_CACHE_HOME/musualizer, or ~/.cache/musualizer.
+ *
+ * @return false without a home directory
+ */
+static bool cache_path(char *out, size_t size, const char *name) {
+  const char *home = getenv("HOME");
+  const char *cache = getenv("XDG_CACHE_HOME");
+  if (cache && cache[0])
+    snprintf(out, size, "%s/musualizer/%s", cache, name);
+  else if (home)
+    snprintf(out, size, "%s/.cache/musualizer/%s", home, name);
+  else
+    return false;
+  return true;
+}
+
+/**
+ * @brief Path of name under the musualizer state directory
+ *
+ * $XDG_STATE_HOME/musualizer, or ~/.local/state/musualizer.
+ *
+ * @return false without a home directory
+ */
+static bool state_path(char *out, size_t size, const char *name) {
+  const char *home = getenv("HOME");
+  const char *state = getenv("XDG_STATE_HOME");
+  if (state && state[0])
+    snprintf(out, size, "%s/musualizer/%s", state, name);
+  else if (home)
+    snprintf(out, size, "%s/.local/state/musualizer/%s", home, name);
+  else
+    return false;
+  return true;
+}
+
+/**
+ * @brief Snapshots the session and hands it to the writer thread
+ */
+static void save_session(void) {
+  Session_State state;
+  memset(&state, 0, sizeof(state));
+  float played, length;
+  state.current_track = plug->has_music ? plug->current_track : -1;
+  if (plug->has_music && player_position(&plug->player, &played, &length))
+    state.position = played;
+  state.volume = (float)plug->master_vol;
+  state.volume_saved = (float)plug->volume_saved;
+  state.queue_scroll = plug->queue_scroll;
+  state.queue_order = plug->queue_order;
+  state.analyzer_mode = plug->analyzer_mode;
+  state.paused = plug->paused;
+  state.fullscreen = plug->fullscreen;
+  state.show_browser = plug->show_browser;
+  snprintf(state.current_dir, sizeof(state.current_dir), "%s",
+           plug->current_dir);
+  snprintf(state.playlist_file, sizeof(state.playlist_file), "%s",
+           plug->playlist_file);
+
+  size_t size;
+  void *snapshot = session_build(&state, &plug->playlist, &size);
+  if (snapshot)
+    session_submit(&plug->session, snapshot, size);
+  plug->session_saved_at = GetTime();
+}
+
+/**
+ * @brief Brings back the session saved last, playing from where it was
+ *
+ * Nothing is probed: the tracks come back with what was known of them, and
+ * only the one playing is opened, by the player.
+ */
+static void restore_session(const char *file) {
+  Session_State state;
+  if (!session_load(file, &state, &plug->playlist))
+    return;
+  for (uint32_t id = 0; id < plug->playlist.count; id++)
+    index_track(id);
+
+  if (state.volume >= 0.0f && state.volume <= 1.0f)
+    plug->master_vol = state.volume;
+  if (state.volume_saved >= 0.0f && state.volume_saved <= 1.0f)
+    plug->volume_saved = state.volume_saved;
+  plug->volume_slider.value = (float)plug->master_vol;
+  plug->volume_level =
+      (plug->master_vol <= 0.01f) ? 0 : (plug->master_vol <= 0.65f ? 1 : 2);
+  send_player_command(PLAYER_CMD_VOLUME, plug->master_vol);
+
+  if (state.queue_order <= PLAYLIST_BY_ADDED)
+    plug->queue_order = state.queue_order;
+  plug->queue_scroll = state.queue_scroll;
+  if (state.analyzer_mode < COUNT_ANALYZER_MODES) {
+    plug->analyzer_mode = state.analyzer_mode;
+    analyzer_set_mode(&plug->analyzer, plug->analyzer_mode);
+  }
+  plug->fullscreen = state.fullscreen;
+  if (state.current_dir[0])
+    snprintf(plug->current_dir, sizeof(plug->current_dir), "%s",
+             state.current_dir);
+  snprintf(plug->playlist_file, sizeof(plug->playlist_file), "%s",
+           state.playlist_file);
+  if (state.show_browser) {
+    plug->show_browser = true;
+    dir_model_open(&plug->browser, plug->current_dir);
+  }
+
+  if (state.current_track >= 0) {
+    switch_track(state.current_track);
+    /* The feeder runs commands in order: it opens, seeks, then pauses */
+    if (state.position > 0.0f)
+      send_player_command(PLAYER_CMD_SEEK, state.position);
+    if (state.paused) {
+      send_player_command(PLAYER_CMD_PAUSE, 0.0f);
+      plug->paused = true;
+    }
+  }
+}
+
+/**
+ * @brief Points the library at its roots and its index file
+ *
+ * MUSUALIZER_LIBRARY lists the roots separated by ':' (default ~/Music and
+ * ~/Musica). The index lives in $XDG_CACHE_HOME/musualizer, or
+ * ~/.cache/musualizer.
+ */
+static void library_configure_from_env(void) {
+  const char *home = getenv("HOME");
+  char index_path[512];
+  if (!cache_path(index_path, sizeof(index_path), "library.idx"))
+    return;
+
+  char list[4096];
+  const char *value = getenv("MUSUALIZER_LIBRARY");
+  if (value)
+    snprintf(list, sizeof(list), "%s", value);
+  else
+    snprintf(list, sizeof(list), "%s/Music:%s/Musica", home ? home : ".",
+             home ? home : ".");
+
+  char *roots[LIBRARY_MAX_ROOTS];
+  size_t count = 0;
+  char *save = NULL;
+  for (char *root = strtok_r(list, ":", &save);
+       root && count < LIBRARY_MAX_ROOTS; root = strtok_r(NULL, ":", &save))
+    roots[count++] = root;
+  library_configure(&plug->library, index_path, roots, count);
+}
+
 /**
  * @brief Initializes plugin state and resources
  *
@@ -1469,13 +1978,16 @@ void plug_init(void) {
   plug->mouse_active = false;
   plug->last_mouse_move_time = -100.0f;
   plug->volume_level = 1;
-  plug->sample_write = 0;
   plug->master_vol = 0.5f;
   plug->volume_saved = 0;
-  plug->window_ready = false;
-
-  plug->bass_history = 0.0f;
-  plug->overall_level = 0.5f;
+  plug->queued_track = -1;
+  plug->queue_order = PLAYLIST_BY_ADDED;
+  const char *crossfade = getenv("MUSUALIZER_CROSSFADE");
+  plug->crossfade = crossfade ? strtof(crossfade, NULL) : 0.0f;
+  if (!(plug->crossfade >= 0.0f))
+    plug->crossfade = 0.0f;
+  if (plug->crossfade > PLAYER_MAX_CROSSFADE)
+    plug->crossfade = PLAYER_MAX_CROSSFADE;
   const char *home = getenv("HOME");
   if (home) {
     snprintf(plug->current_dir, sizeof(plug->current_dir), "%s/Musica", home);
@@ -1483,11 +1995,46 @@ void plug_init(void) {
     strcpy(plug->current_dir, "."); // Fallback to current directory
   }
   /* Initialize audio processing buffers */
-  memset(plug->samples, 0, sizeof(plug->samples));
-  memset(plug->bars, 0, sizeof(plug->bars));
   memset(&plug->volume_slider, 0, sizeof(plug->volume_slider));
   memset(plug->smear, 0, sizeof(plug->smear));
-  memset(plug->spectrum, 0, sizeof(plug->spectrum));
+  analyzer_configure(&plug->analyzer, analyzer_config_from_env());
+  const char *hop = getenv("MUSUALIZER_HOP");
+  if (hop)
+    analyzer_set_hop(&plug->analyzer, (unsigned)strtoul(hop, NULL, 10));
+  if (!analyzer_start(&plug->analyzer)) {
+    fprintf(stderr, "ERROR: could not start the analyzer thread\n");
+  }
+  send_player_command(PLAYER_CMD_VOLUME, plug->master_vol);
+  send_player_command(PLAYER_CMD_CROSSFADE, plug->crossfade);
+  if (!player_start(&plug->player, process_audio, on_track_switch, NULL)) {
+    fprintf(stderr, "ERROR: could not start the audio feeder thread\n");
+  }
+  if (!importer_start(&plug->importer)) {
+    fprintf(stderr, "ERROR: could not start the import threads\n");
+  }
+  if (!search_start(&plug->search)) {
+    fprintf(stderr, "ERROR: could not start the search thread\n");
+  }
+  char thumbs[512];
+  if (!meta_start(&plug->meta, cache_path(thumbs, sizeof(thumbs), "thumbs")
+                                   ? thumbs
+                                   : NULL)) {
+    fprintf(stderr, "ERROR: could not start the tag reading threads\n");
+  }
+  library_configure_from_env();
+  share_library_with_search();
+  if (!library_start(&plug->library)) {
+    fprintf(stderr, "WARNING: the music library is not kept up to date\n");
+  }
+  char session[512];
+  if (state_path(session, sizeof(session), "session")) {
+    restore_session(session);
+    if (!session_start(&plug->session, session))
+      fprintf(stderr, "WARNING: the session will not be saved\n");
+  }
+  if (!playlist_saver_start(&plug->saver)) {
+    fprintf(stderr, "WARNING: playlists will be saved on the UI thread\n");
+  }
   SetMasterVolume(plug->master_vol);
   SetTargetFPS(60);
 }
@@ -1496,38 +2043,64 @@ void plug_init(void) {
  * @brief Main update loop - called every frame
  *
  * Handles:
- * - Music stream updates
  * - File dialog for initial load
  * - Input processing
- * - Audio visualization
  * - Rendering all UI elements
+ *
+ * Decoding runs on the player thread and analysis on the analyzer thread,
+ * so a slow frame never starves the audio stream.
  */
 void plug_update(void) {
-  /* Update audio stream */
-  if (plug->has_music && !plug->paused) {
-    UpdateMusicStream(current_track()->music);
-  }
-
   /* Process input and state updates */
   handle_tiny_dialogs_open();
+  collect_dialog_result();
   update_mouse_state();
   handle_input();
   handle_file_drop();
+  importer_collect(&plug->importer, import_track, NULL);
+  meta_update(&plug->meta);
+  if (library_poll(&plug->library))
+    share_library_with_search();
   next_track_in_queue();
+  if (GetTime() - plug->session_saved_at >= SESSION_SAVE_INTERVAL)
+    save_session();
 
   handle_file_inputs();
   /* Render frame */
   BeginDrawing();
   ClearBackground((Color){0x18, 0x18, 0x18, 0xFF});
 
-  update_visualizer();
   draw_queue();
 
   draw_progress();
   draw_bars();
+  draw_import_progress();
   draw_ui_bar();
   draw_volume_slider();
 
   draw_internal_browser();
+  update_search();
   EndDrawing();
 }
+
+/**
+ * @brief Stops the background threads before the audio device is closed
+ */
+void plug_shutdown(void) {
+  /* Last snapshot, while the player still knows the position */
+  save_session();
+  session_free(&plug->session);
+  playlist_saver_free(&plug->saver);
+  /* Executed before the feeder exits: closes the open streams */
+  importer_stop(&plug->importer);
+  library_close(&plug->library);
+  search_free(&plug->search);
+  meta_free(&plug->meta);
+  queue_metrics_free(&plug->queue_metrics);
+  dir_model_free(&plug->browser);
+  send_player_command(PLAYER_CMD_STOP, 0.0f);
+  player_stop(&plug->player);
+  analyzer_stop(&plug->analyzer);
+  /* The player held paths into the playlist until now */
+  playlist_free(&plug->playlist);
+}
@@ -10,7 +10,8 @@
   PLUG(plug_post_reload, void, void *)                                         \
   PLUG(plug_load_resource, void *, const char *, size_t *)                     \
   PLUG(plug_free_resource, void, void *)                                       \
-  PLUG(plug_update, void, void)
+  PLUG(plug_update, void, void)                                                \
+  PLUG(plug_shutdown, void, void)
 
 #define PLUG(name, ret, ...) typedef ret(name##_t)(__VA_ARGS__);
 LIST_OF_PLUGS
@@ -0,0 +1,200 @@
+/**
+ * @file queue_bench.c
+ * @brief Correctness check and per-frame cost of the queue panel layout
+ *
+ * Builds synthetic playlists of 10 to 1,000,000 tracks and scrolls through
+ * them the way the queue panel does. The check compares the visible range
+ * and the row under the mouse (queue_view.c) against the per-row loop the
+ * panel used before: every row's position computed, offscreen rows
+ * skipped, and each row hit-tested. The benchmark times both per frame,
+ * with a text measure that costs what raylib's MeasureTextEx() does (a
+ * linear glyph lookup per character): the old loop measures every visible
+ * row every frame, the new one only rows not measured before.
+ */
+#include <math.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "queue_view.h"
+
+#define BENCH_FONT_SIZE 24.0f
+#define BENCH_GLYPHS 95    ///< Printable ASCII, as in raylib's default font
+#define BENCH_FRAMES 2000  ///< Frames timed per playlist
+#define BENCH_CHECKS 20000 ///< Scroll offsets checked per playlist
+#define BENCH_NAME_MAX 64
+
+/// The panel of a 1080-pixel-high window
+static const Queue_Layout layout = {.top = 10.0f,
+                                    .row_height = 50.0f,
+                                    .row_spacing = 10.0f,
+                                    .height = 930.0f};
+
+static int glyph_codepoints[BENCH_GLYPHS];
+static float glyph_advances[BENCH_GLYPHS];
+
+static char *names;     ///< BENCH_NAME_MAX bytes per track
+static size_t measures; ///< Calls to measure()
+static double sink_sum; ///< Keeps the compiler from dropping the work
+
+/**
+ * @brief Text width the way raylib finds it: each character's glyph is
+ * looked up by a linear search over the font
+ */
+static float measure(void *user, size_t track) {
+  (void)user;
+  measures++;
+  float width = 0;
+  for (const char *c = &names[track * BENCH_NAME_MAX]; *c; c++) {
+    int glyph = 0;
+    for (int g = 0; g < BENCH_GLYPHS; g++)
+      if (glyph_codepoints[g] == *c) {
+        glyph = g;
+        break;
+      }
+    width += glyph_advances[glyph] * BENCH_FONT_SIZE / 32;
+  }
+  return width;
+}
+
+static void make_playlist(size_t count) {
+  names = malloc(count * BENCH_NAME_MAX);
+  if (!names) {
+    fprintf(stderr, "out of memory\n");
+    exit(1);
+  }
+  for (size_t i = 0; i < count; i++)
+    snprintf(&names[i * BENCH_NAME_MAX], BENCH_NAME_MAX,
+             "Artist %zu - A Fairly Long Track Title %zu", i % 997, i);
+}
+
+/**
+ * @brief Scroll offset of frame, sweeping the whole list and back
+ */
+static double sweep(size_t frame, size_t frames, size_t rows) {
+  double bottom = queue_clamp_scroll(&layout, -INFINITY, rows);
+  double t = (double)frame / (double)frames * 2;
+  return bottom * (t < 1 ? t : 2 - t);
+}
+
+/// Row hit test of the old loop (CheckCollisionPointRec on the row)
+static bool row_contains(float y_pos, float y) {
+  return y >= y_pos && y <= y_pos + layout.row_height;
+}
+
+/**
+ * @brief Visits the rows as the panel did before: all of them
+ */
+static void old_frame(size_t rows, float scroll, float mouse_y) {
+  for (size_t row = 0; row < rows; row++) {
+    float y_pos = row * (layout.row_height + layout.row_spacing) + scroll +
+                  layout.top;
+    if (y_pos + layout.row_height < 0 || y_pos > layout.height)
+      continue;
+    bool hover = row_contains(y_pos, mouse_y);
+    sink_sum += measure(NULL, row) + hover;
+  }
+}
+
+static void new_frame(Queue_Metrics *metrics, size_t rows, double scroll,
+                      float mouse_y) {
+  size_t hover = queue_row_at(&layout, scroll, rows, mouse_y);
+  Queue_Range visible = queue_visible(&layout, scroll, rows);
+  for (size_t row = visible.first; row < visible.end; row++)
+    sink_sum += queue_text_width(metrics, row, 1, BENCH_FONT_SIZE, measure,
+                                 NULL) +
+                (row == hover);
+}
+
+/**
+ * @brief Compares the range and the hovered row with the old loop
+ */
+static bool check(size_t rows) {
+  size_t mismatches = 0;
+  srand(1);
+  for (size_t k = 0; k < BENCH_CHECKS; k++) {
+    double bottom = queue_clamp_scroll(&layout, -INFINITY, rows);
+    double scroll = bottom * (double)rand() / (double)RAND_MAX;
+    if (k % 7 == 0) /* Offsets that put row edges on the panel edges */
+      scroll = -round(-scroll / 60.0) * 60.0;
+    float mouse_y = layout.height * (float)rand() / (float)RAND_MAX;
+
+    Queue_Range visible = queue_visible(&layout, scroll, rows);
+    size_t hover = queue_row_at(&layout, scroll, rows, mouse_y);
+    size_t first = rows, end = 0, old_hover = QUEUE_NO_ROW;
+    /* Only the rows around the window can differ */
+    size_t from = visible.first > 2 ? visible.first - 2 : 0;
+    size_t to = visible.end + 2 < rows ? visible.end + 2 : rows;
+    for (size_t row = from; row < to; row++) {
+      /* In double: the float positions of the old loop were off by a few
+       * pixels that far down */
+      double y_pos = (double)row * (layout.row_height + layout.row_spacing) +
+                     scroll + layout.top;
+      if (y_pos + layout.row_height < 0 || y_pos > layout.height)
+        continue;
+      if (first == rows)
+        first = row;
+      end = row + 1;
+      if (mouse_y >= y_pos && mouse_y <= y_pos + layout.row_height)
+        old_hover = row;
+    }
+    if (first == rows)
+      first = end = 0;
+    /* Zero-height slivers at the edges may go either way */
+    bool range_ok = (visible.first == first || visible.first == first + 1) &&
+                    (visible.end == end || visible.end + 1 == end);
+    if (!range_ok || hover != old_hover)
+      mismatches++;
+  }
+  return mismatches == 0;
+}
+
+static double now_seconds(void) {
+  struct timespec t;
+  clock_gettime(CLOCK_MONOTONIC, &t);
+  return t.tv_sec + t.tv_nsec * 1e-9;
+}
+
+int main(void) {
+  for (int g = 0; g < BENCH_GLYPHS; g++) {
+    glyph_codepoints[g] = ' ' + g;
+    glyph_advances[g] = 12.0f + (float)(g % 7);
+  }
+
+  static const size_t sizes[] = {10, 1000, 100000, 1000000};
+  bool ok = true;
+  printf("Queue layout (%d frames scrolling the whole list and back):\n",
+         BENCH_FRAMES);
+  printf("  %9s  %14s  %14s  %10s  %s\n", "tracks", "old us/frame",
+         "new us/frame", "measures", "check");
+  for (size_t s = 0; s < sizeof(sizes) / sizeof(*sizes); s++) {
+    size_t rows = sizes[s];
+    make_playlist(rows);
+    bool checked = check(rows);
+    ok &= checked;
+
+    /* The old loop is O(tracks): fewer frames keep large lists quick */
+    size_t old_frames = rows > 100000 ? BENCH_FRAMES / 10 : BENCH_FRAMES;
+    double start = now_seconds();
+    for (size_t f = 0; f < old_frames; f++)
+      old_frame(rows, (float)sweep(f, old_frames, rows), layout.height / 2);
+    double old_us = (now_seconds() - start) * 1e6 / old_frames;
+
+    Queue_Metrics metrics = {0};
+    measures = 0;
+    start = now_seconds();
+    for (size_t f = 0; f < BENCH_FRAMES; f++)
+      new_frame(&metrics, rows, sweep(f, BENCH_FRAMES, rows),
+                layout.height / 2);
+    double new_us = (now_seconds() - start) * 1e6 / BENCH_FRAMES;
+    printf("  %9zu  %14.2f  %14.2f  %10zu  %s\n", rows, old_us, new_us,
+           measures, checked ? "OK" : "FAIL");
+
+    queue_metrics_free(&metrics);
+    free(names);
+  }
+  printf("  (checksum %g)\n", sink_sum);
+  return ok ? 0 : 1;
+}
@@ -0,0 +1,110 @@
+/**
+ * @file queue_view.c
+ * @brief Visible row range, hit testing and text width cache of the queue
+ */
+#include "queue_view.h"
+
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+
+/*
+ * The scroll offset and positions are kept in double: a million rows are
+ * 60 million pixels tall, where a float is only good to a few pixels.
+ */
+
+/// Distance from one row to the next
+static double row_pitch(const Queue_Layout *layout) {
+  return (double)layout->row_height + layout->row_spacing;
+}
+
+float queue_row_y(const Queue_Layout *layout, double scroll, size_t row) {
+  return (float)(layout->top + scroll + (double)row * row_pitch(layout));
+}
+
+double queue_clamp_scroll(const Queue_Layout *layout, double scroll,
+                          size_t rows) {
+  double content_height = (double)rows * row_pitch(layout);
+  double min_scroll = content_height > layout->height
+                          ? layout->height - content_height - 2 * layout->top
+                          : 0.0;
+  if (scroll < min_scroll)
+    scroll = min_scroll;
+  if (scroll > 0)
+    scroll = 0;
+  return scroll;
+}
+
+Queue_Range queue_visible(const Queue_Layout *layout, double scroll,
+                          size_t rows) {
+  double pitch = row_pitch(layout);
+  double offset = layout->top + scroll;
+  /* Rows before first end above the panel, rows from end start below it */
+  double first = floor((-offset - layout->row_height) / pitch) + 1;
+  double end = floor((layout->height - offset) / pitch) + 1;
+  Queue_Range range = {0, 0};
+  if (end <= 0 || rows == 0)
+    return range;
+  range.first = first < 0 ? 0 : (size_t)first;
+  range.end = end > (double)rows ? rows : (size_t)end;
+  if (range.first > range.end)
+    range.first = range.end;
+  return range;
+}
+
+size_t queue_row_at(const Queue_Layout *layout, double scroll, size_t rows,
+                    float y) {
+  if (y < 0 || y > layout->height)
+    return QUEUE_NO_ROW;
+  double offset = (double)y - layout->top - scroll;
+  if (offset < 0)
+    return QUEUE_NO_ROW;
+  double pitch = row_pitch(layout);
+  double row = floor(offset / pitch);
+  if (row >= (double)rows || offset - row * pitch > layout->row_height)
+    return QUEUE_NO_ROW;
+  return (size_t)row;
+}
+
+/**
+ * @brief Makes room for track, zeroing the new items
+ */
+static Queue_Text *text_at(Queue_Metrics *metrics, size_t track) {
+  if (track >= metrics->capacity) {
+    size_t capacity = metrics->capacity ? metrics->capacity : 256;
+    while (capacity <= track)
+      capacity *= 2;
+    Queue_Text *items = realloc(metrics->items, capacity * sizeof(*items));
+    if (!items)
+      return NULL;
+    memset(items + metrics->capacity, 0,
+           (capacity - metrics->capacity) * sizeof(*items));
+    metrics->items = items;
+    metrics->capacity = capacity;
+  }
+  if (track >= metrics->count)
+    metrics->count = track + 1;
+  return &metrics->items[track];
+}
+
+float queue_text_width(Queue_Metrics *metrics, size_t track, uint32_t key,
+                       float font_size, Queue_Measure *measure, void *user) {
+  if (metrics->font_size != font_size) {
+    if (metrics->items)
+      memset(metrics->items, 0, metrics->count * sizeof(*metrics->items));
+    metrics->font_size = font_size;
+  }
+  Queue_Text *text = text_at(metrics, track);
+  if (!text)
+    return measure(user, track);
+  if (text->key != key) {
+    text->width = measure(user, track);
+    text->key = key;
+  }
+  return text->width;
+}
+
+void queue_metrics_free(Queue_Metrics *metrics) {
+  free(metrics->items);
+  memset(metrics, 0, sizeof(*metrics));
+}
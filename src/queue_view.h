@@ -0,0 +1,111 @@
+/**
+ * @file queue_view.h
+ * @brief Row layout and cached text widths of the queue panel
+ *
+ * The queue panel is a list of equal rows, so the rows on screen follow
+ * from the scroll offset by division, and so does the row under the mouse.
+ * Drawing a frame then costs the visible rows only, however long the
+ * playlist is.
+ *
+ * Text widths are cached per track, since measuring a string walks its
+ * glyphs. A width is kept together with a caller-chosen key naming the
+ * text it was measured for (e.g. file name or tags), so a track whose text
+ * changes is measured again; a new font size drops every width.
+ *
+ * Nothing here depends on raylib, so the bench tool (queue_bench.c) runs
+ * the same code the panel does.
+ */
+#ifndef QUEUE_VIEW_H_
+#define QUEUE_VIEW_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+/// queue_row_at() result when no row is under the point
+#define QUEUE_NO_ROW SIZE_MAX
+
+/**
+ * @struct Queue_Layout
+ * @brief Geometry of the list
+ */
+typedef struct {
+  float top;         ///< Gap above the first row
+  float row_height;  ///< Height of a row
+  float row_spacing; ///< Gap below each row
+  float height;      ///< Visible height of the panel
+} Queue_Layout;
+
+/**
+ * @struct Queue_Range
+ * @brief Rows first .. end - 1
+ */
+typedef struct {
+  size_t first;
+  size_t end;
+} Queue_Range;
+
+/**
+ * @struct Queue_Text
+ * @brief Cached width of one track's text
+ */
+typedef struct {
+  float width;  ///< Width at Queue_Metrics::font_size
+  uint32_t key; ///< Text measured, 0 if none yet
+} Queue_Text;
+
+/**
+ * @struct Queue_Metrics
+ * @brief Text widths by track index
+ */
+typedef struct {
+  Queue_Text *items; ///< Zeroed when grown
+  size_t count;
+  size_t capacity;
+  float font_size; ///< Size the widths were measured at
+} Queue_Metrics;
+
+/**
+ * @brief Measures the text of a track
+ */
+typedef float Queue_Measure(void *user, size_t track);
+
+/**
+ * @brief Top of row on screen
+ */
+float queue_row_y(const Queue_Layout *layout, double scroll, size_t row);
+
+/**
+ * @brief Scroll offset kept within the list (offsets are 0 or negative)
+ */
+double queue_clamp_scroll(const Queue_Layout *layout, double scroll,
+                          size_t rows);
+
+/**
+ * @brief Rows that intersect the panel
+ */
+Queue_Range queue_visible(const Queue_Layout *layout, double scroll,
+                          size_t rows);
+
+/**
+ * @brief Row under the panel coordinate y, or QUEUE_NO_ROW (also in the
+ *        gaps between rows)
+ */
+size_t queue_row_at(const Queue_Layout *layout, double scroll, size_t rows,
+                    float y);
+
+/**
+ * @brief Width of the text of track, measured only if not cached
+ *
+ * @param key Nonzero id of the text the caller shows for track; a
+ *        different key than last time measures again
+ * @return Width, or from measure() directly if the cache cannot grow
+ */
+float queue_text_width(Queue_Metrics *metrics, size_t track, uint32_t key,
+                       float font_size, Queue_Measure *measure, void *user);
+
+/**
+ * @brief Frees the cached widths
+ */
+void queue_metrics_free(Queue_Metrics *metrics);
+
+#endif // QUEUE_VIEW_H_
@@ -0,0 +1,183 @@
+/**
+ * @file ring.c
+ * @brief Seqlock-style ring buffer: the producer publishes claim/write
+ * sequences around each write, readers validate their copy afterwards
+ */
+#include "ring.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+#define RING_MAX_RETRIES 4 ///< Attempts per read before giving up
+
+bool ring_init(Ring *r, size_t capacity) {
+  if (capacity == 0 || (capacity & (capacity - 1)) != 0)
+    return false;
+
+  r->data = calloc(capacity, sizeof(*r->data));
+  if (!r->data)
+    return false;
+
+  r->capacity = capacity;
+  r->mask = capacity - 1;
+  atomic_store(&r->claim_seq, 0);
+  atomic_store(&r->write_seq, 0);
+  return true;
+}
+
+void ring_free(Ring *r) {
+  free(r->data);
+  r->data = NULL;
+  r->capacity = 0;
+  r->mask = 0;
+}
+
+void ring_write_begin(Ring *r, size_t n, Ring_Span spans[2]) {
+  uint64_t seq = atomic_load_explicit(&r->write_seq, memory_order_relaxed);
+
+  /* Announce the slots we are about to overwrite before touching them */
+  atomic_store_explicit(&r->claim_seq, seq + n, memory_order_relaxed);
+  atomic_thread_fence(memory_order_release);
+
+  size_t from = (size_t)seq & r->mask;
+  size_t first = r->capacity - from;
+  if (first > n)
+    first = n;
+  spans[0] = (Ring_Span){r->data + from, first};
+  spans[1] = (Ring_Span){r->data, n - first};
+}
+
+void ring_write_end(Ring *r, size_t n) {
+  uint64_t seq = atomic_load_explicit(&r->write_seq, memory_order_relaxed);
+  atomic_store_explicit(&r->write_seq, seq + n, memory_order_release);
+}
+
+void ring_write_strided(Ring *r, const float src[], size_t n, size_t stride) {
+  Ring_Span spans[2];
+  ring_write_begin(r, n, spans);
+
+  for (size_t s = 0; s < 2; s++) {
+    for (size_t i = 0; i < spans[s].count; i++)
+      spans[s].data[i] = src[i * stride];
+    src += spans[s].count * stride;
+  }
+
+  ring_write_end(r, n);
+}
+
+void ring_clear(Ring *r) {
+  uint64_t seq = atomic_load_explicit(&r->write_seq, memory_order_relaxed);
+  atomic_store_explicit(&r->claim_seq, seq + r->capacity,
+                        memory_order_relaxed);
+  atomic_thread_fence(memory_order_release);
+  memset(r->data, 0, r->capacity * sizeof(*r->data));
+  atomic_store_explicit(&r->write_seq, seq + r->capacity,
+                        memory_order_release);
+}
+
+/**
+ * @brief Copies [start, start + n) into dst as at most two contiguous runs
+ */
+static void copy_range(const Ring *r, float dst[], uint64_t start, size_t n) {
+  size_t from = (size_t)start & r->mask;
+  size_t first = r->capacity - from;
+  if (first > n)
+    first = n;
+  memcpy(dst, r->data + from, first * sizeof(*dst));
+  memcpy(dst + first, r->data, (n - first) * sizeof(*dst));
+}
+
+/**
+ * @brief How far the producer has claimed past start, checked after a copy
+ *
+ * The slot of sequence s is reused by sequence s + capacity, so a copy that
+ * began at start is intact iff the returned distance is <= capacity.
+ */
+static uint64_t claimed_since(const Ring *r, uint64_t start) {
+  atomic_thread_fence(memory_order_acquire);
+  uint64_t claim =
+      atomic_load_explicit(&((Ring *)r)->claim_seq, memory_order_relaxed);
+  return claim - start;
+}
+
+/**
+ * @brief Copies the n samples ending at end and validates the copy
+ */
+static bool copy_window(const Ring *r, float dst[], uint64_t end, size_t n) {
+  uint64_t start = 0;
+  size_t pad = 0;
+  if (end < n) {
+    /* Not enough history yet: pad the front with silence */
+    pad = n - (size_t)end;
+    memset(dst, 0, pad * sizeof(*dst));
+  } else {
+    start = end - n;
+  }
+
+  copy_range(r, dst + pad, start, n - pad);
+  return claimed_since(r, start) <= r->capacity;
+}
+
+bool ring_read_latest(const Ring *r, float dst[], size_t n, Ring_Reader *rd,
+                      uint64_t *end_seq) {
+  if (n > r->capacity)
+    return false;
+
+  for (int attempt = 0; attempt < RING_MAX_RETRIES; attempt++) {
+    uint64_t end = ring_write_seq(r);
+    if (copy_window(r, dst, end, n)) {
+      if (end_seq)
+        *end_seq = end;
+      return true;
+    }
+    rd->overruns++;
+  }
+  return false;
+}
+
+bool ring_read_at(const Ring *r, float dst[], uint64_t end, size_t n,
+                  Ring_Reader *rd) {
+  if (n > r->capacity || ring_write_seq(r) < end)
+    return false;
+  if (copy_window(r, dst, end, n))
+    return true;
+  rd->overruns++;
+  return false;
+}
+
+size_t ring_read(const Ring *r, Ring_Reader *rd, float dst[], size_t max) {
+  for (int attempt = 0; attempt < RING_MAX_RETRIES; attempt++) {
+    uint64_t end = ring_write_seq(r);
+
+    /* Lapped before we even started. The oldest intact sample is the next
+     * one overwritten, so skip to half a ring back instead: that leaves the
+     * reader room to copy before the producer catches up again */
+    if (end - rd->read_seq > r->capacity) {
+      uint64_t resync = end - r->capacity / 2;
+      rd->overruns++;
+      rd->dropped += resync - rd->read_seq;
+      rd->read_seq = resync;
+    }
+
+    size_t n = (size_t)(end - rd->read_seq);
+    if (n > max)
+      n = max;
+    if (n == 0)
+      return 0;
+
+    copy_range(r, dst, rd->read_seq, n);
+    uint64_t claimed = claimed_since(r, rd->read_seq);
+    if (claimed <= r->capacity) {
+      rd->read_seq += n;
+      return n;
+    }
+
+    /* Lapped mid-copy: skip everything the producer may have overwritten,
+     * again with half a ring of headroom */
+    uint64_t skip = claimed - r->capacity / 2;
+    rd->overruns++;
+    rd->dropped += skip;
+    rd->read_seq += skip;
+  }
+  return 0;
+}
@@ -0,0 +1,155 @@
+/**
+ * @file ring.h
+ * @brief Single-producer ring buffer of float samples with overrun detection
+ *
+ * The producer (normally the audio callback) never blocks and never waits
+ * for readers; it simply overwrites the oldest samples. Every sample has a
+ * 64-bit sequence number, so readers can tell exactly which samples they got
+ * and detect when the producer lapped them mid-copy (a torn read) instead of
+ * silently returning mixed old/new data.
+ *
+ * Any number of readers may consume the same ring, each with its own
+ * Ring_Reader cursor and counters.
+ */
+#ifndef RING_H_
+#define RING_H_
+
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/**
+ * @struct Ring
+ * @brief Power-of-two ring of float samples
+ */
+typedef struct {
+  float *data;     ///< capacity samples, indexed by sequence & mask
+  size_t capacity; ///< Number of slots (power of two)
+  size_t mask;     ///< capacity - 1
+  /// Sequence one past the last sample the producer is writing. Raised
+  /// before the samples are written, so readers can tell which slots may
+  /// be in flux.
+  _Atomic uint64_t claim_seq;
+  /// Sequence one past the last fully written sample
+  _Atomic uint64_t write_seq;
+} Ring;
+
+/**
+ * @struct Ring_Reader
+ * @brief Per-consumer cursor and statistics
+ */
+typedef struct {
+  uint64_t read_seq; ///< Next sequence ring_read() will return
+  uint64_t overruns; ///< Times the producer lapped this reader
+  uint64_t dropped;  ///< Samples skipped because of overruns
+} Ring_Reader;
+
+/**
+ * @struct Ring_Span
+ * @brief Contiguous run of ring slots handed out by ring_write_begin()
+ */
+typedef struct {
+  float *data;  ///< First slot
+  size_t count; ///< Number of slots
+} Ring_Span;
+
+/**
+ * @brief Allocates a ring with the given power-of-two capacity
+ * @return false if capacity is not a power of two or allocation failed
+ */
+bool ring_init(Ring *r, size_t capacity);
+
+/**
+ * @brief Frees the ring storage
+ */
+void ring_free(Ring *r);
+
+/**
+ * @brief Claims the next n slots for writing in place (producer only)
+ *
+ * Fills spans with up to two contiguous runs covering the n slots (the
+ * second is empty unless the range wraps). Write them, then publish with
+ * ring_write_end(). Useful to fill several rings in one pass over a source.
+ *
+ * @param n Number of slots, at most r->capacity
+ */
+void ring_write_begin(Ring *r, size_t n, Ring_Span spans[2]);
+
+/**
+ * @brief Publishes the n slots claimed by the last ring_write_begin()
+ */
+void ring_write_end(Ring *r, size_t n);
+
+/**
+ * @brief Appends n samples taken every stride floats from src (producer only)
+ *
+ * Use stride 1 for contiguous data or the channel count to pick one channel
+ * out of an interleaved buffer. Lock-free and wait-free.
+ */
+void ring_write_strided(Ring *r, const float src[], size_t n, size_t stride);
+
+/**
+ * @brief Appends n contiguous samples (producer only)
+ */
+static inline void ring_write(Ring *r, const float src[], size_t n) {
+  ring_write_strided(r, src, n, 1);
+}
+
+/**
+ * @brief Overwrites the whole ring with silence (producer only)
+ *
+ * Sequences keep increasing, so readers observe a run of zeros rather than
+ * a rewind.
+ */
+void ring_clear(Ring *r);
+
+/**
+ * @brief Sequence one past the newest published sample
+ */
+static inline uint64_t ring_write_seq(const Ring *r) {
+  return atomic_load_explicit(&((Ring *)r)->write_seq, memory_order_acquire);
+}
+
+/**
+ * @brief Copies the newest n samples into dst, oldest first
+ *
+ * Retries if the producer overwrote part of the window while it was being
+ * copied; each such attempt counts as an overrun in rd.
+ *
+ * Before n samples were ever written the window is padded with leading
+ * zeros.
+ *
+ * @param n Window length, at most r->capacity
+ * @param rd Reader whose counters are updated (its cursor is not used)
+ * @param end_seq Optional output: sequence one past the last copied sample
+ * @return false if no consistent window could be copied (dst content is
+ *         then unspecified)
+ */
+bool ring_read_latest(const Ring *r, float dst[], size_t n, Ring_Reader *rd,
+                      uint64_t *end_seq);
+
+/**
+ * @brief Copies the n samples ending at sequence end into dst
+ *
+ * Lets a reader take windows from several rings written in lockstep at the
+ * same position (e.g. the sequence returned by ring_read_latest on another
+ * channel). Positions before the first sample read as silence.
+ *
+ * @return false if end has not been published yet or the range was
+ *         overwritten
+ */
+bool ring_read_at(const Ring *r, float dst[], uint64_t end, size_t n,
+                  Ring_Reader *rd);
+
+/**
+ * @brief Copies up to max unread samples for rd, in order
+ *
+ * If the producer lapped the reader, the lost samples are skipped and
+ * accounted in rd->overruns / rd->dropped.
+ *
+ * @return Number of samples copied into dst
+ */
+size_t ring_read(const Ring *r, Ring_Reader *rd, float dst[], size_t max);
+
+#endif // RING_H_
@@ -0,0 +1,163 @@
+/**
+ * @file ring_stress.c
+ * @brief Stress test for the SPSC ring buffer in ring.c
+ *
+ * A producer thread writes a ramp (every sample holds its own sequence
+ * number) in random-sized chunks as fast as it can, yielding only between
+ * bursts, while consumer threads read it back sequentially and as "latest
+ * window" snapshots. Any sample that does not match its sequence is a torn
+ * read that slipped past the overrun detection. The ring is kept small so
+ * the producer laps the readers constantly; the sequential reader must
+ * still recover from each overrun and get a fair share of the stream.
+ */
+#include <pthread.h>
+#include <sched.h>
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#include "ring.h"
+
+#define STRESS_CAPACITY 1024      ///< Ring slots
+#define STRESS_WINDOW 512         ///< Window size for the latest-window reader
+#define STRESS_MAX_CHUNK 256      ///< Largest producer write
+#define STRESS_BURST 8            ///< Producer writes between yields
+#define STRESS_SECONDS 2.0        ///< Duration of the run
+#define STRESS_MIN_DELIVERED 0.25 ///< Least share the sequential reader gets
+#define RAMP_PERIOD (1u << 24)    ///< Integers below this are exact in a float
+
+static Ring ring;
+static atomic_bool done;
+
+static float ramp(uint64_t seq) { return (float)(uint32_t)(seq % RAMP_PERIOD); }
+
+static void *producer(void *arg) {
+  (void)arg;
+  float chunk[STRESS_MAX_CHUNK];
+  uint64_t seq = 0;
+  unsigned bursts = 0;
+  unsigned rng = 1;
+
+  while (!atomic_load_explicit(&done, memory_order_relaxed)) {
+    rng = rng * 1103515245u + 12345u;
+    size_t n = 1 + (rng >> 16) % STRESS_MAX_CHUNK;
+    for (size_t i = 0; i < n; i++)
+      chunk[i] = ramp(seq + i);
+    ring_write(&ring, chunk, n);
+    seq += n;
+    /* Let the readers in between bursts, even on a single core */
+    if (++bursts % STRESS_BURST == 0)
+      sched_yield();
+  }
+  return NULL;
+}
+
+typedef struct {
+  Ring_Reader reader;
+  uint64_t reads;
+  uint64_t samples;
+  uint64_t corrupted;
+} Consumer_Stats;
+
+static void *sequential_consumer(void *arg) {
+  Consumer_Stats *st = arg;
+  float buf[STRESS_CAPACITY];
+
+  while (!atomic_load_explicit(&done, memory_order_relaxed)) {
+    size_t n = ring_read(&ring, &st->reader, buf, STRESS_CAPACITY);
+    if (n == 0) {
+      sched_yield();
+      continue;
+    }
+    /* read_seq may have skipped ahead past an overrun before the copy */
+    uint64_t first = st->reader.read_seq - n;
+    for (size_t i = 0; i < n; i++) {
+      if (buf[i] != ramp(first + i))
+        st->corrupted++;
+    }
+    st->reads++;
+    st->samples += n;
+  }
+  return NULL;
+}
+
+static void *latest_consumer(void *arg) {
+  Consumer_Stats *st = arg;
+  float buf[STRESS_WINDOW];
+
+  while (!atomic_load_explicit(&done, memory_order_relaxed)) {
+    uint64_t end;
+    if (!ring_read_latest(&ring, buf, STRESS_WINDOW, &st->reader, &end)) {
+      sched_yield();
+      continue;
+    }
+    if (end < STRESS_WINDOW)
+      continue;
+    for (size_t i = 0; i < STRESS_WINDOW; i++) {
+      if (buf[i] != ramp(end - STRESS_WINDOW + i))
+        st->corrupted++;
+    }
+    st->reads++;
+    st->samples += STRESS_WINDOW;
+  }
+  return NULL;
+}
+
+static void report(const char *name, const Consumer_Stats *st) {
+  printf("%-10s reads=%-10llu samples=%-12llu overruns=%-10llu "
+         "dropped=%-12llu corrupted=%llu\n",
+         name, (unsigned long long)st->reads,
+         (unsigned long long)st->samples,
+         (unsigned long long)st->reader.overruns,
+         (unsigned long long)st->reader.dropped,
+         (unsigned long long)st->corrupted);
+}
+
+int main(void) {
+  if (!ring_init(&ring, STRESS_CAPACITY)) {
+    fprintf(stderr, "ERROR: could not allocate ring\n");
+    return 1;
+  }
+
+  Consumer_Stats seq_stats = {0}, latest_stats = {0};
+  pthread_t threads[3];
+  pthread_create(&threads[0], NULL, producer, NULL);
+  pthread_create(&threads[1], NULL, sequential_consumer, &seq_stats);
+  pthread_create(&threads[2], NULL, latest_consumer, &latest_stats);
+
+  struct timespec ts = {
+      .tv_sec = (time_t)STRESS_SECONDS,
+      .tv_nsec = (long)((STRESS_SECONDS - (time_t)STRESS_SECONDS) * 1e9),
+  };
+  nanosleep(&ts, NULL);
+  atomic_store(&done, true);
+  for (size_t i = 0; i < 3; i++)
+    pthread_join(threads[i], NULL);
+
+  uint64_t produced = ring_write_seq(&ring);
+  printf("produced %llu samples into a %d-slot ring\n",
+         (unsigned long long)produced, STRESS_CAPACITY);
+  report("sequential", &seq_stats);
+  report("latest", &latest_stats);
+  ring_free(&ring);
+
+  if (seq_stats.corrupted || latest_stats.corrupted) {
+    fprintf(stderr, "ERROR: torn reads were not detected\n");
+    return 1;
+  }
+  if (seq_stats.reads == 0 || latest_stats.reads == 0) {
+    fprintf(stderr, "ERROR: a consumer never completed a read\n");
+    return 1;
+  }
+  /* Completing a read now and then is not enough: after each overrun the
+   * reader has to resync far enough back to keep up with the stream */
+  if ((double)seq_stats.samples < STRESS_MIN_DELIVERED * (double)produced) {
+    fprintf(stderr, "ERROR: the sequential reader got %.1f%% of the stream\n",
+            100.0 * (double)seq_stats.samples / (double)produced);
+    return 1;
+  }
+  return 0;
+}
@@ -0,0 +1,438 @@
+/**
+ * @file search.c
+ * @brief Trigram indexes and their indexing thread
+ */
+#include "search.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define SEARCH_BATCH 1024 ///< Playlist entries indexed per lock hold
+#define SEARCH_FIELD_SEP '\t'
+
+/**
+ * @struct Posting
+ * @brief Documents containing one trigram
+ */
+typedef struct {
+  uint32_t key;      ///< Trigram + 1; 0 marks an empty slot
+  uint32_t count;    ///< Number of documents
+  uint32_t capacity; ///< Allocated documents
+  uint32_t *docs;    ///< Ascending document numbers
+} Posting;
+
+struct Search_Index {
+  char *text;           ///< Lowercased documents, each NUL-terminated
+  size_t text_size;     ///< Bytes used
+  size_t text_capacity; ///< Bytes allocated
+  uint32_t *offsets;    ///< Start of each document in text
+  uint32_t *ids;        ///< Caller id of each document
+  size_t count;         ///< Number of documents
+  size_t capacity;      ///< Allocated documents
+  Posting *table;       ///< Open-addressed, power-of-two size
+  size_t table_size;    ///< Slots
+  size_t used;          ///< Occupied slots
+};
+
+static char lower(char c) {
+  return c >= 'A' && c <= 'Z' ? (char)(c - 'A' + 'a') : c;
+}
+
+static uint32_t trigram(const char *s) {
+  return ((uint32_t)(unsigned char)s[0] << 16 |
+          (uint32_t)(unsigned char)s[1] << 8 | (unsigned char)s[2]) +
+         1;
+}
+
+static size_t slot_of(uint32_t key, size_t table_size) {
+  return (size_t)(key * 2654435761u) & (table_size - 1);
+}
+
+static Posting *find_posting(const Search_Index *idx, uint32_t key) {
+  if (!idx->table)
+    return NULL;
+  for (size_t i = slot_of(key, idx->table_size);;
+       i = (i + 1) & (idx->table_size - 1)) {
+    if (idx->table[i].key == key)
+      return &idx->table[i];
+    if (idx->table[i].key == 0)
+      return NULL;
+  }
+}
+
+static bool grow_table(Search_Index *idx) {
+  size_t size = idx->table_size ? idx->table_size * 2 : 4096;
+  Posting *table = calloc(size, sizeof(*table));
+  if (!table)
+    return false;
+  for (size_t i = 0; i < idx->table_size; i++) {
+    if (idx->table[i].key == 0)
+      continue;
+    size_t j = slot_of(idx->table[i].key, size);
+    while (table[j].key != 0)
+      j = (j + 1) & (size - 1);
+    table[j] = idx->table[i];
+  }
+  free(idx->table);
+  idx->table = table;
+  idx->table_size = size;
+  return true;
+}
+
+static bool add_posting(Search_Index *idx, uint32_t key, uint32_t doc) {
+  if ((idx->used + 1) * 2 > idx->table_size && !grow_table(idx))
+    return false;
+  size_t i = slot_of(key, idx->table_size);
+  while (idx->table[i].key != 0 && idx->table[i].key != key)
+    i = (i + 1) & (idx->table_size - 1);
+
+  Posting *p = &idx->table[i];
+  if (p->key == 0) {
+    p->key = key;
+    idx->used++;
+  }
+  /* Documents arrive in order, so a repeat can only be the last one */
+  if (p->count > 0 && p->docs[p->count - 1] == doc)
+    return true;
+  if (p->count == p->capacity) {
+    uint32_t grown = p->capacity ? p->capacity * 2 : 4;
+    uint32_t *docs = realloc(p->docs, grown * sizeof(*docs));
+    if (!docs)
+      return false;
+    p->docs = docs;
+    p->capacity = grown;
+  }
+  p->docs[p->count++] = doc;
+  return true;
+}
+
+static void index_free(Search_Index *idx) {
+  if (!idx)
+    return;
+  for (size_t i = 0; i < idx->table_size; i++)
+    free(idx->table[i].docs);
+  free(idx->table);
+  free(idx->text);
+  free(idx->offsets);
+  free(idx->ids);
+  free(idx);
+}
+
+/**
+ * @brief Appends one document: its lowercased text, then its trigrams
+ */
+static bool index_add(Search_Index *idx, uint32_t id, const char *text) {
+  size_t len = strlen(text);
+  if (idx->text_size + len + 1 > UINT32_MAX)
+    return false;
+  if (idx->count == idx->capacity) {
+    size_t grown = idx->capacity ? idx->capacity * 2 : 256;
+    uint32_t *offsets = realloc(idx->offsets, grown * sizeof(*offsets));
+    if (!offsets)
+      return false;
+    idx->offsets = offsets;
+    uint32_t *ids = realloc(idx->ids, grown * sizeof(*ids));
+    if (!ids)
+      return false;
+    idx->ids = ids;
+    idx->capacity = grown;
+  }
+  if (idx->text_size + len + 1 > idx->text_capacity) {
+    size_t grown = idx->text_capacity ? idx->text_capacity * 2 : 1 << 16;
+    while (grown < idx->text_size + len + 1)
+      grown *= 2;
+    char *items = realloc(idx->text, grown);
+    if (!items)
+      return false;
+    idx->text = items;
+    idx->text_capacity = grown;
+  }
+
+  char *doc = &idx->text[idx->text_size];
+  for (size_t i = 0; i <= len; i++)
+    doc[i] = lower(text[i]);
+  uint32_t number = (uint32_t)idx->count;
+  bool ok = true;
+  for (size_t i = 0; ok && i + 3 <= len; i++)
+    ok = add_posting(idx, trigram(&doc[i]), number);
+
+  /* Kept even if a posting failed: the ones added already name it, and
+   * the next document must not inherit them */
+  idx->offsets[idx->count] = (uint32_t)idx->text_size;
+  idx->ids[idx->count] = id;
+  idx->count++;
+  idx->text_size += len + 1;
+  return ok;
+}
+
+static bool word_start(const char *doc, const char *at) {
+  if (at == doc)
+    return true;
+  return strchr(" \t-_.()[]/", at[-1]) != NULL;
+}
+
+/**
+ * @brief Score of a document containing every word, or -1
+ */
+static int32_t score_doc(const char *doc, size_t len, char *const words[],
+                         size_t word_count) {
+  const char *found[SEARCH_MAX_WORDS];
+  for (size_t w = 0; w < word_count; w++)
+    if (!(found[w] = strstr(doc, words[w])))
+      return -1;
+
+  const char *name_end = memchr(doc, SEARCH_FIELD_SEP, len);
+  if (!name_end)
+    name_end = doc + len;
+  int32_t score = 0;
+  for (size_t w = 0; w < word_count; w++) {
+    const char *at = found[w];
+    /* Prefer an occurrence that starts a word */
+    for (const char *next = at; next && !word_start(doc, at);
+         next = strstr(next + 1, words[w]))
+      if (word_start(doc, next))
+        at = next;
+    if (at == doc)
+      score += 4;
+    else if (word_start(doc, at))
+      score += 2;
+    if (at < name_end)
+      score += 1;
+  }
+  return score * 1024 - (int32_t)(len < 1023 ? len : 1023);
+}
+
+/**
+ * @brief Inserts a hit into the best-first list, if it ranks high enough
+ */
+static void rank(Search_Hit *hits, size_t *count, size_t max_hits,
+                 Search_Hit hit) {
+  if (*count == max_hits && hits[max_hits - 1].score >= hit.score)
+    return;
+  size_t i = *count < max_hits ? (*count)++ : max_hits - 1;
+  while (i > 0 && hits[i - 1].score < hit.score) {
+    hits[i] = hits[i - 1];
+    i--;
+  }
+  hits[i] = hit;
+}
+
+static size_t index_query(const Search_Index *idx, const char *query,
+                          Search_Hit *hits, size_t max_hits) {
+  char text[SEARCH_QUERY_MAX];
+  size_t len = 0;
+  for (; query[len] && len + 1 < sizeof(text); len++)
+    text[len] = lower(query[len]);
+  text[len] = '\0';
+
+  char *words[SEARCH_MAX_WORDS];
+  size_t word_count = 0;
+  char *save = NULL;
+  for (char *word = strtok_r(text, " ", &save);
+       word && word_count < SEARCH_MAX_WORDS; word = strtok_r(NULL, " ", &save))
+    words[word_count++] = word;
+  if (len < SEARCH_QUERY_MIN || word_count == 0 || max_hits == 0)
+    return 0;
+
+  /* The rarest trigram of any word bounds the candidates */
+  const Posting *rarest = NULL;
+  for (size_t w = 0; w < word_count; w++) {
+    for (size_t i = 0; i + 3 <= strlen(words[w]); i++) {
+      const Posting *p = find_posting(idx, trigram(&words[w][i]));
+      if (!p)
+        return 0;
+      if (!rarest || p->count < rarest->count)
+        rarest = p;
+    }
+  }
+
+  size_t count = 0;
+  size_t candidates = rarest ? rarest->count : idx->count;
+  for (size_t c = 0; c < candidates; c++) {
+    uint32_t d = rarest ? rarest->docs[c] : (uint32_t)c;
+    size_t end = d + 1 < idx->count ? idx->offsets[d + 1] : idx->text_size;
+    const char *doc = &idx->text[idx->offsets[d]];
+    int32_t score = score_doc(doc, end - idx->offsets[d] - 1, words,
+                              word_count);
+    if (score >= 0)
+      rank(hits, &count, max_hits,
+           (Search_Hit){.id = idx->ids[d], .score = score});
+  }
+  return count;
+}
+
+/**
+ * @brief Document text of a library record: file name, then its tags
+ */
+static void library_text(const Library_View *view, const Library_Record *r,
+                         char *text, size_t size) {
+  const char *path = view->strings + r->path;
+  const char *name = strrchr(path, '/');
+  snprintf(text, size, "%s\t%s\t%s\t%s", name ? name + 1 : path,
+           view->strings + r->title, view->strings + r->artist,
+           view->strings + r->album);
+}
+
+static Search_Index *build_library(const Library_View *view) {
+  Search_Index *idx = calloc(1, sizeof(*idx));
+  if (!idx)
+    return NULL;
+  char text[1024];
+  for (size_t i = 0; i < view->count; i++) {
+    library_text(view, &view->records[i], text, sizeof(text));
+    if (!index_add(idx, (uint32_t)i, text))
+      break;
+  }
+  return idx;
+}
+
+static void *search_thread(void *arg) {
+  Search *s = arg;
+
+  pthread_mutex_lock(&s->lock);
+  while (s->running) {
+    if (s->library_pending) {
+      Library_View view = s->library;
+      unsigned generation = s->library_wanted;
+      s->library = (Library_View){0};
+      s->library_pending = false;
+      pthread_mutex_unlock(&s->lock);
+
+      /* Built aside and swapped in, so queries never see it half done */
+      Search_Index *idx = build_library(&view);
+      library_view_release(&view);
+
+      pthread_mutex_lock(&s->lock);
+      Search_Index *old = s->indexes[SEARCH_LIBRARY];
+      s->indexes[SEARCH_LIBRARY] = idx;
+      s->library_generation = generation;
+      atomic_fetch_add_explicit(&s->revision, 1, memory_order_relaxed);
+      pthread_mutex_unlock(&s->lock);
+      index_free(old);
+      pthread_mutex_lock(&s->lock);
+    } else if (s->pending_count > 0) {
+      /* Appended in place: batches keep each lock hold short */
+      Search_Index *idx = s->indexes[SEARCH_QUEUE];
+      if (!idx && !(idx = s->indexes[SEARCH_QUEUE] = calloc(1, sizeof(*idx))))
+        break;
+      size_t n = s->pending_count < SEARCH_BATCH ? s->pending_count
+                                                 : SEARCH_BATCH;
+      for (size_t i = 0; i < n; i++) {
+        index_add(idx, s->pending[i].id, s->pending[i].text);
+        free(s->pending[i].text);
+      }
+      s->pending_count -= n;
+      memmove(s->pending, s->pending + n,
+              s->pending_count * sizeof(*s->pending));
+      atomic_fetch_add_explicit(&s->revision, 1, memory_order_relaxed);
+    } else {
+      pthread_cond_wait(&s->wake, &s->lock);
+    }
+  }
+  pthread_mutex_unlock(&s->lock);
+  return NULL;
+}
+
+bool search_start(Search *s) {
+  if (!s->initialized) {
+    if (pthread_mutex_init(&s->lock, NULL) != 0)
+      return false;
+    if (pthread_cond_init(&s->wake, NULL) != 0) {
+      pthread_mutex_destroy(&s->lock);
+      return false;
+    }
+    s->initialized = true;
+  }
+  if (s->started)
+    return true;
+  s->running = true;
+  if (pthread_create(&s->thread, NULL, search_thread, s) != 0) {
+    s->running = false;
+    return false;
+  }
+  s->started = true;
+  return true;
+}
+
+void search_stop(Search *s) {
+  if (!s->started)
+    return;
+  pthread_mutex_lock(&s->lock);
+  s->running = false;
+  pthread_cond_broadcast(&s->wake);
+  pthread_mutex_unlock(&s->lock);
+  pthread_join(s->thread, NULL);
+  s->started = false;
+}
+
+void search_free(Search *s) {
+  if (!s->initialized)
+    return;
+  search_stop(s);
+  for (size_t i = 0; i < COUNT_SEARCH_SOURCES; i++) {
+    index_free(s->indexes[i]);
+    s->indexes[i] = NULL;
+  }
+  for (size_t i = 0; i < s->pending_count; i++)
+    free(s->pending[i].text);
+  free(s->pending);
+  s->pending = NULL;
+  s->pending_count = s->pending_capacity = 0;
+  library_view_release(&s->library);
+  s->library_pending = false;
+  pthread_cond_destroy(&s->wake);
+  pthread_mutex_destroy(&s->lock);
+  s->initialized = false;
+}
+
+void search_add(Search *s, uint32_t id, const char *text) {
+  if (!s->initialized)
+    return;
+  char *copy = strdup(text);
+  if (!copy)
+    return;
+
+  pthread_mutex_lock(&s->lock);
+  if (s->pending_count == s->pending_capacity) {
+    size_t grown = s->pending_capacity ? s->pending_capacity * 2 : 256;
+    Search_Doc *items = realloc(s->pending, grown * sizeof(*items));
+    if (!items) {
+      pthread_mutex_unlock(&s->lock);
+      free(copy);
+      return;
+    }
+    s->pending = items;
+    s->pending_capacity = grown;
+  }
+  s->pending[s->pending_count++] = (Search_Doc){.id = id, .text = copy};
+  pthread_cond_signal(&s->wake);
+  pthread_mutex_unlock(&s->lock);
+}
+
+void search_set_library(Search *s, Library_View view, unsigned generation) {
+  if (!s->initialized) {
+    library_view_release(&view);
+    return;
+  }
+  pthread_mutex_lock(&s->lock);
+  library_view_release(&s->library);
+  s->library = view;
+  s->library_wanted = generation;
+  s->library_pending = true;
+  pthread_cond_signal(&s->wake);
+  pthread_mutex_unlock(&s->lock);
+}
+
+size_t search_query(Search *s, Search_Source source, const char *query,
+                    Search_Hit *hits, size_t max_hits, unsigned *generation) {
+  if (!s->initialized)
+    return 0;
+  pthread_mutex_lock(&s->lock);
+  const Search_Index *idx = s->indexes[source];
+  size_t count = idx ? index_query(idx, query, hits, max_hits) : 0;
+  if (generation)
+    *generation = s->library_generation;
+  pthread_mutex_unlock(&s->lock);
+  return count;
+}
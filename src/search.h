@@ -0,0 +1,139 @@
+/**
+ * @file search.h
+ * @brief Type-to-search over the library and the playlist
+ *
+ * Each source (library, playlist) has its own trigram index: the lowercased
+ * text of every document (file name, then tags) is cut into overlapping
+ * three-byte keys, and each key maps to the ascending list of documents
+ * containing it. A query only looks at the documents in the shortest list
+ * among its words' trigrams and verifies them with a substring match, so
+ * a query over 100k+ documents touches a few hundred of them instead of
+ * all of them. Words shorter than three bytes fall back to a full scan.
+ *
+ * Indexing runs on a thread of its own. Playlist entries are queued with
+ * search_add() as tracks are appended and indexed in batches; the library
+ * index is rebuilt from a shared mapping of the library file whenever the
+ * library changes. Queries run on the render thread under the lock, which
+ * the indexer only holds to append a batch or swap in a rebuilt index.
+ */
+#ifndef SEARCH_H_
+#define SEARCH_H_
+
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "library.h"
+
+#define SEARCH_QUERY_MAX 128 ///< Longest query, including the NUL
+#define SEARCH_QUERY_MIN 2   ///< Shorter queries match nothing
+#define SEARCH_MAX_HITS 256  ///< Most hits returned by a query
+#define SEARCH_MAX_WORDS 8   ///< Words of a query that are matched
+
+/**
+ * @enum Search_Source
+ * @brief Which index a query runs against
+ */
+typedef enum {
+  SEARCH_LIBRARY, ///< Records of the library index
+  SEARCH_QUEUE,   ///< Tracks of the playlist
+  COUNT_SEARCH_SOURCES,
+} Search_Source;
+
+/**
+ * @struct Search_Hit
+ * @brief One ranked result
+ */
+typedef struct {
+  uint32_t id;   ///< Record index (library) or track index (playlist)
+  int32_t score; ///< Higher ranks first
+} Search_Hit;
+
+/// Trigram index of one source (defined in search.c)
+typedef struct Search_Index Search_Index;
+
+/**
+ * @struct Search_Doc
+ * @brief Playlist entry waiting to be indexed
+ */
+typedef struct {
+  uint32_t id;
+  char *text;
+} Search_Doc;
+
+/**
+ * @struct Search
+ * @brief Indexes plus their indexing thread, embedded in Plug
+ */
+typedef struct {
+  pthread_mutex_t lock;
+  pthread_cond_t wake; ///< Signalled on new work and shutdown
+
+  /* Guarded by lock */
+  Search_Index *indexes[COUNT_SEARCH_SOURCES];
+  unsigned library_generation; ///< Library generation the index was built at
+  Library_View library;        ///< Mapping to index next, owned
+  unsigned library_wanted;     ///< Its generation
+  bool library_pending;        ///< library is set and not indexed yet
+  Search_Doc *pending;         ///< Playlist entries to index
+  size_t pending_count;
+  size_t pending_capacity;
+  bool running;
+
+  atomic_uint revision; ///< Bumped whenever an index changed
+  pthread_t thread;
+  bool started;     ///< thread exists
+  bool initialized; ///< lock and wake exist
+} Search;
+
+/**
+ * @brief Starts the indexing thread, keeping any index already built
+ */
+bool search_start(Search *s);
+
+/**
+ * @brief Stops and joins the indexing thread
+ */
+void search_stop(Search *s);
+
+/**
+ * @brief Stops the thread and frees every index
+ */
+void search_free(Search *s);
+
+/**
+ * @brief Queues a playlist entry for indexing (render thread)
+ *
+ * @param id Track index returned by queries for this entry
+ * @param text File name and tags; copied
+ */
+void search_add(Search *s, uint32_t id, const char *text);
+
+/**
+ * @brief Rebuilds the library index from view (render thread)
+ *
+ * @param view Mapping of the library file, from library_view_share();
+ *        ownership passes to the search
+ * @param generation Library generation view shows, reported back by
+ *        search_query()
+ */
+void search_set_library(Search *s, Library_View view, unsigned generation);
+
+/**
+ * @brief Ranked documents matching every word of query (render thread)
+ *
+ * Matching is case-insensitive for ASCII. Prefix matches and matches at
+ * the start of a word rank higher, then shorter documents. A single
+ * letter would match nearly everything, so queries shorter than
+ * SEARCH_QUERY_MIN return no hits.
+ *
+ * @param generation Output: library generation the ids refer to
+ *        (SEARCH_LIBRARY only, may be NULL)
+ * @return Number of hits written, best first
+ */
+size_t search_query(Search *s, Search_Source source, const char *query,
+                    Search_Hit *hits, size_t max_hits, unsigned *generation);
+
+#endif // SEARCH_H_
@@ -0,0 +1,226 @@
+/**
+ * @file session.c
+ * @brief Snapshot layout, mapped restore and the writer thread
+ */
+#include "session.h"
+
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "fs_util.h"
+
+/// Bytes of the columns of count tracks, laid out as in Playlist
+static size_t columns_size(size_t count) {
+  const Playlist *pl = NULL;
+  return count * (sizeof(*pl->order) + sizeof(*pl->length) +
+                  sizeof(*pl->sample_rate) + sizeof(*pl->channels) +
+                  sizeof(*pl->flags));
+}
+
+bool session_load(const char *file, Session_State *state, Playlist *pl) {
+  int fd = open(file, O_RDONLY | O_CLOEXEC);
+  if (fd < 0)
+    return false;
+  struct stat st;
+  void *map = MAP_FAILED;
+  if (fstat(fd, &st) == 0 && (size_t)st.st_size >= sizeof(Session_Header))
+    map = mmap(NULL, (size_t)st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+  close(fd);
+  if (map == MAP_FAILED)
+    return false;
+  size_t size = (size_t)st.st_size;
+  madvise(map, size, MADV_SEQUENTIAL);
+
+  const Session_Header *header = map;
+  size_t count = header->count;
+  const uint32_t *order = (const void *)(header + 1);
+  const float *length = (const void *)(order + count);
+  const uint32_t *sample_rate = (const void *)(length + count);
+  const uint8_t *channels = (const void *)(sample_rate + count);
+  const uint8_t *flags = channels + count;
+  const char *strings = (const char *)(flags + count);
+  size_t strings_size = header->strings_size;
+  bool valid =
+      memcmp(header->magic, SESSION_MAGIC, sizeof(header->magic)) == 0 &&
+      header->version == SESSION_VERSION && count < PLAYLIST_NONE &&
+      strings_size <= size &&
+      sizeof(*header) + columns_size(count) + strings_size == size;
+
+  /* Paths are copied into the playlist arena straight from the mapping */
+  size_t at = 0;
+  for (uint32_t id = 0; valid && id < count; id++) {
+    size_t left = strings_size - at;
+    size_t len = strnlen(strings + at, left);
+    Track_Info info = {.length = length[id],
+                       .sample_rate = sample_rate[id],
+                       .channels = channels[id]};
+    valid = len < left && length[id] >= 0.0f &&
+            playlist_append(pl, strings + at,
+                            (flags[id] & PLAYLIST_PROBED) ? &info : NULL) ==
+                id;
+    if (valid && (flags[id] & PLAYLIST_TIMED))
+      playlist_set_length(pl, id, length[id]);
+    at += len + 1;
+  }
+  valid = valid && at == strings_size && playlist_set_order(pl, order);
+
+  if (valid) {
+    *state = header->state;
+    state->current_dir[SESSION_PATH_MAX - 1] = '\0';
+    state->playlist_file[SESSION_PATH_MAX - 1] = '\0';
+    if (state->current_track < 0 || (size_t)state->current_track >= count)
+      state->current_track = -1;
+  } else {
+    fprintf(stderr, "WARNING: ignoring invalid session %s\n", file);
+    playlist_free(pl);
+  }
+  munmap(map, size);
+  return valid;
+}
+
+/// Copies size bytes to at and returns the end
+static char *put(char *at, const void *data, size_t size) {
+  if (size > 0)
+    memcpy(at, data, size);
+  return at + size;
+}
+
+void *session_build(const Session_State *state, const Playlist *pl,
+                    size_t *size) {
+  size_t count = pl->count;
+  size_t strings_size = 0;
+  for (uint32_t id = 0; id < count; id++)
+    strings_size += strlen(playlist_path(pl, id)) + 1;
+  *size = sizeof(Session_Header) + columns_size(count) + strings_size;
+  char *snapshot = malloc(*size);
+  if (!snapshot)
+    return NULL;
+
+  /* Zeroed first so that padding is not written out uninitialized */
+  Session_Header header;
+  memset(&header, 0, sizeof(header));
+  memcpy(header.magic, SESSION_MAGIC, sizeof(header.magic));
+  header.version = SESSION_VERSION;
+  header.count = (uint32_t)count;
+  header.strings_size = strings_size;
+  header.state = *state;
+
+  char *at = put(snapshot, &header, sizeof(header));
+  at = put(at, pl->order, count * sizeof(*pl->order));
+  at = put(at, pl->length, count * sizeof(*pl->length));
+  at = put(at, pl->sample_rate, count * sizeof(*pl->sample_rate));
+  at = put(at, pl->channels, count * sizeof(*pl->channels));
+  at = put(at, pl->flags, count * sizeof(*pl->flags));
+  for (uint32_t id = 0; id < count; id++) {
+    const char *path = playlist_path(pl, id);
+    at = put(at, path, strlen(path) + 1);
+  }
+  return snapshot;
+}
+
+/**
+ * @brief Writes snapshots as they are submitted; on stop, writes the one
+ * still pending before returning
+ */
+static void *session_thread(void *arg) {
+  Session *s = arg;
+  pthread_mutex_lock(&s->lock);
+  for (;;) {
+    while (s->running && !s->pending)
+      pthread_cond_wait(&s->wake, &s->lock);
+    if (!s->pending)
+      break;
+    void *snapshot = s->pending;
+    size_t size = s->pending_size;
+    s->pending = NULL;
+    pthread_mutex_unlock(&s->lock);
+
+    /* Paused with nothing changed: the file on disk is already this */
+    bool same = s->written && size == s->written_size &&
+                memcmp(snapshot, s->written, size) == 0;
+    /* path only changes while the thread is stopped */
+    if (same) {
+      free(snapshot);
+    } else if (fs_write_buffer(s->path, snapshot, size, true)) {
+      free(s->written);
+      s->written = snapshot;
+      s->written_size = size;
+    } else {
+      fprintf(stderr, "WARNING: could not write session %s\n", s->path);
+      free(snapshot);
+    }
+
+    pthread_mutex_lock(&s->lock);
+  }
+  pthread_mutex_unlock(&s->lock);
+  return NULL;
+}
+
+bool session_start(Session *s, const char *file) {
+  if (!s->initialized) {
+    if (pthread_mutex_init(&s->lock, NULL) != 0)
+      return false;
+    if (pthread_cond_init(&s->wake, NULL) != 0) {
+      pthread_mutex_destroy(&s->lock);
+      return false;
+    }
+    s->initialized = true;
+  }
+  if (s->started)
+    return true;
+  if (file && (!s->path || strcmp(s->path, file) != 0)) {
+    free(s->path);
+    s->path = strdup(file);
+  }
+  if (!s->path)
+    return false;
+
+  s->running = true;
+  if (pthread_create(&s->thread, NULL, session_thread, s) != 0) {
+    s->running = false;
+    return false;
+  }
+  s->started = true;
+  return true;
+}
+
+void session_submit(Session *s, void *snapshot, size_t size) {
+  if (!s->started) {
+    free(snapshot);
+    return;
+  }
+  pthread_mutex_lock(&s->lock);
+  free(s->pending);
+  s->pending = snapshot;
+  s->pending_size = size;
+  pthread_cond_signal(&s->wake);
+  pthread_mutex_unlock(&s->lock);
+}
+
+void session_stop(Session *s) {
+  if (!s->started)
+    return;
+  pthread_mutex_lock(&s->lock);
+  s->running = false;
+  pthread_cond_signal(&s->wake);
+  pthread_mutex_unlock(&s->lock);
+  pthread_join(s->thread, NULL);
+  s->started = false;
+}
+
+void session_free(Session *s) {
+  if (!s->initialized)
+    return;
+  session_stop(s);
+  free(s->pending);
+  free(s->written);
+  free(s->path);
+  pthread_cond_destroy(&s->wake);
+  pthread_mutex_destroy(&s->lock);
+  memset(s, 0, sizeof(*s));
+}
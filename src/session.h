@@ -0,0 +1,131 @@
+/**
+ * @file session.h
+ * @brief Snapshot of the session, restored at the next launch
+ *
+ * The playlist (paths, probed lengths, play order), the track playing and
+ * its position, the volume and the UI state go into one small binary file:
+ * a header, a column per track field in id order, then the paths. It is
+ * memory-mapped at startup and read in a single pass with nothing opened
+ * or probed, so a 10k-track queue is back and playing before the first
+ * frame is drawn. Like the library index it is a machine-local file in
+ * native byte order; one that does not validate is ignored.
+ *
+ * Snapshots are built on the render thread, which only copies memory, and
+ * written by a helper thread that syncs the file and renames it into
+ * place, so a crash leaves either the previous snapshot or the new one.
+ */
+#ifndef SESSION_H_
+#define SESSION_H_
+
+#include <pthread.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "playlist.h"
+
+#define SESSION_MAGIC "MUSUSES" ///< First 8 bytes of a snapshot (with NUL)
+#define SESSION_VERSION 2       ///< Bumped when the layout changes
+#define SESSION_PATH_MAX 512    ///< Bytes of the directories kept
+
+/**
+ * @struct Session_State
+ * @brief Everything restored besides the tracks
+ */
+typedef struct {
+  int32_t current_track;  ///< Id of the track playing, -1 for none
+  float position;         ///< Seconds into current_track
+  float volume;           ///< Master volume, 0 to 1
+  float volume_saved;     ///< Volume restored on unmute
+  double queue_scroll;    ///< Queue panel scroll offset
+  uint32_t queue_order;   ///< Playlist_Key of the last sort
+  uint32_t analyzer_mode; ///< Analyzer_Mode picked with C
+  uint8_t paused;         ///< Playback was paused
+  uint8_t fullscreen;     ///< Fullscreen visualization
+  uint8_t show_browser;   ///< Internal browser open
+  uint8_t reserved;       ///< Zero
+  char current_dir[SESSION_PATH_MAX];   ///< Browser directory
+  char playlist_file[SESSION_PATH_MAX]; ///< Playlist file last used
+} Session_State;
+
+/**
+ * @struct Session_Header
+ * @brief Start of the snapshot file
+ *
+ * Followed by count entries of each column (order, length, sample_rate,
+ * channels, flags, as in Playlist), then strings_size bytes holding the
+ * NUL-terminated paths in id order.
+ */
+typedef struct {
+  char magic[8];         ///< SESSION_MAGIC
+  uint32_t version;      ///< SESSION_VERSION
+  uint32_t count;        ///< Tracks
+  uint64_t strings_size; ///< Bytes of paths after the columns
+  Session_State state;
+} Session_Header;
+
+/**
+ * @struct Session
+ * @brief Snapshot file and the thread writing it
+ *
+ * Embedded in Plug so it survives hot reload.
+ */
+typedef struct {
+  pthread_mutex_t lock;
+  pthread_cond_t wake; ///< Signalled on a new snapshot and shutdown
+  bool initialized;    ///< lock and wake exist
+  bool running;        ///< Cleared to stop the thread
+  bool started;        ///< thread exists
+
+  char *path;          ///< Snapshot file, owned; NULL for none
+  void *pending;       ///< Snapshot waiting to be written, owned
+  size_t pending_size; ///< Bytes of pending
+  void *written;       ///< Snapshot written last (writer thread), owned
+  size_t written_size; ///< Bytes of written
+  pthread_t thread;
+} Session;
+
+/**
+ * @brief Maps the snapshot and restores it
+ *
+ * @param pl Empty playlist, filled with the saved tracks and play order
+ * @return false if there is no valid snapshot; pl is then left empty
+ */
+bool session_load(const char *file, Session_State *state, Playlist *pl);
+
+/**
+ * @brief Serializes state and pl into a new heap buffer
+ *
+ * @param size Output: bytes of the snapshot
+ * @return The snapshot, or NULL if memory ran out
+ */
+void *session_build(const Session_State *state, const Playlist *pl,
+                    size_t *size);
+
+/**
+ * @brief Starts the writer thread
+ *
+ * @param file Snapshot file, created with its directory when first
+ *        written; NULL keeps the previous one
+ */
+bool session_start(Session *s, const char *file);
+
+/**
+ * @brief Hands a snapshot from session_build() to the writer
+ *
+ * Takes ownership of snapshot. One not written yet is replaced, and one
+ * equal to the snapshot written last is dropped.
+ */
+void session_submit(Session *s, void *snapshot, size_t size);
+
+/**
+ * @brief Writes the pending snapshot, if any, and joins the thread
+ */
+void session_stop(Session *s);
+
+/**
+ * @brief Stops the writer and frees the session
+ */
+void session_free(Session *s);
+
+#endif // SESSION_H_
@@ -0,0 +1,180 @@
+/**
+ * @file session_bench.c
+ * @brief Correctness check and restore time of the session snapshot
+ *
+ * Builds sessions of 10,000 and 100,000 synthetic tracks (probed, with a
+ * length from a playlist file, and unknown), in a shuffled play order,
+ * writes each through the writer thread (session.c) into a temporary
+ * directory and times restoring it from the mapped file. The check
+ * compares every path, length, flag and the play order with the saved
+ * playlist, and verifies that a truncated snapshot, a damaged header and
+ * a play order that is not a permutation are all rejected; each prints
+ * the warning shown at startup.
+ */
+#include <fcntl.h>
+#include <limits.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "session.h"
+
+#define BENCH_LOADS 20 ///< Restores timed; the fastest is reported
+#define BENCH_PATH_MAX 128
+
+static char dir[] = "/tmp/session_bench.XXXXXX";
+
+static double now_seconds(void) {
+  struct timespec t;
+  clock_gettime(CLOCK_MONOTONIC, &t);
+  return t.tv_sec + t.tv_nsec * 1e-9;
+}
+
+static void make_playlist(Playlist *pl, size_t count) {
+  for (size_t i = 0; i < count; i++) {
+    char path[BENCH_PATH_MAX];
+    snprintf(path, sizeof(path),
+             "/home/user/Music/Artist %03zu/Album %02zu/%02zu - Song %zu.flac",
+             i % 997, i % 20, i % 16 + 1, i);
+    Track_Info info = {.length = (float)(i % 600) + 0.25f,
+                       .sample_rate = i % 2 ? 44100 : 48000,
+                       .channels = 2};
+    uint32_t id = playlist_append(pl, path, i % 3 == 0 ? &info : NULL);
+    if (i % 3 == 1)
+      playlist_set_length(pl, id, (float)(i % 300));
+  }
+  playlist_shuffle(pl, 7, 42);
+}
+
+static bool same_playlist(const Playlist *a, const Playlist *b) {
+  if (a->count != b->count)
+    return false;
+  for (uint32_t id = 0; id < a->count; id++)
+    if (strcmp(playlist_path(a, id), playlist_path(b, id)) != 0 ||
+        strcmp(playlist_name(a, id), playlist_name(b, id)) != 0 ||
+        a->flags[id] != b->flags[id] || a->length[id] != b->length[id] ||
+        a->sample_rate[id] != b->sample_rate[id] ||
+        a->channels[id] != b->channels[id] || a->order[id] != b->order[id] ||
+        a->position[id] != b->position[id])
+      return false;
+  return true;
+}
+
+static bool write_file(const char *file, const void *data, size_t size) {
+  FILE *f = fopen(file, "wb");
+  if (!f)
+    return false;
+  bool ok = fwrite(data, 1, size, f) == size;
+  return fclose(f) == 0 && ok;
+}
+
+static bool read_file(const char *file, void **data, size_t *size) {
+  FILE *f = fopen(file, "rb");
+  if (!f)
+    return false;
+  struct stat st;
+  bool ok = fstat(fileno(f), &st) == 0 && (*data = malloc(st.st_size));
+  *size = ok ? (size_t)st.st_size : 0;
+  ok = ok && fread(*data, 1, *size, f) == *size;
+  fclose(f);
+  return ok;
+}
+
+/**
+ * @brief A damaged copy of the snapshot in file must not load
+ */
+static bool rejects(const char *file, const char *damaged, int damage) {
+  void *data;
+  size_t size;
+  if (!read_file(file, &data, &size))
+    return false;
+  Session_Header *header = data;
+  if (damage == 0) /* Truncated */
+    size -= 10;
+  else if (damage == 1) /* More tracks than the file holds */
+    header->count++;
+  else /* Two tracks in the same place of the play order */
+    ((uint32_t *)(header + 1))[1] = ((uint32_t *)(header + 1))[0];
+
+  Session_State state;
+  static Playlist pl;
+  bool ok = write_file(damaged, data, size) &&
+            !session_load(damaged, &state, &pl) && pl.count == 0;
+  free(data);
+  unlink(damaged);
+  return ok;
+}
+
+static bool run(size_t count) {
+  char file[PATH_MAX], damaged[PATH_MAX];
+  snprintf(file, sizeof(file), "%s/state/session", dir);
+  snprintf(damaged, sizeof(damaged), "%s/state/damaged", dir);
+
+  static Playlist saved, restored;
+  make_playlist(&saved, count);
+  Session_State state;
+  memset(&state, 0, sizeof(state));
+  state.current_track = 7;
+  state.position = 93.5f;
+  state.volume = 0.75f;
+  state.paused = 1;
+  snprintf(state.current_dir, sizeof(state.current_dir), "/home/user/Music");
+
+  double start = now_seconds();
+  size_t size;
+  void *snapshot = session_build(&state, &saved, &size);
+  double build_ms = (now_seconds() - start) * 1e3;
+
+  Session session = {0};
+  start = now_seconds();
+  bool written = snapshot && session_start(&session, file);
+  session_submit(&session, snapshot, size);
+  session_free(&session);
+  double write_ms = (now_seconds() - start) * 1e3;
+
+  Session_State loaded;
+  double best = 1e9;
+  bool read = written;
+  for (int k = 0; read && k < BENCH_LOADS; k++) {
+    playlist_free(&restored);
+    start = now_seconds();
+    read = session_load(file, &loaded, &restored);
+    double ms = (now_seconds() - start) * 1e3;
+    if (ms < best)
+      best = ms;
+  }
+  bool same = read && same_playlist(&saved, &restored) &&
+              memcmp(&state, &loaded, sizeof(state)) == 0;
+  bool damage = rejects(file, damaged, 0) && rejects(file, damaged, 1) &&
+                rejects(file, damaged, 2);
+
+  printf("  %8zu  %10.2f  %10.2f  %10.2f  %8.1f  %s\n", count, build_ms,
+         write_ms, best, size / 1e3, same && damage ? "OK" : "FAIL");
+
+  playlist_free(&saved);
+  playlist_free(&restored);
+  unlink(file);
+  return same && damage;
+}
+
+int main(void) {
+  if (!mkdtemp(dir)) {
+    perror("mkdtemp");
+    return 1;
+  }
+  printf("Session snapshot (restore: fastest of %d):\n", BENCH_LOADS);
+  printf("  %8s  %10s  %10s  %10s  %8s  %s\n", "tracks", "build ms",
+         "write ms", "restore ms", "KB", "check");
+  bool ok = run(10000);
+  ok &= run(100000);
+
+  char state_dir[PATH_MAX];
+  snprintf(state_dir, sizeof(state_dir), "%s/state", dir);
+  rmdir(state_dir);
+  rmdir(dir);
+  return ok ? 0 : 1;
+}
@@ -0,0 +1,451 @@
+/**
+ * @file tags.c
+ * @brief ID3v2, Vorbis comment and cover art reader
+ */
+#include "tags.h"
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+
+#define TAGS_MAX_BLOCK (16u << 20) ///< Largest tag block read into memory
+#define OGG_HEAD_BYTES (64u << 10) ///< Start of an Ogg file searched
+
+/**
+ * @struct Text_Out
+ * @brief UTF-8 writer into a TAGS_TEXT_MAX buffer that never splits a
+ * character
+ */
+typedef struct {
+  char *dst;
+  size_t used;
+} Text_Out;
+
+static void put(Text_Out *out, uint32_t cp) {
+  char bytes[4];
+  size_t n;
+  if (cp < 0x80) {
+    bytes[0] = (char)cp;
+    n = 1;
+  } else if (cp < 0x800) {
+    bytes[0] = (char)(0xC0 | cp >> 6);
+    bytes[1] = (char)(0x80 | (cp & 0x3F));
+    n = 2;
+  } else if (cp < 0x10000) {
+    bytes[0] = (char)(0xE0 | cp >> 12);
+    bytes[1] = (char)(0x80 | (cp >> 6 & 0x3F));
+    bytes[2] = (char)(0x80 | (cp & 0x3F));
+    n = 3;
+  } else {
+    bytes[0] = (char)(0xF0 | cp >> 18);
+    bytes[1] = (char)(0x80 | (cp >> 12 & 0x3F));
+    bytes[2] = (char)(0x80 | (cp >> 6 & 0x3F));
+    bytes[3] = (char)(0x80 | (cp & 0x3F));
+    n = 4;
+  }
+  if (out->used + n >= TAGS_TEXT_MAX)
+    return;
+  memcpy(&out->dst[out->used], bytes, n);
+  out->used += n;
+  out->dst[out->used] = '\0';
+}
+
+/**
+ * @brief Copies UTF-8 text up to its first NUL, dropping a cut-off tail
+ */
+static void copy_utf8(char *dst, const uint8_t *src, size_t len) {
+  size_t n = 0;
+  while (n < len && src[n])
+    n++;
+  if (n >= TAGS_TEXT_MAX) {
+    n = TAGS_TEXT_MAX - 1;
+    while (n > 0 && (src[n] & 0xC0) == 0x80)
+      n--;
+  }
+  memcpy(dst, src, n);
+  dst[n] = '\0';
+}
+
+static void copy_latin1(char *dst, const uint8_t *src, size_t len) {
+  Text_Out out = {dst, 0};
+  dst[0] = '\0';
+  for (size_t i = 0; i < len && src[i]; i++)
+    put(&out, src[i]);
+}
+
+static void copy_utf16(char *dst, const uint8_t *src, size_t len, bool be) {
+  Text_Out out = {dst, 0};
+  dst[0] = '\0';
+  for (size_t i = 0; i + 1 < len; i += 2) {
+    uint32_t unit = be ? (uint32_t)src[i] << 8 | src[i + 1]
+                       : (uint32_t)src[i + 1] << 8 | src[i];
+    if (unit == 0)
+      break;
+    if (unit >= 0xD800 && unit < 0xDC00 && i + 3 < len) {
+      uint32_t low = be ? (uint32_t)src[i + 2] << 8 | src[i + 3]
+                        : (uint32_t)src[i + 3] << 8 | src[i + 2];
+      if (low >= 0xDC00 && low < 0xE000) {
+        put(&out, 0x10000 + ((unit - 0xD800) << 10) + (low - 0xDC00));
+        i += 2;
+        continue;
+      }
+    }
+    put(&out, unit);
+  }
+}
+
+static uint32_t be24(const uint8_t *b) {
+  return (uint32_t)b[0] << 16 | (uint32_t)b[1] << 8 | b[2];
+}
+
+static uint32_t be32(const uint8_t *b) {
+  return (uint32_t)b[0] << 24 | be24(b + 1);
+}
+
+static uint32_t le32(const uint8_t *b) {
+  return (uint32_t)b[3] << 24 | (uint32_t)b[2] << 16 | (uint32_t)b[1] << 8 |
+         b[0];
+}
+
+/// 28-bit integer stored in four 7-bit bytes
+static uint32_t syncsafe(const uint8_t *b) {
+  return (uint32_t)(b[0] & 0x7F) << 21 | (uint32_t)(b[1] & 0x7F) << 14 |
+         (uint32_t)(b[2] & 0x7F) << 7 | (b[3] & 0x7F);
+}
+
+/**
+ * @brief Reads len bytes from the current position, NULL on short read
+ */
+static uint8_t *read_block(FILE *f, uint32_t len) {
+  if (len > TAGS_MAX_BLOCK)
+    return NULL;
+  uint8_t *data = malloc(len ? len : 1);
+  if (data && fread(data, 1, len, f) != len) {
+    free(data);
+    data = NULL;
+  }
+  return data;
+}
+
+/**
+ * @brief Decodes an ID3v2 text frame body (encoding byte, then text)
+ */
+static void id3_text(char *dst, const uint8_t *body, size_t len) {
+  if (len < 1)
+    return;
+  const uint8_t *text = body + 1;
+  len--;
+  switch (body[0]) {
+  case 0:
+    copy_latin1(dst, text, len);
+    break;
+  case 1:
+    if (len >= 2 && text[0] == 0xFE && text[1] == 0xFF)
+      copy_utf16(dst, text + 2, len - 2, true);
+    else if (len >= 2 && text[0] == 0xFF && text[1] == 0xFE)
+      copy_utf16(dst, text + 2, len - 2, false);
+    else
+      copy_utf16(dst, text, len, false);
+    break;
+  case 2:
+    copy_utf16(dst, text, len, true);
+    break;
+  case 3:
+    copy_utf8(dst, text, len);
+    break;
+  }
+}
+
+/**
+ * @brief Removes the 0x00 stuffed after every 0xFF by unsynchronisation
+ */
+static uint32_t id3_resync(uint8_t *data, uint32_t len) {
+  uint32_t out = 0;
+  for (uint32_t i = 0; i < len; i++) {
+    data[out++] = data[i];
+    if (data[i] == 0xFF && i + 1 < len && data[i + 1] == 0x00)
+      i++;
+  }
+  return out;
+}
+
+/**
+ * @brief Target for a frame id, or NULL if the frame is not wanted
+ */
+static char *id3_target(Track_Tags *tags, const uint8_t *id, bool v22) {
+  if (memcmp(id, v22 ? "TT2" : "TIT2", v22 ? 3 : 4) == 0)
+    return tags->title;
+  if (memcmp(id, v22 ? "TP1" : "TPE1", v22 ? 3 : 4) == 0)
+    return tags->artist;
+  if (memcmp(id, v22 ? "TAL" : "TALB", v22 ? 3 : 4) == 0)
+    return tags->album;
+  return NULL;
+}
+
+/**
+ * @brief Keeps a copy of a picture unless art already holds a better one
+ *
+ * The first picture is kept until a front cover turns up.
+ */
+static void set_art(Track_Art *art, int type, const uint8_t *data,
+                    size_t len) {
+  if (len == 0 || (art->data && (art->picture_type == TAGS_FRONT_COVER ||
+                                 type != TAGS_FRONT_COVER)))
+    return;
+  unsigned char *copy = malloc(len);
+  if (!copy)
+    return;
+  memcpy(copy, data, len);
+  free(art->data);
+  art->data = copy;
+  art->size = len;
+  art->picture_type = type;
+}
+
+/**
+ * @brief Bytes taken by a string in text encoding enc, terminator included
+ */
+static size_t id3_string_size(const uint8_t *s, size_t len, unsigned enc) {
+  if (enc == 1 || enc == 2) {
+    for (size_t i = 0; i + 1 < len; i += 2)
+      if (s[i] == 0 && s[i + 1] == 0)
+        return i + 2;
+    return len;
+  }
+  for (size_t i = 0; i < len; i++)
+    if (s[i] == 0)
+      return i + 1;
+  return len;
+}
+
+/**
+ * @brief Decodes an APIC (or v2.2 PIC) frame body: encoding, MIME type (PIC:
+ * three-letter format), picture type, description, then the image
+ */
+static void id3_picture(Track_Art *art, const uint8_t *body, size_t len,
+                        bool v22) {
+  if (len < 1)
+    return;
+  unsigned enc = body[0];
+  size_t pos = v22 ? 4 : 1 + id3_string_size(body + 1, len - 1, 0);
+  if (pos >= len)
+    return;
+  int type = body[pos++];
+  pos += id3_string_size(body + pos, len - pos, enc);
+  if (pos < len)
+    set_art(art, type, body + pos, len - pos);
+}
+
+static bool read_id3(FILE *f, const uint8_t header[10], Track_Tags *tags,
+                     Track_Art *art) {
+  unsigned version = header[3];
+  unsigned flags = header[5];
+  if (version < 2 || version > 4)
+    return false;
+  uint32_t size = syncsafe(header + 6);
+  uint8_t *data = read_block(f, size);
+  if (!data)
+    return false;
+  if ((flags & 0x80) && version < 4)
+    size = id3_resync(data, size);
+
+  bool v22 = version == 2;
+  size_t frame_header = v22 ? 6 : 10;
+  size_t pos = 0;
+  if (!v22 && (flags & 0x40) && size >= 4) {
+    /* The v2.3 size leaves out its own 4 bytes; v2.4 counts them */
+    pos = version == 4 ? (size_t)syncsafe(data) : (size_t)be32(data) + 4;
+    if (pos >= size) {
+      free(data);
+      return false;
+    }
+  }
+
+  while (pos < size && size - pos >= frame_header && data[pos] != 0) {
+    const uint8_t *frame = data + pos;
+    uint32_t len = v22            ? be24(frame + 3)
+                   : version == 4 ? syncsafe(frame + 4)
+                                  : be32(frame + 4);
+    pos += frame_header;
+    if (len > size - pos)
+      break;
+    /* Compressed or encrypted frames are not worth the code */
+    bool packed = !v22 && (version == 4 ? frame[9] & 0x0C : frame[9] & 0xC0);
+    uint8_t *body = data + pos;
+    uint32_t body_len = len;
+    if (version == 4 && (frame[9] & 0x02))
+      body_len = id3_resync(body, body_len);
+    /* v2.4 data length indicator */
+    if (version == 4 && (frame[9] & 0x01) && body_len >= 4) {
+      body += 4;
+      body_len -= 4;
+    }
+    char *dst = id3_target(tags, frame, v22);
+    if (dst && !dst[0] && !packed)
+      id3_text(dst, body, body_len);
+    else if (art && !packed &&
+             memcmp(frame, v22 ? "PIC" : "APIC", v22 ? 3 : 4) == 0)
+      id3_picture(art, body, body_len, v22);
+    pos += len;
+  }
+  free(data);
+  return true;
+}
+
+/// Vorbis comment keys (matched case-insensitively) and where they go
+static const struct {
+  const char *key;
+  size_t offset;
+} vorbis_keys[] = {
+    {"TITLE=", offsetof(Track_Tags, title)},
+    {"ARTIST=", offsetof(Track_Tags, artist)},
+    {"ALBUM=", offsetof(Track_Tags, album)},
+};
+
+/**
+ * @brief Reads a Vorbis comment block (vendor string, then KEY=value list)
+ */
+static bool vorbis_comments(const uint8_t *data, size_t len,
+                            Track_Tags *tags) {
+  if (len < 8)
+    return false;
+  size_t pos = 4 + (size_t)le32(data);
+  if (pos + 4 > len)
+    return false;
+  uint32_t count = le32(data + pos);
+  pos += 4;
+
+  for (uint32_t i = 0; i < count && pos + 4 <= len; i++) {
+    size_t entry_len = le32(data + pos);
+    pos += 4;
+    if (entry_len > len - pos)
+      break;
+    for (size_t k = 0; k < sizeof(vorbis_keys) / sizeof(*vorbis_keys); k++) {
+      size_t key_len = strlen(vorbis_keys[k].key);
+      char *dst = (char *)tags + vorbis_keys[k].offset;
+      if (entry_len > key_len && !dst[0] &&
+          strncasecmp((const char *)data + pos, vorbis_keys[k].key,
+                      key_len) == 0)
+        copy_utf8(dst, data + pos + key_len, entry_len - key_len);
+    }
+    pos += entry_len;
+  }
+  return true;
+}
+
+/**
+ * @brief Decodes a FLAC PICTURE block: type, MIME type, description, four
+ * dimension fields, then the image
+ */
+static void flac_picture(Track_Art *art, const uint8_t *data, size_t len) {
+  if (len < 8)
+    return;
+  int type = (int)be32(data);
+  size_t pos = 8 + (size_t)be32(data + 4);
+  if (pos + 4 > len)
+    return;
+  pos += 4 + (size_t)be32(data + pos);
+  if (pos + 20 > len)
+    return;
+  size_t size = be32(data + pos + 16);
+  pos += 20;
+  if (size <= len - pos)
+    set_art(art, type, data + pos, size);
+}
+
+/**
+ * @brief Walks the FLAC metadata blocks up to the VORBIS_COMMENT one, or
+ * with art through all of them for PICTURE blocks as well
+ *
+ * Blocks not wanted (seek tables, padding) are skipped with fseek(), not
+ * read.
+ */
+static bool read_flac(FILE *f, Track_Tags *tags, Track_Art *art) {
+  uint8_t header[4];
+  bool ok = false;
+  while (fread(header, 1, sizeof(header), f) == sizeof(header)) {
+    uint32_t len = be24(header + 1);
+    unsigned type = header[0] & 0x7F;
+    bool wanted = type == 4 || (type == 6 && art &&
+                                art->picture_type != TAGS_FRONT_COVER);
+    if (wanted) {
+      uint8_t *data = read_block(f, len);
+      if (!data)
+        break;
+      if (type == 4)
+        ok = vorbis_comments(data, len, tags);
+      else
+        flac_picture(art, data, len);
+      free(data);
+      if (type == 4 && !art)
+        break;
+    } else if (fseek(f, len, SEEK_CUR) != 0) {
+      break;
+    }
+    if (header[0] & 0x80)
+      break;
+  }
+  return ok;
+}
+
+static const uint8_t *find(const uint8_t *data, size_t len, const char *magic,
+                           size_t magic_len) {
+  for (size_t i = 0; i + magic_len <= len; i++)
+    if (memcmp(data + i, magic, magic_len) == 0)
+      return data + i;
+  return NULL;
+}
+
+/**
+ * @brief Finds the comment header packet of an Ogg Vorbis or Opus stream
+ *
+ * The packet nearly always sits whole in the second page; one that spans
+ * pages is read up to the page break, where the length checks stop it.
+ */
+static bool read_ogg(FILE *f, Track_Tags *tags) {
+  uint8_t *data = malloc(OGG_HEAD_BYTES);
+  if (!data)
+    return false;
+  size_t len = fread(data, 1, OGG_HEAD_BYTES, f);
+
+  bool ok = false;
+  const uint8_t *packet;
+  if ((packet = find(data, len, "\x03vorbis", 7)))
+    packet += 7;
+  else if ((packet = find(data, len, "OpusTags", 8)))
+    packet += 8;
+  if (packet)
+    ok = vorbis_comments(packet, len - (size_t)(packet - data), tags);
+  free(data);
+  return ok;
+}
+
+bool tags_read(const char *path, Track_Tags *tags) {
+  return tags_read_art(path, tags, NULL);
+}
+
+bool tags_read_art(const char *path, Track_Tags *tags, Track_Art *art) {
+  memset(tags, 0, sizeof(*tags));
+  if (art)
+    memset(art, 0, sizeof(*art));
+  FILE *f = fopen(path, "rb");
+  if (!f)
+    return false;
+
+  uint8_t header[10];
+  bool ok = false;
+  if (fread(header, 1, sizeof(header), f) == sizeof(header)) {
+    if (memcmp(header, "ID3", 3) == 0) {
+      ok = read_id3(f, header, tags, art);
+    } else if (memcmp(header, "fLaC", 4) == 0) {
+      ok = fseek(f, 4, SEEK_SET) == 0 && read_flac(f, tags, art);
+    } else if (memcmp(header, "OggS", 4) == 0) {
+      ok = fseek(f, 0, SEEK_SET) == 0 && read_ogg(f, tags);
+    }
+  }
+  fclose(f);
+  return ok;
+}
@@ -0,0 +1,63 @@
+/**
+ * @file tags.h
+ * @brief Title, artist and album of an audio file
+ *
+ * Reads ID3v2 (2.2 to 2.4) at the start of MP3 files and Vorbis comments
+ * from FLAC, Ogg Vorbis and Opus files. Text comes out as UTF-8. Only the
+ * tag blocks are read, never the audio data, so this is cheap next to
+ * opening the file with the decoder.
+ *
+ * Embedded cover art comes from ID3v2 APIC/PIC frames and FLAC PICTURE
+ * blocks, as the encoded image bytes (usually JPEG or PNG).
+ */
+#ifndef TAGS_H_
+#define TAGS_H_
+
+#include <stdbool.h>
+#include <stddef.h>
+
+#define TAGS_TEXT_MAX 128 ///< Longest stored value, including the NUL
+
+/**
+ * @struct Track_Tags
+ * @brief Text tags; empty strings when a tag is missing
+ */
+typedef struct {
+  char title[TAGS_TEXT_MAX];
+  char artist[TAGS_TEXT_MAX];
+  char album[TAGS_TEXT_MAX];
+} Track_Tags;
+
+/// Track_Art::picture_type of a front cover (ID3v2 and FLAC agree)
+#define TAGS_FRONT_COVER 3
+
+/**
+ * @struct Track_Art
+ * @brief Embedded picture, the front cover if there is one
+ */
+typedef struct {
+  unsigned char *data; ///< Encoded image, malloc()ed; NULL if none
+  size_t size;         ///< Bytes of data
+  int picture_type;    ///< TAGS_FRONT_COVER or another picture type
+} Track_Art;
+
+/**
+ * @brief Reads the tags of path
+ *
+ * @return false if the file has no tag block this reader understands (tags
+ *         is then all empty)
+ */
+bool tags_read(const char *path, Track_Tags *tags);
+
+/**
+ * @brief Reads the tags of path and its embedded cover art
+ *
+ * Unlike tags_read(), this reads picture frames and blocks too, so it can
+ * cost a few hundred kilobytes of reading per file.
+ *
+ * @param art Output; free art->data when done
+ * @return Same as tags_read()
+ */
+bool tags_read_art(const char *path, Track_Tags *tags, Track_Art *art);
+
+#endif // TAGS_H_
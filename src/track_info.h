@@ -0,0 +1,21 @@
+/**
+ * @file track_info.h
+ * @brief Duration and format of an audio file, as found by probing it
+ *
+ * Shared by the importer, which fills it in, and the playlist, which keeps
+ * it per track, so that neither has to include the other.
+ */
+#ifndef TRACK_INFO_H_
+#define TRACK_INFO_H_
+
+/**
+ * @struct Track_Info
+ * @brief What probing an audio file found out
+ */
+typedef struct {
+  float length;         ///< Duration in seconds
+  unsigned sample_rate; ///< Sample rate in Hz
+  unsigned channels;    ///< Channel count
+} Track_Info;
+
+#endif // TRACK_INFO_H_